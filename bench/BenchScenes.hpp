@@ -0,0 +1,88 @@
+//
+// Created by Fatih on 9/21/2022.
+//
+
+#ifndef PTDEMO_BENCHSCENES_HPP
+#define PTDEMO_BENCHSCENES_HPP
+
+#include "graphics/accel/BVH.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace ph {
+
+// Random scenes shared by the benchmarks. The extents grow with the count so the density, and with it
+// the numbers, stay comparable across scene sizes.
+
+// half size of the cube that holds count spheres, 100 spheres fill [-10, 10]^3
+inline float cubeExtent(uint32_t count) {
+	return 10.0f * std::cbrt(float(count) / 100.0f);
+}
+
+// half size of the ground square that holds count spheres or lights, 16 of them cover [-10, 10]^2
+inline float layerExtent(uint32_t count) {
+	return 10.0f * std::sqrt(float(count) / 16.0f);
+}
+
+// spheres anywhere in [-extent, extent]^3
+inline std::vector<Sphere> generateSpheres(uint32_t count, float extent, std::default_random_engine& rnd) {
+	auto distPos = std::uniform_real_distribution<float>(-extent, extent);
+	auto distRadius = std::uniform_real_distribution<float>(0.3f, 1.3f);
+
+	std::vector<Sphere> spheres;
+	spheres.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		spheres.push_back(Sphere{{distPos(rnd), distPos(rnd), distPos(rnd)}, distRadius(rnd), 0});
+	}
+	return spheres;
+}
+
+// same distribution as GameInstance::randomizeSpheres, a thin layer above the ground
+inline std::vector<Sphere> generateLayerSpheres(uint32_t count, float extent, std::default_random_engine& rnd) {
+	auto distXZ = std::uniform_real_distribution<float>(-extent, extent);
+	auto distY = std::uniform_real_distribution<float>(0.0f, extent * 0.2f);
+	auto distRadius = std::uniform_real_distribution<float>(0.3f, 1.3f);
+
+	std::vector<Sphere> spheres;
+	spheres.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		spheres.push_back(Sphere{{distXZ(rnd), distY(rnd), distXZ(rnd)}, distRadius(rnd), 0});
+	}
+	return spheres;
+}
+
+// small sphere lights over the region generateLayerSpheres scatters its spheres in
+inline std::vector<SpotLight> generateLights(uint32_t count, float extent, std::default_random_engine& rnd) {
+	auto distXZ = std::uniform_real_distribution<float>(-extent, extent);
+	auto distY = std::uniform_real_distribution<float>(0.5f, extent * 0.2f);
+	auto distRadius = std::uniform_real_distribution<float>(0.1f, 0.4f);
+	auto distIntensity = std::uniform_real_distribution<float>(0.5f, 8.0f);
+	auto distColor = std::uniform_real_distribution<float>(0.2f, 1.0f);
+
+	std::vector<SpotLight> lights;
+	lights.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		lights.push_back(SpotLight{{distXZ(rnd), distY(rnd), distXZ(rnd)}, distIntensity(rnd), {distColor(rnd), distColor(rnd), distColor(rnd)}, distRadius(rnd)});
+	}
+	return lights;
+}
+
+// camera-like rays from origin toward -z. Before normalizing, x lies in [-0.6, 0.6] and y in
+// [centerY - spreadY, centerY + spreadY].
+inline std::vector<Ray> generateRays(uint32_t count, const glm::vec3& origin, float centerY, float spreadY, std::default_random_engine& rnd) {
+	auto dist = std::uniform_real_distribution<float>(-1.0f, 1.0f);
+
+	std::vector<Ray> rays;
+	rays.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		glm::vec3 dir = glm::normalize(glm::vec3{dist(rnd) * 0.6f, dist(rnd) * spreadY + centerY, -1.0f});
+		rays.emplace_back(origin, dir);
+	}
+	return rays;
+}
+
+} // ph
+
+#endif //PTDEMO_BENCHSCENES_HPP
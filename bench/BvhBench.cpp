@@ -0,0 +1,132 @@
+//
+// Created by Fatih on 8/20/2022.
+//
+
+#include "BenchScenes.hpp"
+#include "graphics/accel/BVH.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace ph;
+using Clock = std::chrono::steady_clock;
+
+static double traceBruteForce(const std::vector<Ray>& rays, const std::vector<Sphere>& spheres, uint32_t& hits) {
+	auto start = Clock::now();
+	hits = 0;
+	for (const auto& ray : rays) {
+		float closest = std::numeric_limits<float>::max();
+		for (const auto& sphere : spheres) {
+			closest = std::min(closest, intersectSphere(ray, sphere));
+		}
+		if (closest != std::numeric_limits<float>::max()) hits++;
+	}
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static double traceBVH(const std::vector<Ray>& rays, const BVH& bvh, const std::vector<Sphere>& spheres, uint32_t& hits) {
+	std::vector<Box> boxes;
+	auto start = Clock::now();
+	hits = 0;
+	for (const auto& ray : rays) {
+		RayHit hit;
+		if (bvh.intersect(ray, hit, spheres, boxes)) hits++;
+	}
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// segments from random points in the scene volume to a light above it, like the shadow rays of direct lighting
+struct ShadowRay {
+	Ray ray;
+	float tMax;
+};
+
+static std::vector<ShadowRay> generateShadowRays(uint32_t count, float extent, std::default_random_engine& rnd) {
+	auto dist = std::uniform_real_distribution<float>(-extent, extent);
+	glm::vec3 light{0, extent * 2.0f, 0};
+
+	std::vector<ShadowRay> rays;
+	rays.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		glm::vec3 origin{dist(rnd), dist(rnd), dist(rnd)};
+		glm::vec3 toLight = light - origin;
+		float length = glm::length(toLight);
+		rays.push_back({Ray(origin, toLight / length), length});
+	}
+	return rays;
+}
+
+// visibility through the closest hit query, what the shader did before it had an any-hit path
+static double shadowClosestHit(const std::vector<ShadowRay>& rays, const BVH& bvh, const std::vector<Sphere>& spheres, uint32_t& blocked) {
+	std::vector<Box> boxes;
+	auto start = Clock::now();
+	blocked = 0;
+	for (const auto& shadow : rays) {
+		RayHit hit;
+		hit.distance = shadow.tMax;
+		if (bvh.intersect(shadow.ray, hit, spheres, boxes)) blocked++;
+	}
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static double shadowAnyHit(const std::vector<ShadowRay>& rays, const BVH& bvh, const std::vector<Sphere>& spheres, uint32_t& blocked) {
+	std::vector<Box> boxes;
+	auto start = Clock::now();
+	blocked = 0;
+	for (const auto& shadow : rays) {
+		if (bvh.occluded(shadow.ray, shadow.tMax, spheres, boxes)) blocked++;
+	}
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main() {
+	std::default_random_engine rnd(1337);
+	const uint32_t rayCount = 1 << 18;
+
+	std::printf("%10s %10s %12s %10s %16s %16s %8s\n", "spheres", "nodes", "build (ms)", "SAH", "brute (Mray/s)", "bvh (Mray/s)", "speedup");
+	for (uint32_t count : {100u, 1000u, 10000u, 100000u}) {
+		float extent = cubeExtent(count);
+		auto spheres = generateSpheres(count, extent, rnd);
+		auto rays = generateRays(rayCount, {0, 0, extent * 1.5f}, 0.0f, 0.6f, rnd);
+
+		BVH bvh;
+		auto start = Clock::now();
+		bvh.build(spheres, {});
+		double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		uint32_t bvhHits;
+		double bvhTime = traceBVH(rays, bvh, spheres, bvhHits);
+		double bvhRate = double(rays.size()) / bvhTime / 1e6;
+
+		// brute force gets a smaller ray budget on big scenes, it would run for minutes otherwise
+		auto bruteCount = std::min<size_t>(rays.size(), size_t(2e8 / count));
+		std::vector<Ray> bruteRays(rays.begin(), rays.begin() + bruteCount);
+		uint32_t bruteHits;
+		double bruteTime = traceBruteForce(bruteRays, spheres, bruteHits);
+		double bruteRate = double(bruteRays.size()) / bruteTime / 1e6;
+
+		std::printf("%10u %10zu %12.2f %10.2f %16.3f %16.3f %7.1fx\n", count, bvh.nodeCount(), buildMs, bvh.sahCost(), bruteRate, bvhRate, bvhRate / bruteRate);
+	}
+
+	std::printf("\nshadow rays\n");
+	std::printf("%10s %10s %18s %18s %8s %10s\n", "spheres", "occluded", "closest (Mray/s)", "any-hit (Mray/s)", "speedup", "mismatch");
+	for (uint32_t count : {100u, 1000u, 10000u, 100000u}) {
+		float extent = cubeExtent(count);
+		auto spheres = generateSpheres(count, extent, rnd);
+		auto rays = generateShadowRays(rayCount, extent, rnd);
+
+		BVH bvh;
+		bvh.build(spheres, {});
+
+		uint32_t closestBlocked, anyBlocked;
+		double closestRate = double(rays.size()) / shadowClosestHit(rays, bvh, spheres, closestBlocked) / 1e6;
+		double anyRate = double(rays.size()) / shadowAnyHit(rays, bvh, spheres, anyBlocked) / 1e6;
+
+		std::printf("%10u %9.1f%% %18.3f %18.3f %7.1fx %10d\n", count, 100.0 * anyBlocked / double(rays.size()), closestRate, anyRate, anyRate / closestRate,
+					int(anyBlocked) - int(closestBlocked));
+	}
+	return 0;
+}
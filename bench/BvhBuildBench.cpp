@@ -0,0 +1,51 @@
+//
+// Created by Fatih on 8/22/2022.
+//
+
+#include "BenchScenes.hpp"
+#include "graphics/accel/BVH.hpp"
+#include "util/ThreadPool.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace ph;
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char* argv[]) {
+	uint32_t count = argc > 1 ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : 1000000;
+	uint32_t maxThreads = argc > 2 ? uint32_t(std::strtoul(argv[2], nullptr, 10)) : std::max(1u, std::thread::hardware_concurrency());
+	const int repeats = 3;
+
+	std::default_random_engine rnd(1337);
+	auto spheres = generateSpheres(count, cubeExtent(count), rnd);
+	std::vector<Box> boxes;
+
+	std::printf("%u spheres, best of %d builds\n", count, repeats);
+	std::printf("%8s %12s %10s %12s %10s\n", "threads", "build (ms)", "speedup", "nodes", "SAH");
+
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	double baseline = 0;
+	for (uint32_t threads : threadCounts) {
+		ThreadPool pool(threads);
+		BVH bvh;
+		double best = 1e30;
+		for (int i = 0; i < repeats; ++i) {
+			auto start = Clock::now();
+			bvh.build(spheres, boxes, threads > 1 ? &pool : nullptr);
+			best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		}
+		if (threads == 1) baseline = best;
+
+		std::printf("%8u %12.2f %9.2fx %12zu %10.2f\n", threads, best, baseline / best, bvh.nodeCount(), bvh.sahCost());
+	}
+	return 0;
+}
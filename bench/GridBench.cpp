@@ -0,0 +1,77 @@
+//
+// Created by Fatih on 9/1/2022.
+//
+
+#include "BenchScenes.hpp"
+#include "graphics/accel/BVH.hpp"
+#include "graphics/accel/UniformGrid.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace ph;
+using Clock = std::chrono::steady_clock;
+
+template<typename Func>
+static double trace(const std::vector<Ray>& rays, std::vector<float>& distances, Func&& intersect) {
+	distances.resize(rays.size());
+	auto start = Clock::now();
+	for (size_t i = 0; i < rays.size(); ++i) {
+		distances[i] = intersect(rays[i]);
+	}
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main() {
+	std::default_random_engine rnd(1337);
+	const uint32_t rayCount = 1 << 16;
+	std::vector<Box> boxes;
+
+	std::printf("%10s %12s %14s %14s %14s %12s %12s %10s\n", "spheres", "cells", "grid build ms", "bvh build ms", "brute Mray/s", "grid Mray/s", "bvh Mray/s", "mismatch");
+	for (uint32_t count : {16u, 100u, 1000u, 10000u, 100000u}) {
+		float extent = layerExtent(count);
+		auto spheres = generateLayerSpheres(count, extent, rnd);
+		auto rays = generateRays(rayCount, {0, extent * 0.3f, extent * 1.5f}, -0.15f, 0.3f, rnd);
+
+		auto start = Clock::now();
+		UniformGrid grid;
+		grid.build(spheres, boxes, {});
+		double gridBuild = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		start = Clock::now();
+		BVH bvh;
+		bvh.build(spheres, boxes);
+		double bvhBuild = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		// brute force gets a smaller ray budget on big scenes, it would run for minutes otherwise
+		std::vector<Ray> bruteRays(rays.begin(), rays.begin() + std::min<size_t>(rays.size(), size_t(2e8 / count)));
+		std::vector<float> bruteHits, gridHits, bvhHits;
+		double bruteTime = trace(bruteRays, bruteHits, [&](const Ray& ray) {
+			float closest = std::numeric_limits<float>::max();
+			for (const auto& sphere : spheres) closest = std::min(closest, intersectSphere(ray, sphere));
+			return closest;
+		});
+		double gridTime = trace(rays, gridHits, [&](const Ray& ray) {
+			RayHit hit;
+			grid.intersect(ray, hit, spheres, boxes);
+			return hit.distance;
+		});
+		double bvhTime = trace(rays, bvhHits, [&](const Ray& ray) {
+			RayHit hit;
+			bvh.intersect(ray, hit, spheres, boxes);
+			return hit.distance;
+		});
+
+		uint32_t mismatches = 0;
+		for (size_t i = 0; i < bruteRays.size(); ++i) {
+			if (bruteHits[i] != gridHits[i]) mismatches++;
+		}
+
+		std::printf("%10u %12zu %14.2f %14.2f %14.3f %12.3f %12.3f %10u\n", count, grid.cellCount(), gridBuild, bvhBuild,
+					double(bruteRays.size()) / bruteTime / 1e6, double(rays.size()) / gridTime / 1e6, double(rays.size()) / bvhTime / 1e6, mismatches);
+	}
+	return 0;
+}
@@ -0,0 +1,99 @@
+//
+// Created by Fatih on 9/20/2022.
+//
+
+#include "BenchScenes.hpp"
+#include "graphics/accel/LightBVH.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace ph;
+using Clock = std::chrono::steady_clock;
+
+constexpr float PI = 3.14159265358979f;
+
+// unshadowed luminance a light sample adds to a diffuse receiver at p, the solid angle of the light times its cosine
+static float contribution(const SpotLight& light, const glm::vec3& p, const glm::vec3& n) {
+	glm::vec3 d = light.position - p;
+	float distanceSq = glm::dot(d, d);
+	float cosMax = std::sqrt(std::max(1.0f - light.radius * light.radius / distanceSq, 0.0f));
+	float cosTheta = std::max(glm::dot(n, d / std::sqrt(distanceSq)), 0.0f);
+	float luminance = glm::dot(light.color, glm::vec3(0.2126f, 0.7152f, 0.0722f)) * light.intensity;
+	return luminance * 2.0f * PI * (1.0f - cosMax) * cosTheta;
+}
+
+struct Estimate {
+	double mean = 0.0;
+	double variance = 0.0;
+	double seconds = 0.0;
+};
+
+// one light sample per shading point, relative error is averaged over the points
+template<typename Func>
+static Estimate estimate(const std::vector<glm::vec3>& points, uint32_t samples, std::default_random_engine& rnd, Func&& sampleOnce) {
+	auto dist = std::uniform_real_distribution<float>(0.0f, 1.0f);
+	Estimate result;
+	auto start = Clock::now();
+	for (const auto& p : points) {
+		double sum = 0.0, sumSq = 0.0;
+		for (uint32_t i = 0; i < samples; ++i) {
+			double value = sampleOnce(p, dist(rnd));
+			sum += value;
+			sumSq += value * value;
+		}
+		double mean = sum / samples;
+		result.mean += mean;
+		result.variance += mean > 0.0 ? (sumSq / samples - mean * mean) / (mean * mean) : 0.0;
+	}
+	result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	result.mean /= double(points.size());
+	result.variance /= double(points.size());
+	return result;
+}
+
+int main() {
+	std::default_random_engine rnd(1337);
+	const glm::vec3 up{0.0f, 1.0f, 0.0f};
+	const uint32_t pointCount = 256;
+	const uint32_t samples = 1024;
+
+	std::printf("%10s %14s %16s %16s %14s %14s %10s\n", "lights", "build ms", "uniform rel std", "tree rel std", "uniform Ms/s", "tree Ms/s", "mismatch");
+	for (uint32_t count : {16u, 100u, 1000u, 10000u, 100000u}) {
+		float extent = layerExtent(count);
+		auto lights = generateLights(count, extent, rnd);
+
+		auto start = Clock::now();
+		LightBVH tree;
+		tree.build(lights);
+		double build = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		// receivers on the ground under the lights
+		auto distXZ = std::uniform_real_distribution<float>(-extent, extent);
+		std::vector<glm::vec3> points(pointCount);
+		for (auto& p : points) p = {distXZ(rnd), 0.0f, distXZ(rnd)};
+
+		Estimate uniform = estimate(points, samples, rnd, [&](const glm::vec3& p, float u) {
+			uint32_t index = std::min(uint32_t(u * float(count)), count - 1);
+			return double(contribution(lights[index], p, up)) * count;
+		});
+
+		uint32_t mismatches = 0;
+		Estimate sampled = estimate(points, samples, rnd, [&](const glm::vec3& p, float u) {
+			uint32_t index;
+			float pmf;
+			if (!tree.sample(p, up, u, index, pmf)) return 0.0;
+			// the shader weighs light hits with pmf, it has to agree with the traversal
+			if (std::abs(tree.pmf(p, up, index) - pmf) > 1e-4f * pmf) mismatches++;
+			return double(contribution(lights[index], p, up)) / pmf;
+		});
+
+		double total = double(pointCount) * samples;
+		std::printf("%10u %14.2f %16.3f %16.3f %14.3f %14.3f %10u\n", count, build, std::sqrt(uniform.variance), std::sqrt(sampled.variance),
+					total / uniform.seconds / 1e6, total / sampled.seconds / 1e6, mismatches);
+	}
+	return 0;
+}
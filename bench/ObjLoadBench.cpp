@@ -0,0 +1,81 @@
+//
+// Created by Fatih on 8/28/2022.
+//
+
+#include "graphics/accel/BVH.hpp"
+#include "graphics/mesh/ObjLoader.hpp"
+#include "util/ThreadPool.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ph;
+using Clock = std::chrono::steady_clock;
+
+// a wavy grid of quads written as triangle faces, roughly the shape of a scanned terrain
+static std::string writeGridObj(uint32_t triangles) {
+	auto side = uint32_t(std::sqrt(float(triangles) / 2.0f)) + 1;
+	auto path = (std::filesystem::temp_directory_path() / "ptdemo_grid.obj").string();
+
+	std::ofstream out(path);
+	out << "# " << side << "x" << side << " grid\n";
+	for (uint32_t z = 0; z <= side; ++z) {
+		for (uint32_t x = 0; x <= side; ++x) {
+			float y = std::sin(float(x) * 0.05f) * std::cos(float(z) * 0.05f);
+			out << "v " << float(x) * 0.01f << ' ' << y << ' ' << float(z) * 0.01f << '\n';
+		}
+	}
+	for (uint32_t z = 0; z < side; ++z) {
+		for (uint32_t x = 0; x < side; ++x) {
+			uint32_t i = z * (side + 1) + x + 1;
+			out << "f " << i << ' ' << i + 1 << ' ' << i + side + 2 << '\n';
+			out << "f " << i << ' ' << i + side + 2 << ' ' << i + side + 1 << '\n';
+		}
+	}
+	return path;
+}
+
+static std::vector<AABB> triangleBounds(const TriangleMesh& mesh) {
+	std::vector<AABB> bounds(mesh.triangleCount());
+	for (size_t i = 0; i < bounds.size(); ++i) {
+		for (int v = 0; v < 3; ++v) bounds[i].grow(glm::vec3(mesh.vertices[mesh.indices[i * 3 + v]]));
+	}
+	return bounds;
+}
+
+int main(int argc, char* argv[]) {
+	uint32_t triangles = argc > 1 ? uint32_t(std::strtoul(argv[1], nullptr, 10)) : 1000000;
+	uint32_t maxThreads = argc > 2 ? uint32_t(std::strtoul(argv[2], nullptr, 10)) : std::max(1u, std::thread::hardware_concurrency());
+	std::string path = argc > 3 ? argv[3] : writeGridObj(triangles);
+
+	std::printf("%s, %.1f MB\n", path.c_str(), double(std::filesystem::file_size(path)) / (1 << 20));
+	std::printf("%8s %12s %12s %12s %12s\n", "threads", "triangles", "load (ms)", "bvh (ms)", "total (ms)");
+
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	for (uint32_t threads : threadCounts) {
+		ThreadPool pool(threads);
+		auto* poolPtr = threads > 1 ? &pool : nullptr;
+
+		auto start = Clock::now();
+		auto mesh = loadObj(path, poolPtr);
+		auto loaded = Clock::now();
+		BVH bvh;
+		bvh.build(triangleBounds(mesh), poolPtr);
+		auto built = Clock::now();
+
+		double load = std::chrono::duration<double, std::milli>(loaded - start).count();
+		double build = std::chrono::duration<double, std::milli>(built - loaded).count();
+		std::printf("%8u %12zu %12.2f %12.2f %12.2f\n", threads, mesh.triangleCount(), load, build, load + build);
+	}
+	return 0;
+}
@@ -0,0 +1,266 @@
+//
+// Created by Fatih on 9/21/2022.
+//
+
+#include "BenchScenes.hpp"
+#include "graphics/Reservoir.hpp"
+#include "graphics/accel/LightBVH.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace ph;
+using Clock = std::chrono::steady_clock;
+
+constexpr float PI = 3.14159265358979f;
+constexpr uint32_t IMAGE_SIZE = 64;
+constexpr float ALBEDO = 0.8f;
+// frames before the error is measured, so the temporal reuse has a history
+constexpr uint32_t WARMUP_FRAMES = 8;
+constexpr uint32_t MEASURED_FRAMES = 16;
+// mirrors the default of RenderSettings
+constexpr float HISTORY_LIMIT = 20.0f;
+// width of the ground the image shows
+constexpr float VIEW_SIZE = 8.0f;
+// in pixels, a quarter unit on the ground
+constexpr int SPATIAL_RADIUS = 2;
+// mirrors LightResampler::MAX_NEIGHBOURS
+constexpr uint32_t MAX_NEIGHBOURS = 16;
+
+static float emitted(const SpotLight& light) {
+	return glm::dot(light.color, glm::vec3(0.2126f, 0.7152f, 0.0722f)) * light.intensity;
+}
+
+// Exact luminance a diffuse receiver at p reflects toward the camera. Every light is above the ground,
+// so the whole sphere is above the horizon and its irradiance is pi * Le * sin^2 of its half angle * cos.
+static float reference(const std::vector<SpotLight>& lights, const glm::vec3& p, const glm::vec3& n) {
+	float sum = 0.0f;
+	for (const auto& light : lights) {
+		glm::vec3 d = light.position - p;
+		float distanceSq = glm::dot(d, d);
+		float cosTheta = glm::dot(n, d) / std::sqrt(distanceSq);
+		sum += ALBEDO * emitted(light) * light.radius * light.radius / distanceSq * std::max(cosTheta, 0.0f);
+	}
+	return sum;
+}
+
+// a light sample of SampleLight without the shadow ray, pdf in the area measure of the light's surface
+struct Candidate {
+	uint32_t light = Reservoir::NO_LIGHT;
+	glm::vec3 point{0.0f};
+	float pdf = 0.0f;
+};
+
+// mirrors the cone sampling of SampleSphereLight
+static Candidate drawCandidate(const LightBVH& tree, const std::vector<SpotLight>& lights, const glm::vec3& p, const glm::vec3& n, std::default_random_engine& rnd) {
+	auto dist = std::uniform_real_distribution<float>(0.0f, 1.0f);
+	Candidate candidate;
+	uint32_t index;
+	float pmf;
+	if (!tree.sample(p, n, dist(rnd), index, pmf)) return candidate;
+
+	const SpotLight& light = lights[index];
+	glm::vec3 d = light.position - p;
+	float distance = glm::length(d);
+	glm::vec3 w = d / distance;
+	float cosMax = std::sqrt(std::max(1.0f - light.radius * light.radius / (distance * distance), 0.0f));
+	float cosTheta = 1.0f - dist(rnd) * (1.0f - cosMax);
+	float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+	float phi = 2.0f * PI * dist(rnd);
+
+	glm::vec3 helper = std::abs(w.x) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 tangent = glm::normalize(glm::cross(w, helper));
+	glm::vec3 binormal = glm::cross(w, tangent);
+	glm::vec3 direction = tangent * (std::cos(phi) * sinTheta) + binormal * (std::sin(phi) * sinTheta) + w * cosTheta;
+
+	float b = glm::dot(d, direction);
+	float tMax = b - std::sqrt(std::max(b * b - distance * distance + light.radius * light.radius, 0.0f));
+	glm::vec3 point = glm::normalize(p + direction * tMax - light.position);
+	float cosLight = -glm::dot(point, direction);
+	if (tMax <= 0.0f || cosLight <= 0.0f) return candidate;
+
+	candidate.light = index;
+	candidate.point = point;
+	candidate.pdf = pmf / (2.0f * PI * std::max(1.0f - cosMax, 1e-7f)) * cosLight / (tMax * tMax);
+	return candidate;
+}
+
+// unshadowed contribution of the sample, the target function of the resampling. Mirrors RestirTarget.
+static float target(const std::vector<SpotLight>& lights, const glm::vec3& p, const glm::vec3& n, uint32_t light, const glm::vec3& point) {
+	if (light == Reservoir::NO_LIGHT) return 0.0f;
+	const SpotLight& spot = lights[light];
+	glm::vec3 d = spot.position + point * spot.radius - p;
+	float distanceSq = glm::dot(d, d);
+	glm::vec3 direction = d / std::sqrt(distanceSq);
+	float cosSurface = glm::dot(n, direction);
+	float cosLight = -glm::dot(point, direction);
+	if (cosSurface <= 0.0f || cosLight <= 0.0f) return 0.0f;
+	return ALBEDO / PI * emitted(spot) * cosSurface * cosLight / distanceSq;
+}
+
+// Merges reservoirs drawn at the receivers into one for the first receiver, mirrors RestirTemporal and
+// RestirSpatial. Every pick is weighted with the balance heuristic over the receivers' targets scaled by
+// their counts.
+static Reservoir combine(const std::vector<SpotLight>& lights, const glm::vec3* receivers, const Reservoir* inputs, uint32_t count,
+						 const glm::vec3& n, std::default_random_engine& rnd, float& picked) {
+	auto dist = std::uniform_real_distribution<float>(0.0f, 1.0f);
+	Reservoir r;
+	picked = 0.0f;
+	for (uint32_t i = 0; i < count; ++i) {
+		float own = 0.0f, total = 0.0f;
+		for (uint32_t j = 0; j < count; ++j) {
+			float w = inputs[j].count * target(lights, receivers[j], n, inputs[i].light, inputs[i].point);
+			total += w;
+			if (j == i) own = w;
+		}
+		float t = target(lights, receivers[0], n, inputs[i].light, inputs[i].point);
+		if (r.merge(inputs[i], t, total > 0.0f ? own / total : 0.0f, dist(rnd))) picked = t;
+	}
+	r.finalize(picked, 1.0f);
+	return r;
+}
+
+struct Config {
+	const char* name;
+	// 0 is plain next-event estimation with one sample
+	uint32_t candidates;
+	bool temporal;
+	uint32_t neighbours;
+};
+
+struct Result {
+	double rmse = 0.0;
+	double bias = 0.0;
+	double milliseconds = 0.0;
+};
+
+static Result run(const Config& config, const LightBVH& tree, const std::vector<SpotLight>& lights, const std::vector<glm::vec3>& points,
+				  const std::vector<float>& expected, std::default_random_engine& rnd) {
+	const glm::vec3 up{0.0f, 1.0f, 0.0f};
+	const uint32_t pixels = IMAGE_SIZE * IMAGE_SIZE;
+	auto dist = std::uniform_real_distribution<float>(0.0f, 1.0f);
+	// the ground is flat, every neighbour passes the similarity test of the passes
+	auto offset = std::uniform_int_distribution<int>(-SPATIAL_RADIUS, SPATIAL_RADIUS);
+
+	std::vector<Reservoir> history(pixels), current(pixels), spatial(pixels);
+	std::vector<double> errorSq(pixels, 0.0), error(pixels, 0.0);
+	double seconds = 0.0;
+
+	for (uint32_t frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; ++frame) {
+		std::vector<float> estimate(pixels, 0.0f);
+		auto start = Clock::now();
+
+		if (config.candidates == 0) {
+			for (uint32_t i = 0; i < pixels; ++i) {
+				Candidate c = drawCandidate(tree, lights, points[i], up, rnd);
+				estimate[i] = c.pdf > 0.0f ? target(lights, points[i], up, c.light, c.point) / c.pdf : 0.0f;
+			}
+		} else {
+			// candidates, RestirCandidates
+			for (uint32_t i = 0; i < pixels; ++i) {
+				Reservoir r;
+				float picked = 0.0f;
+				for (uint32_t k = 0; k < config.candidates; ++k) {
+					Candidate c = drawCandidate(tree, lights, points[i], up, rnd);
+					float t = c.pdf > 0.0f ? target(lights, points[i], up, c.light, c.point) : 0.0f;
+					if (r.update(c.light, c.point, t > 0.0f ? t / c.pdf : 0.0f, dist(rnd))) picked = t;
+				}
+				r.finalize(picked, r.count);
+				current[i] = r;
+			}
+
+			// the camera doesn't move, the previous reservoir belongs to the same pixel. RestirTemporal.
+			if (config.temporal && frame > 0) {
+				for (uint32_t i = 0; i < pixels; ++i) {
+					glm::vec3 receivers[2] = {points[i], points[i]};
+					Reservoir inputs[2] = {current[i], history[i]};
+					inputs[1].count = std::min(inputs[1].count, HISTORY_LIMIT * current[i].count);
+					float picked;
+					current[i] = combine(lights, receivers, inputs, 2, up, rnd, picked);
+				}
+			}
+
+			// RestirSpatial, reads current and writes spatial
+			for (uint32_t i = 0; i < pixels; ++i) {
+				int x = int(i % IMAGE_SIZE), y = int(i / IMAGE_SIZE);
+				glm::vec3 receivers[MAX_NEIGHBOURS + 1] = {points[i]};
+				Reservoir inputs[MAX_NEIGHBOURS + 1] = {current[i]};
+				uint32_t count = 1;
+				for (uint32_t k = 0; k < std::min(config.neighbours, MAX_NEIGHBOURS); ++k) {
+					int nx = x + offset(rnd), ny = y + offset(rnd);
+					if ((nx == x && ny == y) || nx < 0 || ny < 0 || nx >= int(IMAGE_SIZE) || ny >= int(IMAGE_SIZE)) continue;
+					uint32_t j = uint32_t(ny) * IMAGE_SIZE + uint32_t(nx);
+					receivers[count] = points[j];
+					inputs[count++] = current[j];
+				}
+
+				float picked;
+				spatial[i] = combine(lights, receivers, inputs, count, up, rnd, picked);
+				// RestirShade without the shadow ray, the estimate is the target times W
+				estimate[i] = picked * spatial[i].weight;
+			}
+			std::swap(history, spatial);
+		}
+
+		double frameSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+		if (frame < WARMUP_FRAMES) continue;
+		seconds += frameSeconds;
+		for (uint32_t i = 0; i < pixels; ++i) {
+			double relative = (double(estimate[i]) - expected[i]) / expected[i];
+			errorSq[i] += relative * relative;
+			error[i] += relative;
+		}
+	}
+
+	Result result;
+	for (uint32_t i = 0; i < pixels; ++i) {
+		result.rmse += errorSq[i] / MEASURED_FRAMES;
+		result.bias += error[i] / MEASURED_FRAMES;
+	}
+	result.rmse = std::sqrt(result.rmse / pixels);
+	result.bias /= pixels;
+	result.milliseconds = seconds * 1000.0 / MEASURED_FRAMES;
+	return result;
+}
+
+int main() {
+	std::default_random_engine rnd(1337);
+	const Config configs[] = {
+		{"nee", 0, false, 0},
+		{"ris 4", 4, false, 0},
+		{"ris 16", 16, false, 0},
+		{"ris 32", 32, false, 0},
+		{"ris 16 + temporal", 16, true, 0},
+		{"ris 16 + spatial 5", 16, false, 5},
+		{"ris 4 + temporal + spatial 5", 4, true, 5},
+		{"ris 16 + temporal + spatial 5", 16, true, 5},
+	};
+
+	std::printf("%8s %32s %12s %12s %12s\n", "lights", "estimator", "rel rmse", "rel bias", "ms/frame");
+	for (uint32_t count : {16u, 256u, 4096u}) {
+		float extent = layerExtent(count);
+		auto lights = generateLights(count, extent, rnd);
+		LightBVH tree;
+		tree.build(lights);
+
+		// one receiver per pixel on the patch of ground a view would show, the light density stays the same
+		std::vector<glm::vec3> points;
+		std::vector<float> expected;
+		for (uint32_t y = 0; y < IMAGE_SIZE; ++y) {
+			for (uint32_t x = 0; x < IMAGE_SIZE; ++x) {
+				glm::vec3 p{((float(x) + 0.5f) / IMAGE_SIZE - 0.5f) * VIEW_SIZE, 0.0f, ((float(y) + 0.5f) / IMAGE_SIZE - 0.5f) * VIEW_SIZE};
+				points.push_back(p);
+				expected.push_back(reference(lights, p, {0.0f, 1.0f, 0.0f}));
+			}
+		}
+
+		for (const auto& config : configs) {
+			Result result = run(config, tree, lights, points, expected, rnd);
+			std::printf("%8u %32s %12.3f %12.4f %12.2f\n", count, config.name, result.rmse, result.bias, result.milliseconds);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,66 @@
+//
+// Created by Fatih on 8/30/2022.
+//
+
+#include "BenchScenes.hpp"
+#include "graphics/accel/BVH.hpp"
+#include "graphics/accel/WideBVH.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace ph;
+using Clock = std::chrono::steady_clock;
+
+template<typename Tree>
+static double trace(const Tree& tree, const std::vector<Ray>& rays, const std::vector<Sphere>& spheres, std::vector<float>& distances, TraversalStats& stats) {
+	std::vector<Box> boxes;
+	distances.resize(rays.size());
+	auto start = Clock::now();
+	for (size_t i = 0; i < rays.size(); ++i) {
+		RayHit hit;
+		tree.intersect(rays[i], hit, spheres, boxes, &stats);
+		distances[i] = hit.distance;
+	}
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main() {
+	std::default_random_engine rnd(1337);
+	const uint32_t rayCount = 1 << 18;
+
+	std::printf("%10s %8s %12s %12s %10s %10s %10s %10s %10s\n", "spheres", "layout", "nodes", "memory (KB)", "Mray/s", "fetches", "box tests", "prim tests", "mismatch");
+	for (uint32_t count : {1000u, 10000u, 100000u, 1000000u}) {
+		// keep the density roughly constant so the numbers stay comparable across scene sizes
+		float extent = cubeExtent(count);
+		auto spheres = generateSpheres(count, extent, rnd);
+		auto rays = generateRays(rayCount, {0, 0, extent * 1.5f}, 0.0f, 0.6f, rnd);
+
+		BVH bvh;
+		bvh.build(spheres, {});
+		WideBVH wide;
+		wide.build(bvh);
+
+		TraversalStats binaryStats, wideStats;
+		std::vector<float> binaryHits, wideHits;
+		double binaryTime = trace(bvh, rays, spheres, binaryHits, binaryStats);
+		double wideTime = trace(wide, rays, spheres, wideHits, wideStats);
+
+		uint32_t mismatches = 0;
+		for (size_t i = 0; i < rays.size(); ++i) {
+			if (binaryHits[i] != wideHits[i]) mismatches++;
+		}
+
+		auto row = [&](const char* layout, size_t nodes, size_t bytes, double time, const TraversalStats& stats) {
+			std::printf("%10u %8s %12zu %12.1f %10.3f %10.2f %10.2f %10.2f %10u\n", count, layout, nodes, double(bytes) / 1024.0,
+						double(rays.size()) / time / 1e6, double(stats.nodes) / rays.size(), double(stats.boxTests) / rays.size(),
+						double(stats.primTests) / rays.size(), mismatches);
+		};
+		row("binary", bvh.nodeCount(), bvh.nodeCount() * sizeof(BVHNode), binaryTime, binaryStats);
+		row("wide4", wide.nodeCount(), wide.nodeCount() * sizeof(WideBVHNode), wideTime, wideStats);
+	}
+	return 0;
+}
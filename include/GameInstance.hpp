@@ -6,68 +6,34 @@
 #define PTDEMO_GAMEINSTANCE_HPP
 
 #include <vector>
+#include "graphics/AdaptiveSampler.hpp"
+#include "graphics/Denoiser.hpp"
+#include "graphics/LightResampler.hpp"
 #include "graphics/RenderCamera.hpp"
 #include "graphics/Renderer.hpp"
 #include "graphics/RenderEngine.hpp"
+#include "graphics/MaterialTable.hpp"
+#include "graphics/PackedScene.hpp"
+#include "graphics/QualityController.hpp"
+#include "graphics/RenderSettings.hpp"
+#include "graphics/SamplerTables.hpp"
+#include "graphics/TemporalReuse.hpp"
+#include "graphics/Primitives.hpp"
+#include "graphics/SceneFile.hpp"
+#include "graphics/WavefrontIntegrator.hpp"
+#include "graphics/accel/BVH.hpp"
+#include "graphics/accel/LBVH.hpp"
+#include "graphics/accel/Instancing.hpp"
+#include "graphics/accel/LightBVH.hpp"
+#include "graphics/accel/UniformGrid.hpp"
+#include "graphics/mesh/ObjLoader.hpp"
+#include "util/ThreadPool.hpp"
 
 #include <chrono>
 #include <random>
 
 namespace ph {
 
-struct Material {
-	glm::vec3 albedo;
-	float metallic;
-    float roughness;
-    float specular;
-    float specTrans;
-    float ior;
-};
-
-struct Plane {
-	glm::vec3 position;
-	float pad0;
-	glm::vec3 normal;
-	float pad1;
-	glm::vec3 color;
-	float pad2;
-	Material mat;
-};
-
-struct Sphere {
-	glm::vec3 position;
-	float pad0;
-	glm::vec3 color;
-	float radius;
-	Material mat;
-};
-
-struct Box {
-	Box(const glm::vec3 pos, const glm::vec3 size, const glm::vec3 color, const Material& mat) : min(pos), max(pos + size), color(color), mat(mat) {}
-
-	glm::vec3 min;
-	float pad0;
-	glm::vec3 max;
-	float pad1;
-	glm::vec3 color;
-	float pad2;
-	Material mat;
-};
-
-struct DirectLight {
-    glm::vec3 direction;
-    float intensity;
-    glm::vec3 color;
-    float pad0;
-};
-
-struct SpotLight {
-    glm::vec3 position;
-    float intensity;
-    glm::vec3 color;
-    float radius;
-};
-
 struct MovementInput {
 	RenderCamera& camera;
 
@@ -115,9 +81,86 @@ struct MovementInput {
 class GameInstance {
 public:
 
-	void init();
+	// path optionally names a scene file (SCENE_FILE_EXTENSION) replacing the default scene,
+	// or an OBJ file placed in it as an instanced mesh
+	void init(const std::string& path = "");
+
+	// the hardcoded spheres, boxes and lights used without a scene file
+	void createDefaultScene();
+
+	// replaces the scene arrays with the ones in a scene file, adopting its prebuilt BVH if it has one
+	void loadScene(const std::string& path);
+
+	// writes the current scene and its BVH, errors are logged instead of thrown
+	void saveScene(const std::string& path);
+
+	void randomizeSpheres(std::vector<Sphere>& out);
+
+	// scatters copies of a small sphere/box cluster over the ground as instances of one group
+	void createInstances();
+
+	void loadMesh(const std::string& path);
+
+	// builds a new BVH on the thread pool, either for freshly randomized spheres or for the current ones
+	// once refits degraded the tree. tickGame swaps the result in when the task is done.
+	void rebuildSceneAsync(bool randomize);
+
+	void finishRebuild();
+
+	void animateSpheres(float dt);
+
+	void uploadBVH();
 
-	void randomizeSpheres();
+	// switches between the CPU builder and the per-frame GPU builder
+	void toggleGpuBVH();
+
+	// rebuilds the uniform grid from the current spheres and uploads it
+	void uploadGrid();
+
+	// repacks a spot light after it changed and refits the light BVH to it
+	void updateSpotLight(uint32_t index);
+
+	// traces the uniform grid instead of the BVH
+	void toggleGrid();
+
+	// switches between the megakernel and the wavefront integrator
+	void toggleWavefront();
+
+	// moves the path depth limits by the given steps, keeping 1 <= maxDepth <= MAX_PATH_DEPTH
+	void changePathDepth(int maxStep, int minStep);
+
+	// renders with the given scale, samples and depth from the next frame on
+	void applyQuality(const QualityController::Quality& quality);
+
+	// lets QualityController pick the quality for a frame time budget, up to m_qualityLimits
+	void toggleAutoQuality();
+
+	// switches to the next SamplerType
+	void cycleSampler();
+
+	void toggleAdaptive();
+
+	// moves the adaptive sample budget by the given share of a uniform frame
+	void changeAdaptiveBudget(float step);
+
+	// reprojects the previous frame while the camera moves
+	void toggleTemporal();
+
+	void toggleDenoiser();
+
+	// resamples the direct light of the primary hits, see LightResampler
+	void toggleRestir();
+
+	// steps through the candidates per pixel and the neighbours the spatial pass reuses
+	void cycleRestirCandidates();
+
+	void cycleRestirNeighbours();
+
+	// shows the samples every pixel got in place of the image
+	void toggleSampleMap();
+
+	// integrator, throughput and path statistics for the window title
+	[[nodiscard]] std::string renderStatus() const;
 
 	void run();
 
@@ -142,9 +185,50 @@ private:
 	std::vector<Box> boxes;
 	std::vector<SpotLight> spotLights;
 	std::vector<DirectLight> directLights;
+	MaterialTable m_materials;
+	PackedScene m_packed;
+	BVH m_bvh;
+	LightBVH m_lightBVH;
+	LBVH m_lbvh;
+	WavefrontIntegrator m_wavefront;
+	AdaptiveSampler m_adaptive;
+	TemporalReuse m_temporal;
+	Denoiser m_denoiser;
+	LightResampler m_resampler;
+	RenderSettings m_settings;
+	// the samples and depth set with the keys, the frame budget stays below them
+	QualityController::Quality m_qualityLimits{1.0f, m_camera.m_samples, m_settings.maxDepth};
+	QualityController m_qualityController;
+	bool m_autoQuality = false;
+	PathStats m_pathStats;
+	SamplerTables m_samplerTables;
+	InstancedScene m_instances;
+	UniformGrid m_grid;
+	GridInfo m_gridInfo{};
+	bool m_useGrid = false;
 
 	std::default_random_engine rnd;
 
+	static constexpr uint32_t MAX_PATH_DEPTH = 32;
+
+	// refits past this SAH cost ratio trigger a background rebuild
+	static constexpr float BVH_REBUILD_THRESHOLD = 1.3f;
+
+	bool m_animate = false;
+	float m_animationTime = 0.0f;
+	std::vector<uint32_t> m_dirtyRefs;
+	std::vector<uint32_t> m_movedDuringRebuild;
+
+	bool m_rebuildPending = false;
+	bool m_pendingRandomized = false;
+	std::vector<Sphere> m_pendingSpheres;
+	std::vector<SpotLight> m_pendingSpotLights;
+	BVH m_pendingBvh;
+	TaskGroup m_rebuildTask;
+
+	// declared last so queued builds are joined before the scene data goes away
+	ThreadPool m_pool;
+
 };
 
 } // ph
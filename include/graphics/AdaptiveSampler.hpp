@@ -0,0 +1,66 @@
+//
+// Created by Fatih on 9/16/2022.
+//
+
+#ifndef PTDEMO_ADAPTIVESAMPLER_HPP
+#define PTDEMO_ADAPTIVESAMPLER_HPP
+
+#include "graphics/Renderer.hpp"
+#include "graphics/RenderSettings.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace ph {
+
+// Layout matches AdaptiveStatsBuf in shaders/adaptive/Adaptive.glsl, totals of the last finished frame
+struct AdaptiveStats {
+	// fixed point, AdaptiveSampler::ERROR_SCALE per unit, fewer on images so large the sum would pass 2^31
+	uint32_t errorSum = 0;
+	// pixels above the error threshold
+	uint32_t activePixels = 0;
+	// samples handed out for the next frame
+	uint32_t budgetSamples = 0;
+};
+
+// Per-pixel sample budgets from running variance estimates, see shaders/adaptive/Adaptive.glsl.
+// The variance buffers are always kept up to date, since the accumulation weighs frames by their
+// sample count. The error and budget passes only run while RenderSettings::adaptive is set.
+class AdaptiveSampler {
+public:
+
+	static constexpr uint32_t VARIANCE_BINDING = 38;
+	static constexpr uint32_t BUDGET_BINDING = 39;
+	static constexpr uint32_t STATS_BINDING = 40;
+
+	// mirrors ADAPTIVE_ERROR_SCALE
+	static constexpr float ERROR_SCALE = 256.0f;
+
+	// adds the buffers and passes, must be called before Renderer::postInitialize
+	void init(Renderer* renderer, const RenderSettings* settings, uint32_t width, uint32_t height);
+
+	// sizes the per-pixel buffers for a new image
+	void resize(uint32_t width, uint32_t height);
+
+	[[nodiscard]] const AdaptiveStats& stats() const { return m_stats; }
+
+	// share of the pixels that still got samples in the last frame
+	[[nodiscard]] float activeShare() const {
+		VkExtent2D extent = m_renderer->renderExtent();
+		return float(m_stats.activePixels) / float(std::max(extent.width * extent.height, 1u));
+	}
+
+private:
+
+	void allocate();
+
+	Renderer* m_renderer = nullptr;
+	const RenderSettings* m_settings = nullptr;
+	AdaptiveStats m_stats;
+	uint32_t m_width = 1;
+	uint32_t m_height = 1;
+};
+
+} // ph
+
+#endif //PTDEMO_ADAPTIVESAMPLER_HPP
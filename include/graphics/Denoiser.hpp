@@ -0,0 +1,44 @@
+//
+// Created by Fatih on 9/18/2022.
+//
+
+#ifndef PTDEMO_DENOISER_HPP
+#define PTDEMO_DENOISER_HPP
+
+#include "graphics/Renderer.hpp"
+#include "graphics/RenderSettings.hpp"
+
+#include <cstdint>
+
+namespace ph {
+
+// SVGF style a-trous denoiser over the accumulation, see shaders/denoise/Svgf.glsl. Only the displayed
+// image is filtered, the accumulation and its statistics stay unbiased.
+class Denoiser {
+public:
+
+	static constexpr uint32_t GBUFFER_BINDING = 45;
+	static constexpr uint32_t FILTER_BINDING = 46;
+
+	// a-trous levels, the last one reaches 2^(ITERATIONS - 1) * 2 pixels. Mirrors DENOISE_ITERATIONS.
+	static constexpr uint32_t ITERATIONS = 5;
+
+	// adds the buffers and passes, must be called before Renderer::postInitialize
+	void init(Renderer* renderer, const RenderSettings* settings, uint32_t width, uint32_t height);
+
+	// sizes the G-buffer and the filter images for a new image
+	void resize(uint32_t width, uint32_t height);
+
+private:
+
+	void allocate();
+
+	Renderer* m_renderer = nullptr;
+	const RenderSettings* m_settings = nullptr;
+	uint32_t m_width = 1;
+	uint32_t m_height = 1;
+};
+
+} // ph
+
+#endif //PTDEMO_DENOISER_HPP
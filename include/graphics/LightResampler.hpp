@@ -0,0 +1,49 @@
+//
+// Created by Fatih on 9/21/2022.
+//
+
+#ifndef PTDEMO_LIGHTRESAMPLER_HPP
+#define PTDEMO_LIGHTRESAMPLER_HPP
+
+#include "graphics/Renderer.hpp"
+#include "graphics/RenderSettings.hpp"
+
+#include <cstdint>
+
+namespace ph {
+
+// Spatiotemporal reservoir resampling of the direct light at the primary hits (ReSTIR, Bitterli et al.
+// 2020), see shaders/restir/Restir.glsl. Four passes run before the trace: the candidate pass draws
+// light samples for every pixel, the temporal pass merges the reservoir the pixel's surface had in the
+// previous frame and the spatial pass those of nearby pixels. The shade pass traces the shadow ray of the
+// final pick, and the path tracer adds the result in place of its own light sample at the first bounce.
+class LightResampler {
+public:
+
+	static constexpr uint32_t RESERVOIR_BINDING = 49;
+	static constexpr uint32_t SURFACE_BINDING = 50;
+	static constexpr uint32_t RADIANCE_BINDING = 51;
+
+	// neighbours the spatial pass looks at are capped by this, mirrors RESTIR_MAX_NEIGHBOURS
+	static constexpr uint32_t MAX_NEIGHBOURS = 16;
+
+	// adds the buffers and passes, must be called before Renderer::postInitialize and after
+	// TemporalReuse::init, the shade pass records the camera the temporal reprojection reads
+	void init(Renderer* renderer, const RenderSettings* settings, uint32_t width, uint32_t height);
+
+	// sizes the per-pixel buffers for a new image, the reservoirs don't survive it
+	void resize(uint32_t width, uint32_t height);
+
+private:
+
+	void allocate();
+
+	Renderer* m_renderer = nullptr;
+	const RenderSettings* m_settings = nullptr;
+	uint32_t m_width = 1;
+	uint32_t m_height = 1;
+};
+
+} // ph
+
+#endif //PTDEMO_LIGHTRESAMPLER_HPP
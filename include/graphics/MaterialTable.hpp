@@ -0,0 +1,47 @@
+//
+// Created by Fatih on 9/5/2022.
+//
+
+#ifndef PTDEMO_MATERIALTABLE_HPP
+#define PTDEMO_MATERIALTABLE_HPP
+
+#include "graphics/Primitives.hpp"
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace ph {
+
+// Deduplicated materials of the whole scene, uploaded as one buffer. Spheres, planes, boxes and triangles
+// reference entries by index and the shader only reads the entry of the closest hit.
+class MaterialTable {
+public:
+
+	// returns the index of an identical entry when there is one
+	uint32_t add(const Material& material);
+
+	// replaces the table, e.g. with the one stored in a scene file. Duplicates are kept so indices stay valid.
+	void assign(std::span<const Material> materials);
+
+	[[nodiscard]] size_t size() const { return m_materials.size(); }
+
+	std::vector<Material> m_materials;
+
+private:
+
+	struct Hash {
+		size_t operator()(const Material& material) const;
+	};
+
+	struct Equal {
+		bool operator()(const Material& a, const Material& b) const;
+	};
+
+	std::unordered_map<Material, uint32_t, Hash, Equal> m_lookup;
+};
+
+} // ph
+
+#endif //PTDEMO_MATERIALTABLE_HPP
@@ -0,0 +1,55 @@
+//
+// Created by Fatih on 9/7/2022.
+//
+
+#ifndef PTDEMO_PACKEDSCENE_HPP
+#define PTDEMO_PACKEDSCENE_HPP
+
+#include "graphics/Primitives.hpp"
+#include "graphics/Renderer.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace ph {
+
+// Packs the scene's spheres, boxes, planes and spot lights into the renderer's tagged primitive stream.
+// The traversal only touches the packed geometry, material indices live in the stream's own array
+// and are read once a primitive is actually hit.
+class PackedScene {
+public:
+
+	// payload words per primitive: vec4(center, radius) per sphere, vec4(min, 0), vec4(max, 0) per box,
+	// vec4(position, 0), vec4(normal, 0) per plane and the SpotLight itself per spot light
+	static constexpr uint32_t SPHERE_STRIDE = 1;
+	static constexpr uint32_t BOX_STRIDE = 2;
+	static constexpr uint32_t PLANE_STRIDE = 2;
+	static constexpr uint32_t SPOT_LIGHT_STRIDE = 2;
+
+	// registers the primitive types and packs all of them
+	void init(Renderer* renderer, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes,
+			  const std::vector<Plane>& planes, const std::vector<SpotLight>& spotLights);
+
+	// repacks spheres and boxes, their counts may have changed
+	void update(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes);
+
+	// repacks and uploads the geometry of spheres [first, last) after they moved, materials are left alone
+	void updateSpheres(const std::vector<Sphere>& spheres, uint32_t first, uint32_t last);
+
+	void updateSpotLight(const std::vector<SpotLight>& spotLights, uint32_t index);
+
+private:
+
+	void packSpheres(const std::vector<Sphere>& spheres);
+
+	void packBoxes(const std::vector<Box>& boxes);
+
+	Renderer* m_renderer = nullptr;
+
+	std::vector<glm::vec4> m_payload;
+	std::vector<uint32_t> m_materials;
+};
+
+} // ph
+
+#endif //PTDEMO_PACKEDSCENE_HPP
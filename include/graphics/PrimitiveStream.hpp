@@ -0,0 +1,75 @@
+//
+// Created by Fatih on 9/9/2022.
+//
+
+#ifndef PTDEMO_PRIMITIVESTREAM_HPP
+#define PTDEMO_PRIMITIVESTREAM_HPP
+
+#define GLM_FORCE_SWIZZLE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ph {
+
+constexpr uint32_t MAX_PRIMITIVE_TYPES = 16;
+
+// Layout matches PrimitiveTypeRange in shaders/common/Scene.glsl (std430, 16 bytes).
+// Primitive i of the type starts at payload word payloadOffset + i * stride, its material
+// index is at materialOffset + i.
+struct PrimitiveTypeRange {
+	uint32_t payloadOffset;
+	uint32_t stride;
+	uint32_t materialOffset;
+	uint32_t count;
+};
+
+struct PrimitiveStreamInfo {
+	uint32_t unboundedCount;
+	uint32_t pad0, pad1, pad2;
+	PrimitiveTypeRange types[MAX_PRIMITIVE_TYPES];
+};
+
+// Host side of the tagged primitive stream. Every primitive type is a range of one shared payload
+// array of 16-byte words and one shared material index array, indexed by the same tagged refs the
+// acceleration structures store (see makePrimRef). Types are kept in tag order, changing the count
+// of one type moves the ranges after it.
+class PrimitiveStream {
+public:
+
+	static constexpr uint32_t PAYLOAD_BINDING = 1;
+	static constexpr uint32_t MATERIAL_BINDING = 2;
+	static constexpr uint32_t INFO_BINDING = 3;
+	// refs of the primitives of unbounded types, the shader tests them for every ray
+	static constexpr uint32_t UNBOUNDED_BINDING = 4;
+
+	// throws std::runtime_error for tags past MAX_PRIMITIVE_TYPES or registering a tag twice
+	void addType(uint32_t tag, uint32_t stride, bool unbounded);
+
+	// replaces all primitives of a type, payload holds count * stride words
+	void set(uint32_t tag, size_t count, const glm::vec4* payload, const uint32_t* materials);
+
+	// overwrites the payload of primitives [first, last), returns the changed byte range of the payload array
+	std::pair<size_t, size_t> update(uint32_t tag, uint32_t first, uint32_t last, const glm::vec4* payload);
+
+	std::vector<glm::vec4> m_payload;
+	std::vector<uint32_t> m_materials;
+	std::vector<uint32_t> m_unboundedRefs;
+	PrimitiveStreamInfo m_info{};
+
+private:
+
+	PrimitiveTypeRange& range(uint32_t tag);
+
+	// recomputes the offsets of all types and the unbounded ref list
+	void layout();
+
+	uint32_t m_registered = 0;
+	uint32_t m_unbounded = 0;
+};
+
+} // ph
+
+#endif //PTDEMO_PRIMITIVESTREAM_HPP
@@ -0,0 +1,75 @@
+//
+// Created by Fatih on 8/16/2022.
+//
+
+#ifndef PTDEMO_PRIMITIVES_HPP
+#define PTDEMO_PRIMITIVES_HPP
+
+#define GLM_FORCE_SWIZZLE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace ph {
+
+// Entry of the shared material table (see MaterialTable), primitives only store its index.
+// color is what a hit contributes to the path, the remaining fields feed the BRDF.
+struct Material {
+	glm::vec3 albedo;
+	float metallic;
+    float roughness;
+    float specular;
+    float specTrans;
+    float ior;
+	glm::vec3 color;
+	float pad0;
+};
+
+struct Plane {
+	glm::vec3 position;
+	uint32_t material;
+	glm::vec3 normal;
+	float pad0;
+};
+
+// 20 bytes, instanced spheres are read with the scalar block layout. Scene spheres go through PackedScene.
+struct Sphere {
+	glm::vec3 position;
+	float radius;
+	uint32_t material;
+};
+
+struct Box {
+	Box(const glm::vec3 pos, const glm::vec3 size, uint32_t material) : min(pos), material(material), max(pos + size) {}
+
+	glm::vec3 min;
+	uint32_t material;
+	glm::vec3 max;
+	float pad0 = 0;
+};
+
+// vertex indices are global into the shared vertex buffer
+struct Triangle {
+	uint32_t v0;
+	uint32_t v1;
+	uint32_t v2;
+	uint32_t material;
+};
+
+struct DirectLight {
+    glm::vec3 direction;
+    float intensity;
+    glm::vec3 color;
+    float pad0;
+};
+
+struct SpotLight {
+    glm::vec3 position;
+    float intensity;
+    glm::vec3 color;
+    float radius;
+};
+
+} // ph
+
+#endif //PTDEMO_PRIMITIVES_HPP
@@ -0,0 +1,69 @@
+//
+// Created by Fatih on 9/19/2022.
+//
+
+#ifndef PTDEMO_QUALITYCONTROLLER_HPP
+#define PTDEMO_QUALITYCONTROLLER_HPP
+
+#include <cstdint>
+
+namespace ph {
+
+// Keeps the device frame time near a budget by trading render scale, samples per pixel and path depth.
+// Motion drops straight to one sample and a short depth, at the render scale that fit the budget during
+// the last motion, and keeps adjusting the scale from there. Once the view rests the scale and depth
+// return to the limits and the samples grow as long as the frames stay within the budget. A resting view
+// that is over budget at one sample gives up render scale and then path depth, and gets them back first
+// when there is headroom again.
+class QualityController {
+public:
+
+	struct Quality {
+		float scale = 1.0f;
+		int samples = 1;
+		uint32_t maxDepth = 8;
+	};
+
+	static constexpr float DEFAULT_BUDGET = 16.6f;
+
+	// path depth while moving, the first bounces carry most of what motion lets the eye see
+	static constexpr uint32_t MOTION_DEPTH = 3;
+
+	// ticks the view has to rest before refining
+	static constexpr uint32_t STILL_TICKS = 15;
+
+	// ticks after a change before the next one, the measured time lags a few frames behind
+	static constexpr uint32_t COOLDOWN_TICKS = 5;
+
+	// render scales are kept to steps of this, so small timing changes don't restart the accumulation
+	static constexpr float SCALE_STEP = 0.05f;
+
+	// budget in milliseconds of device time per frame
+	void setBudget(float budget) { m_budget = budget; }
+
+	[[nodiscard]] float budget() const { return m_budget; }
+
+	// Called once per game tick with the device time of the last frame and whether the view changed.
+	// Returns the quality to render with, never above limits.
+	Quality update(float gpuTime, bool moving, const Quality& limits);
+
+	// starts over from the limits, e.g. after the controller was off for a while
+	void reset(const Quality& limits);
+
+private:
+
+	[[nodiscard]] float fitScale(float scale) const;
+
+	Quality m_quality;
+	float m_budget = DEFAULT_BUDGET;
+	float m_motionScale = 1.0f;
+	// running average of the device time since the last change
+	float m_frameTime = 0.0f;
+	uint32_t m_stillTicks = 0;
+	uint32_t m_cooldown = 0;
+	bool m_moving = false;
+};
+
+} // ph
+
+#endif //PTDEMO_QUALITYCONTROLLER_HPP
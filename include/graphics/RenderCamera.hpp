@@ -50,6 +50,14 @@ public:
 		updatePosition(m_position.xyz() + motion);
 	}
 
+	// true when the position or forward changed since the last call, which brings the old ones up to date
+	bool syncView() {
+		bool changed = m_position != m_oldPosition || m_forward != m_oldForward;
+		m_oldPosition = m_position;
+		m_oldForward = m_forward;
+		return changed;
+	}
+
 	glm::vec4 m_position;
 	glm::vec4 m_oldPosition{};
     glm::vec4 m_forward{};
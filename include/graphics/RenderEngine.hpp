@@ -8,8 +8,10 @@
 #include "graphics/vulkan/VulkanRenderer.hpp"
 
 #include <vulkan/vulkan.h>
+#include <chrono>
 #include <stdexcept>
 #include <functional>
+#include <string>
 
 namespace ph {
 
@@ -22,7 +24,13 @@ public:
 
 	void close() { m_shouldClose = true; }
 
-	void updateTitle();
+	// the title is rewritten at most this often, the status is only worth building when it is due
+	static constexpr std::chrono::milliseconds TITLE_INTERVAL{250};
+
+	[[nodiscard]] bool titleDue() const { return std::chrono::steady_clock::now() - m_lastTitle >= TITLE_INTERVAL; }
+
+	// shows the frame rate and the given status
+	void updateTitle(const std::string& status);
 
 	void destroy();
 
@@ -32,6 +40,10 @@ public:
 	std::function<void(const SDL_Event&)> m_eventHandler;
 
 	bool m_shouldClose = false;
+
+private:
+
+	std::chrono::steady_clock::time_point m_lastTitle{};
 };
 
 } // ph
@@ -0,0 +1,81 @@
+//
+// Created by Fatih on 9/14/2022.
+//
+
+#ifndef PTDEMO_RENDERSETTINGS_HPP
+#define PTDEMO_RENDERSETTINGS_HPP
+
+#include <cstdint>
+
+namespace ph {
+
+// matches the SAMPLER_* defines in shaders/common/Sampler.glsl
+enum class SamplerType : uint32_t {
+	PCG = 0,
+	Sobol = 1,
+	BlueNoise = 2
+};
+
+// what the image shows in place of the render, matches the DEBUG_VIEW_* defines in shaders/adaptive/Adaptive.glsl
+enum class DebugView : uint32_t {
+	None = 0,
+	SampleMap = 1
+};
+
+// adaptive pixels trace at most this many times camera.samples, mirrors ADAPTIVE_MAX_SAMPLE_SCALE
+constexpr uint32_t ADAPTIVE_MAX_SAMPLE_SCALE = 4;
+
+// binding of RenderSettingsBuf in shaders/RTNew.comp
+constexpr uint32_t RENDER_SETTINGS_BINDING = 34;
+
+// Layout matches RenderSettingsBuf in shaders/RTNew.comp (std430). Changes are uploaded by marking
+// the buffer dirty, which also restarts the accumulation.
+struct RenderSettings {
+	// bounces per sample
+	uint32_t maxDepth = 8;
+	// paths are only ended by Russian roulette after this many bounces
+	uint32_t minDepth = 3;
+	SamplerType sampler = SamplerType::Sobol;
+	// spend the samples where the estimated error is high, see AdaptiveSampler
+	uint32_t adaptive = 0;
+	// samples of an adaptive frame relative to a uniform frame of camera.samples per pixel
+	float adaptiveBudget = 0.5f;
+	// relative standard error of a pixel's mean below which it stops getting samples
+	float adaptiveThreshold = 0.02f;
+	DebugView debugView = DebugView::None;
+	// reproject the previous result into frames that restart the accumulation, see TemporalReuse
+	uint32_t temporal = 0;
+	// filter the displayed image, see Denoiser
+	uint32_t denoise = 0;
+	// resample the direct light of the primary hits with reservoirs, see LightResampler
+	uint32_t restir = 0;
+	// light samples drawn per pixel and frame before the reuse
+	uint32_t restirCandidates = 16;
+	// pixels the spatial pass reuses, at most LightResampler::MAX_NEIGHBOURS
+	uint32_t restirNeighbours = 5;
+	// radius in pixels the spatial pass picks them from
+	float restirRadius = 30.0f;
+	// the previous frame's reservoir counts at most this many times the new candidates
+	uint32_t restirHistoryLimit = 20;
+};
+
+inline const char* samplerName(SamplerType sampler) {
+	switch (sampler) {
+		case SamplerType::PCG: return "pcg";
+		case SamplerType::Sobol: return "sobol";
+		case SamplerType::BlueNoise: return "blue noise";
+	}
+	return "unknown";
+}
+
+// Layout matches PathStatsBuf in shaders/RTNew.comp, totals of the last finished frame
+struct PathStats {
+	uint32_t paths = 0;
+	uint32_t vertices = 0;
+
+	[[nodiscard]] float averageLength() const { return paths > 0 ? float(vertices) / float(paths) : 0.0f; }
+};
+
+} // ph
+
+#endif //PTDEMO_RENDERSETTINGS_HPP
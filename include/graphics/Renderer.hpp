@@ -6,11 +6,57 @@
 #define PTDEMO_RENDERER_HPP
 
 #include <SDL2/SDL.h>
+#include <vulkan/vulkan_core.h>
 
-struct VkExtent2D;
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
 
 namespace ph {
 
+enum class PassStage {
+	PreTrace,  // before the path tracing dispatch, e.g. acceleration structure builds
+	Trace,     // replaces the path tracing dispatch for the frame while any of these is enabled
+	PostTrace  // after it, e.g. image filters
+};
+
+// An extra compute dispatch sharing the descriptor set and push constants of the main pipeline.
+struct ComputePassInfo {
+	std::string shader;
+	PassStage stage = PassStage::PreTrace;
+	// workgroup count, evaluated every frame
+	std::function<std::array<uint32_t, 3>()> groups;
+	// skipped for the frame when this returns false
+	std::function<bool()> enabled = [] { return true; };
+	// specialization constants, constant_id i gets constants[i]
+	std::vector<uint32_t> constants;
+	// Records this pass and the loopLength - 1 passes after it as a block, iterations() times in a row.
+	// The first pass of the block decides its stage and whether it runs, FrameConstants::loopIteration
+	// tells the shaders which iteration they are in.
+	uint32_t loopLength = 1;
+	std::function<uint32_t()> iterations = [] { return 1u; };
+	// when not negative, the workgroup count is read on the device from the buffer at this binding,
+	// indirectOffset(loopIteration) bytes in, instead of calling groups
+	int32_t indirectBinding = -1;
+	std::function<uint32_t(uint32_t)> indirectOffset = [](uint32_t) { return 0u; };
+};
+
+// Appended by the renderer right after the block given to setPushConstants, shaders declare these
+// fields at the end of their push constant block.
+struct FrameConstants {
+	// frames already blended into the accumulation image, 0 starts a new image
+	uint32_t accumulatedFrames = 0;
+	// grows every frame, for seeding the samplers
+	uint32_t frameIndex = 0;
+	// iteration of the pass loop being recorded, see ComputePassInfo::loopLength
+	uint32_t loopIteration = 0;
+	// traced part of the images, see Renderer::setRenderScale
+	uint32_t renderWidth = 0;
+	uint32_t renderHeight = 0;
+};
+
 class Renderer {
 public:
 
@@ -26,9 +72,56 @@ public:
 
 	virtual void addUniform(uint32_t index, size_t size, void* data) = 0;
 
+	// Counters the shaders add to during a frame, e.g. statistics. The buffer is zeroed before every
+	// frame and data receives its contents once the frame finished.
+	virtual void addCounters(uint32_t index, size_t size, void* data) = 0;
+
+	// points an already added buffer at new data, the device buffer is reallocated when the size changes.
+	// Buffers without host data are device local and only written by shaders.
+	virtual void updateBuffer(uint32_t index, size_t size, void* data) = 0;
+
+	// buffers are only uploaded when marked, call this after changing their data on the host
+	virtual void markDirty(uint32_t index, size_t offset = 0, size_t size = SIZE_MAX) = 0;
+
 	virtual void setPushConstants(uint32_t offset, size_t size, void* data) = 0;
 
+	// passes run in the order they were added, with a memory barrier after each one
+	virtual void addComputePass(const ComputePassInfo& info) = 0;
+
+	// Registers a type of the tagged primitive stream (see PrimitiveStream). All types share the stream's
+	// buffers, so adding one needs no binding and no loop of its own in the shader. stride is the number
+	// of 16-byte payload words per primitive. Primitives of unbounded types, e.g. planes, stay out of
+	// the acceleration structures and are tested for every ray.
+	virtual void addPrimitiveType(uint32_t tag, uint32_t stride, bool unbounded) = 0;
+
+	// replaces all primitives of a type, payload holds count * stride words
+	virtual void setPrimitives(uint32_t tag, size_t count, const void* payload, const uint32_t* materials) = 0;
+
+	// uploads new payload for primitives [first, last) of a type, payload starts at primitive first
+	virtual void updatePrimitives(uint32_t tag, uint32_t first, uint32_t last, const void* payload) = 0;
+
+	// Frames keep being blended into the accumulation image while nothing changes. Changed buffers and
+	// resizes restart it on their own, call this when a push constant like the camera changed.
+	virtual void resetAccumulation() = 0;
+
+	// Traces only this share of the window in each dimension, clamped to [MIN_RENDER_SCALE, 1], and
+	// scales the result up when presenting. A new scale restarts the accumulation.
+	virtual void setRenderScale(float scale) = 0;
+
+	// the traced size, per-pixel passes should dispatch over this instead of the window
+	[[nodiscard]] virtual VkExtent2D renderExtent() const = 0;
+
+	// 8x8 workgroups covering the render extent
+	[[nodiscard]] std::array<uint32_t, 3> renderGroups() const {
+		auto extent = renderExtent();
+		return {(extent.width + 7) / 8, (extent.height + 7) / 8, 1};
+	}
+
+	static constexpr float MIN_RENDER_SCALE = 0.25f;
+
 	uint32_t m_frames = 0;
+	// device time of the last finished frame in milliseconds, 0 when the queue has no timestamps
+	float m_gpuTime = 0.0f;
 };
 
 } // ph
@@ -0,0 +1,64 @@
+//
+// Created by Fatih on 9/21/2022.
+//
+
+#ifndef PTDEMO_RESERVOIR_HPP
+#define PTDEMO_RESERVOIR_HPP
+
+#define GLM_FORCE_SWIZZLE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace ph {
+
+// Layout matches Reservoir in shaders/restir/Restir.glsl (std430, 32 bytes). Weighted reservoir sampling
+// over light samples as in ReSTIR (Bitterli et al. 2020). The steps mirror ReservoirUpdate,
+// ReservoirMerge and ReservoirFinalize so the host side resamples exactly like the passes.
+// Merged reservoirs are weighted with the balance heuristic over the reservoirs' target functions scaled
+// by their counts, then finalized with a normalization of 1.
+struct Reservoir {
+	static constexpr uint32_t NO_LIGHT = 0xFFFFFFFFu;
+	// set on the indices of directional lights, they are deltas and have no point
+	static constexpr uint32_t DIRECT_LIGHT_BIT = 0x80000000u;
+
+	// where on the sphere light the pick is, as the unit offset from its center, so it follows the light
+	glm::vec3 point{0.0f};
+	uint32_t light = NO_LIGHT;
+	float weightSum = 0.0f;
+	// candidates the reservoir stands for, M in the paper
+	float count = 0.0f;
+	// unbiased contribution weight of the pick, W in the paper
+	float weight = 0.0f;
+	float pad0 = 0.0f;
+
+	[[nodiscard]] bool valid() const { return light != NO_LIGHT; }
+
+	// streams in a candidate with resampling weight w, u in [0, 1) decides whether it replaces the pick
+	bool update(uint32_t candidate, const glm::vec3& candidatePoint, float w, float u) {
+		weightSum += w;
+		count += 1.0f;
+		if (w <= 0.0f || u * weightSum >= w) return false;
+		light = candidate;
+		point = candidatePoint;
+		return true;
+	}
+
+	// streams in another pixel's reservoir, targetPdf is its pick's target function here and misWeight
+	// the share of the pick that falls to this reservoir among all that are merged
+	bool merge(const Reservoir& other, float targetPdf, float misWeight, float u) {
+		float total = count + other.count;
+		bool picked = other.valid() && update(other.light, other.point, misWeight * targetPdf * other.weight, u);
+		count = total;
+		return picked;
+	}
+
+	// normalization is the candidate count without reuse and 1 after merging
+	void finalize(float targetPdf, float normalization) {
+		weight = targetPdf > 0.0f && normalization > 0.0f ? weightSum / (normalization * targetPdf) : 0.0f;
+	}
+};
+
+} // ph
+
+#endif //PTDEMO_RESERVOIR_HPP
@@ -0,0 +1,42 @@
+//
+// Created by Fatih on 9/15/2022.
+//
+
+#ifndef PTDEMO_SAMPLERTABLES_HPP
+#define PTDEMO_SAMPLERTABLES_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace ph {
+
+// Tables of the samplers in shaders/common/Sampler.glsl, generated once at startup.
+// Sizes mirror SOBOL_DIMENSIONS, SOBOL_BITS and BLUE_NOISE_SIZE there.
+class SamplerTables {
+public:
+
+	static constexpr uint32_t SOBOL_DIMENSIONS = 4;
+	static constexpr uint32_t SOBOL_BITS = 32;
+	static constexpr uint32_t BLUE_NOISE_SIZE = 64;
+
+	static constexpr uint32_t SOBOL_BINDING = 36;
+	static constexpr uint32_t BLUE_NOISE_BINDING = 37;
+
+	void generate();
+
+	// direction numbers, SOBOL_BITS per dimension
+	std::vector<uint32_t> m_sobolDirections;
+	// BLUE_NOISE_SIZE² tile of values in [0, 1), every value appears once
+	std::vector<float> m_blueNoise;
+
+private:
+
+	void generateSobol();
+
+	// void-and-cluster (Ulichney 1993) on a toroidal tile
+	void generateBlueNoise();
+};
+
+} // ph
+
+#endif //PTDEMO_SAMPLERTABLES_HPP
@@ -0,0 +1,92 @@
+//
+// Created by Fatih on 9/3/2022.
+//
+
+#ifndef PTDEMO_SCENEFILE_HPP
+#define PTDEMO_SCENEFILE_HPP
+
+#include "graphics/Primitives.hpp"
+#include "graphics/accel/BVH.hpp"
+#include "util/MappedFile.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace ph {
+
+// Binary scene container. Every array is stored with the in-memory layout of its struct, so loading
+// is a mapping plus a copy, no parsing. The BVH, direct light and material sections upload as they
+// are, the primitives are repacked into the tagged primitive stream by PackedScene.
+//
+// [SceneFileHeader][SceneFileSection x sectionCount][padding][section data, each SCENE_FILE_ALIGNMENT aligned]...
+constexpr uint32_t SCENE_FILE_MAGIC = 0x43535450; // "PTSC"
+constexpr uint32_t SCENE_FILE_VERSION = 3;
+constexpr uint64_t SCENE_FILE_ALIGNMENT = 64;
+constexpr const char* SCENE_FILE_EXTENSION = ".ptsc";
+
+enum class SceneSection : uint32_t {
+	Spheres = 0,
+	Planes,
+	Boxes,
+	SpotLights,
+	DirectLights,
+	BVHNodes,
+	BVHPrimRefs,
+	Materials,
+	Count
+};
+
+struct SceneFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sectionCount;
+	uint32_t reserved;
+};
+
+struct SceneFileSection {
+	uint32_t type;
+	// checked on load, catches primitives whose layout changed since the file was written
+	uint32_t elementSize;
+	uint64_t offset;
+	uint64_t count;
+};
+
+// borrowed arrays of a scene, the prebuilt BVH may be left empty
+struct SceneArrays {
+	std::span<const Sphere> spheres;
+	std::span<const Plane> planes;
+	std::span<const Box> boxes;
+	std::span<const SpotLight> spotLights;
+	std::span<const DirectLight> directLights;
+	std::span<const Material> materials;
+	std::span<const BVHNode> bvhNodes;
+	std::span<const uint32_t> bvhPrimRefs;
+};
+
+// throws std::runtime_error when the file can't be written
+void writeSceneFile(const std::string& path, const SceneArrays& scene);
+
+// Maps a scene file and validates its header and sections. The arrays point into the mapping
+// and stay valid as long as the SceneFile lives.
+class SceneFile {
+public:
+
+	explicit SceneFile(const std::string& path);
+
+	[[nodiscard]] const SceneArrays& arrays() const { return m_arrays; }
+
+	[[nodiscard]] bool hasBVH() const { return !m_arrays.bvhNodes.empty(); }
+
+private:
+
+	template<typename T>
+	std::span<const T> section(const SceneFileSection& entry, const std::string& path) const;
+
+	MappedFile m_file;
+	SceneArrays m_arrays;
+};
+
+} // ph
+
+#endif //PTDEMO_SCENEFILE_HPP
@@ -0,0 +1,62 @@
+//
+// Created by Fatih on 9/17/2022.
+//
+
+#ifndef PTDEMO_TEMPORALREUSE_HPP
+#define PTDEMO_TEMPORALREUSE_HPP
+
+#include "graphics/Renderer.hpp"
+#include "graphics/RenderSettings.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace ph {
+
+// Layout matches TemporalCameraBuf in shaders/temporal/Temporal.glsl. The shaders keep it up to date,
+// the host only uploads the zeroed state, which has no history.
+struct TemporalCamera {
+	glm::vec4 position{};
+	glm::vec4 forward{};
+	glm::vec4 up{};
+	int32_t width = 0;
+	int32_t height = 0;
+	float aspectRatio = 0.0f;
+	float focalDistance = 0.0f;
+};
+
+// Reprojects the previous result into frames that restarted the accumulation, see
+// shaders/temporal/Temporal.glsl. The camera of the previous frame is recorded on the device, so it
+// matches what was rendered no matter how often the game ticks in between.
+class TemporalReuse {
+public:
+
+	static constexpr uint32_t CAMERA_BINDING = 41;
+	static constexpr uint32_t DEPTH_BINDING = 42;
+	static constexpr uint32_t MOTION_BINDING = 43;
+	static constexpr uint32_t HISTORY_BINDING = 44;
+
+	// adds the buffers and passes, must be called before Renderer::postInitialize
+	void init(Renderer* renderer, const RenderSettings* settings, uint32_t width, uint32_t height);
+
+	// sizes the per-pixel buffers for a new image, the history doesn't survive it
+	void resize(uint32_t width, uint32_t height);
+
+	// forgets the recorded camera, e.g. when the passes didn't run for a while
+	void invalidate();
+
+private:
+
+	void allocate();
+
+	Renderer* m_renderer = nullptr;
+	const RenderSettings* m_settings = nullptr;
+	TemporalCamera m_camera;
+	uint32_t m_width = 1;
+	uint32_t m_height = 1;
+};
+
+} // ph
+
+#endif //PTDEMO_TEMPORALREUSE_HPP
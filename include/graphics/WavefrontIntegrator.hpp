@@ -0,0 +1,88 @@
+//
+// Created by Fatih on 9/13/2022.
+//
+
+#ifndef PTDEMO_WAVEFRONTINTEGRATOR_HPP
+#define PTDEMO_WAVEFRONTINTEGRATOR_HPP
+
+#include "graphics/RenderCamera.hpp"
+#include "graphics/Renderer.hpp"
+#include "graphics/RenderSettings.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace ph {
+
+// Wavefront path tracer (Laine et al. 2013), runs the kernels of shaders/wavefront/Kernels.glsl as
+// trace passes in place of the megakernel. Paths live in device buffers, one slot per pixel, and move
+// between two ray queues whose dispatch arguments the kernels append to, so the intersect and shade
+// kernels are dispatched indirectly over the live paths only.
+class WavefrontIntegrator {
+public:
+
+	// mirrors WAVEFRONT_GROUP_SIZE
+	static constexpr uint32_t GROUP_SIZE = 256;
+
+	static constexpr uint32_t PATH_BINDING = 28;
+	static constexpr uint32_t HIT_BINDING = 29;
+	static constexpr uint32_t RAY_QUEUE_BINDING = 30;
+	static constexpr uint32_t SHADOW_QUEUE_BINDING = 31;
+	static constexpr uint32_t QUEUE_ARGS_BINDING = 32;
+	static constexpr uint32_t RADIANCE_BINDING = 33;
+
+	// the KERNEL specialization constant of shaders/RTNew.comp, also used by the post-trace passes of
+	// AdaptiveSampler, TemporalReuse and Denoiser
+	enum class Kernel : uint32_t {
+		Megakernel = 0,
+		Reset,
+		Generate,
+		Extend,
+		Shade,
+		Shadow,
+		Advance,
+		Resolve,
+		AdaptiveError,
+		AdaptiveBudget,
+		TemporalReproject,
+		TemporalResolve,
+		TemporalCommit,
+		DenoisePrepare,
+		DenoiseAtrous,
+		DenoiseResolve,
+		RestirCandidates,
+		RestirTemporal,
+		RestirSpatial,
+		RestirShade
+	};
+
+	// adds the path buffers and passes, must be called before Renderer::postInitialize.
+	// The camera's sample count and the maximum depth decide how many loop iterations a frame records.
+	void init(Renderer* renderer, const RenderCamera* camera, const RenderSettings* settings, uint32_t width, uint32_t height);
+
+	// sizes the path buffers for a new image, they only hold a single path while disabled
+	void resize(uint32_t width, uint32_t height);
+
+	void setEnabled(bool enabled);
+
+	[[nodiscard]] bool enabled() const { return m_enabled; }
+
+private:
+
+	void allocate();
+
+	// every path ends after maxDepth iterations at the latest, so this many finish all samples of the
+	// pixel with the largest budget
+	[[nodiscard]] uint32_t iterations() const;
+
+	Renderer* m_renderer = nullptr;
+	const RenderCamera* m_camera = nullptr;
+	const RenderSettings* m_settings = nullptr;
+	uint32_t m_width = 1;
+	uint32_t m_height = 1;
+	bool m_enabled = false;
+};
+
+} // ph
+
+#endif //PTDEMO_WAVEFRONTINTEGRATOR_HPP
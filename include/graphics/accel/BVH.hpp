@@ -0,0 +1,229 @@
+//
+// Created by Fatih on 8/20/2022.
+//
+
+#ifndef PTDEMO_BVH_HPP
+#define PTDEMO_BVH_HPP
+
+#include "graphics/Primitives.hpp"
+#include "util/ThreadPool.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace ph {
+
+struct AABB {
+	glm::vec3 min{std::numeric_limits<float>::max()};
+	glm::vec3 max{-std::numeric_limits<float>::max()};
+
+	void grow(const glm::vec3& p) {
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+
+	void grow(const AABB& b) {
+		min = glm::min(min, b.min);
+		max = glm::max(max, b.max);
+	}
+
+	[[nodiscard]] bool valid() const { return min.x <= max.x; }
+
+	[[nodiscard]] glm::vec3 center() const { return (min + max) * 0.5f; }
+
+	[[nodiscard]] float area() const {
+		if (!valid()) return 0.0f;
+		glm::vec3 e = max - min;
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+};
+
+// Layout matches BVHNode in shaders/common/Scene.glsl (std430, 32 bytes).
+// Inner nodes have count == 0 and their children at leftFirst and leftFirst + 1,
+// leaves reference m_primRefs[leftFirst .. leftFirst + count).
+struct BVHNode {
+	glm::vec3 min;
+	uint32_t leftFirst;
+	glm::vec3 max;
+	uint32_t count;
+
+	[[nodiscard]] bool isLeaf() const { return count > 0; }
+};
+
+// also the tags of the primitive stream, see PrimitiveStream
+enum class PrimitiveType : uint32_t {
+	Sphere = 0,
+	Box = 1,
+	Triangle = 2,
+	Plane = 3,
+	SpotLight = 4
+};
+
+// primitive references carry their type in the top bits so a single leaf can mix spheres and boxes
+constexpr uint32_t PRIM_TYPE_SHIFT = 28;
+constexpr uint32_t PRIM_INDEX_MASK = (1u << PRIM_TYPE_SHIFT) - 1;
+
+inline uint32_t makePrimRef(PrimitiveType type, uint32_t index) {
+	return (uint32_t(type) << PRIM_TYPE_SHIFT) | (index & PRIM_INDEX_MASK);
+}
+
+inline PrimitiveType primRefType(uint32_t ref) { return PrimitiveType(ref >> PRIM_TYPE_SHIFT); }
+
+inline uint32_t primRefIndex(uint32_t ref) { return ref & PRIM_INDEX_MASK; }
+
+struct Ray {
+	Ray(const glm::vec3& origin, const glm::vec3& direction) : origin(origin), direction(direction), invDir(1.0f / direction) {}
+
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 invDir;
+};
+
+struct RayHit {
+	float distance = std::numeric_limits<float>::max();
+	uint32_t primRef = ~0u;
+};
+
+// optional counters for the CPU traversals, used to compare node layouts
+struct TraversalStats {
+	uint64_t nodes = 0;
+	uint64_t boxTests = 0;
+	uint64_t primTests = 0;
+};
+
+class BVH {
+public:
+
+	static constexpr uint32_t BIN_COUNT = 16;
+	static constexpr uint32_t MAX_LEAF_SIZE = 4;
+	static constexpr uint32_t MAX_DEPTH = 64;
+
+	// nodes bigger than this are binned and partitioned by all threads together
+	static constexpr uint32_t PARALLEL_SPLIT_THRESHOLD = 1 << 15;
+	// subtrees bigger than this become their own pool task
+	static constexpr uint32_t SUBTREE_TASK_THRESHOLD = 1 << 10;
+
+	// traversal cost relative to a single primitive test, used by the SAH
+	static constexpr float TRAVERSAL_COST = 1.0f;
+	static constexpr float INTERSECTION_COST = 1.0f;
+
+	// builds on the calling thread when no pool is given
+	void build(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, const std::vector<SpotLight>& spotLights, ThreadPool* pool = nullptr);
+
+	void build(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, ThreadPool* pool = nullptr) { build(spheres, boxes, {}, pool); }
+
+	// builds over arbitrary bounds, m_primRefs then holds plain indices into them. Used for instance
+	// TLAS trees, refit only works on sphere/box/spot light trees.
+	void build(const std::vector<AABB>& bounds, ThreadPool* pool = nullptr);
+
+	// Adopts a prebuilt sphere/box/spot light tree, e.g. from a scene file. Only the refit bookkeeping is rebuilt.
+	// Throws std::runtime_error when the nodes reference primitives or children out of range, don't form a
+	// tree within MAX_DEPTH or don't cover every primitive exactly once.
+	void load(std::span<const BVHNode> nodes, std::span<const uint32_t> primRefs, uint32_t sphereCount, uint32_t boxCount, uint32_t spotLightCount);
+
+	// CPU reference traversal, mirrors IntersectBVH in shaders/RTNew.comp. Spot lights are skipped,
+	// the CPU traversals only trace spheres and boxes.
+	bool intersect(const Ray& ray, RayHit& hit, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, TraversalStats* stats = nullptr) const;
+
+	// any-hit visibility query, true as soon as some primitive is hit closer than tMax.
+	// Children aren't ordered, mirrors the any-hit path of IntersectBVH.
+	bool occluded(const Ray& ray, float tMax, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, TraversalStats* stats = nullptr) const;
+
+	// Grows/shrinks the bounds of the leaves holding the given primitive refs and of their ancestors.
+	// Work is proportional to dirtyRefs.size() times tree depth. Returns the touched node range [first, last),
+	// empty if no bounds changed.
+	std::pair<uint32_t, uint32_t> refit(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, const std::vector<SpotLight>& spotLights,
+										const std::vector<uint32_t>& dirtyRefs);
+
+	[[nodiscard]] float sahCost() const;
+
+	// current SAH cost relative to the cost right after the last build, grows as refits stretch nodes
+	[[nodiscard]] float sahDegradation() const { return m_buildSahCost > 0.0f ? m_sahCost / m_buildSahCost : 1.0f; }
+
+	[[nodiscard]] size_t nodeCount() const { return m_nodes.size(); }
+
+	std::vector<BVHNode> m_nodes;
+	std::vector<uint32_t> m_primRefs;
+
+private:
+
+	struct BuildRef {
+		AABB bounds;
+		glm::vec3 centroid;
+		uint32_t ref;
+	};
+
+	struct SplitBins {
+		AABB bounds[3][BIN_COUNT];
+		uint32_t counts[3][BIN_COUNT]{};
+
+		void merge(const SplitBins& other);
+	};
+
+	struct BuildContext {
+		ThreadPool* pool = nullptr;
+		TaskGroup group;
+		std::atomic<uint32_t> nodesUsed{0};
+	};
+
+	// runs func(chunk, begin, end) over [0, count) on the pool, inline without one
+	static void forChunks(BuildContext& ctx, uint32_t count, uint32_t chunkCount, const std::function<void(uint32_t, uint32_t, uint32_t)>& func);
+
+	// shared tail of both builds, expects m_buildRefs to be filled
+	void buildFromRefs(BuildContext& ctx);
+
+	void sortByMortonCode(BuildContext& ctx);
+
+	void subdivide(BuildContext& ctx, uint32_t nodeIndex, uint32_t depth);
+
+	uint32_t partition(BuildContext& ctx, uint32_t first, uint32_t count, int axis, float splitPos);
+
+	void updateBounds(BuildContext& ctx, uint32_t nodeIndex);
+
+	float findBestSplit(BuildContext& ctx, const BVHNode& node, int& axis, float& splitPos);
+
+	void buildRefitData(BuildContext& ctx);
+
+	[[nodiscard]] float nodeCostWeight(const BVHNode& node) const;
+
+	// spheres, then boxes, then spot lights
+	[[nodiscard]] uint32_t refSlot(uint32_t ref) const {
+		switch (primRefType(ref)) {
+			case PrimitiveType::Box: return m_sphereCount + primRefIndex(ref);
+			case PrimitiveType::SpotLight: return m_sphereCount + m_boxCount + primRefIndex(ref);
+			default: return primRefIndex(ref);
+		}
+	}
+
+	std::vector<BuildRef> m_buildRefs;
+	std::vector<BuildRef> m_scratchRefs;
+
+	// refit bookkeeping, m_leafOf is indexed by refSlot
+	std::vector<uint32_t> m_parents;
+	std::vector<uint32_t> m_leafOf;
+	uint32_t m_sphereCount = 0;
+	uint32_t m_boxCount = 0;
+	float m_rootArea = 0.0f;
+	float m_sahCost = 0.0f;
+	float m_buildSahCost = 0.0f;
+};
+
+AABB primitiveBounds(uint32_t ref, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, const std::vector<SpotLight>& spotLights);
+
+// ray-primitive tests shared by the CPU traversal and the benchmarks
+float intersectSphere(const Ray& ray, const Sphere& sphere);
+
+float intersectBox(const Ray& ray, const Box& box);
+
+// distance to the sphere or box the ref points at, other types are never hit
+float intersectPrimRef(const Ray& ray, uint32_t ref, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes);
+
+float intersectAABB(const Ray& ray, const glm::vec3& min, const glm::vec3& max, float tMax);
+
+} // ph
+
+#endif //PTDEMO_BVH_HPP
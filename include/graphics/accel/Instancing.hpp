@@ -0,0 +1,96 @@
+//
+// Created by Fatih on 8/26/2022.
+//
+
+#ifndef PTDEMO_INSTANCING_HPP
+#define PTDEMO_INSTANCING_HPP
+
+#include "graphics/Renderer.hpp"
+#include "graphics/accel/BVH.hpp"
+#include "graphics/accel/WideBVH.hpp"
+#include "graphics/mesh/TriangleMesh.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace ph {
+
+// Layout matches Instance in shaders/common/Scene.glsl (std430, 64 bytes).
+struct Instance {
+	// rows of the affine world to object transform
+	glm::vec4 worldToObject[3];
+	uint32_t blasRoot;
+	uint32_t pad0, pad1, pad2;
+};
+
+// Two-level scene: groups of spheres and boxes or triangle meshes get their own bottom-level BVH once,
+// instances place a group in the world with an affine transform and only cost 64 bytes each.
+// A top-level BVH over the instance bounds is rebuilt whenever instances change.
+class InstancedScene {
+public:
+
+	static constexpr uint32_t BLAS_SPHERE_BINDING = 13;
+	static constexpr uint32_t BLAS_BOX_BINDING = 14;
+	static constexpr uint32_t BLAS_NODE_BINDING = 15;
+	static constexpr uint32_t BLAS_PRIM_REF_BINDING = 16;
+	static constexpr uint32_t INSTANCE_BINDING = 17;
+	static constexpr uint32_t TLAS_NODE_BINDING = 18;
+	static constexpr uint32_t TLAS_REF_BINDING = 19;
+	static constexpr uint32_t MESH_VERTEX_BINDING = 20;
+	static constexpr uint32_t TRIANGLE_BINDING = 21;
+
+	// builds the group's BLAS and appends it to the shared arrays, returns the group id
+	uint32_t addGroup(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, ThreadPool* pool = nullptr);
+
+	// builds a BVH over the mesh triangles, the mesh is one group and can be instanced like any other.
+	// material indexes the scene's MaterialTable, like the materials of group spheres and boxes.
+	uint32_t addMesh(const TriangleMesh& mesh, uint32_t material, ThreadPool* pool = nullptr);
+
+	// returns the instance id
+	uint32_t addInstance(uint32_t group, const glm::mat4& objectToWorld);
+
+	void setTransform(uint32_t instance, const glm::mat4& objectToWorld);
+
+	// adds the buffers, must be called before Renderer::postInitialize
+	void init(Renderer* renderer, ThreadPool* pool = nullptr);
+
+	// rebuilds the TLAS and uploads whatever changed since the last call
+	void update(ThreadPool* pool = nullptr);
+
+	[[nodiscard]] size_t instanceCount() const { return m_instances.size(); }
+
+private:
+
+	struct Group {
+		uint32_t root;
+		AABB bounds;
+	};
+
+	uint32_t appendBLAS(const BVH& blas, const std::function<uint32_t(uint32_t)>& rebaseRef);
+
+	void buildTLAS(ThreadPool* pool);
+
+	void upload(bool addBuffers);
+
+	Renderer* m_renderer = nullptr;
+
+	std::vector<Group> m_groups;
+	std::vector<Sphere> m_spheres;
+	std::vector<Box> m_boxes;
+	std::vector<WideBVHNode> m_blasNodes;
+	std::vector<uint32_t> m_blasPrimRefs;
+	std::vector<glm::vec4> m_meshVertices;
+	std::vector<Triangle> m_triangles;
+
+	std::vector<Instance> m_instances;
+	std::vector<AABB> m_instanceBounds;
+	std::vector<uint32_t> m_instanceGroups;
+	BVH m_tlas;
+
+	bool m_groupsDirty = false;
+	bool m_instancesDirty = false;
+};
+
+} // ph
+
+#endif //PTDEMO_INSTANCING_HPP
@@ -0,0 +1,56 @@
+//
+// Created by Fatih on 8/24/2022.
+//
+
+#ifndef PTDEMO_LBVH_HPP
+#define PTDEMO_LBVH_HPP
+
+#include "graphics/Renderer.hpp"
+
+#include <cstdint>
+
+namespace ph {
+
+// Rebuilds the scene BVH on the GPU every frame from the sphere and box buffers (Karras 2012 LBVH).
+// The compute passes run before the trace dispatch and write bindings 6 and 7 in the layout BVH uploads,
+// so the path tracer doesn't care which builder produced the tree.
+class LBVH {
+public:
+
+	static constexpr uint32_t GROUP_SIZE = 256;
+	static constexpr uint32_t RADIX_SIZE = 256;
+	static constexpr uint32_t RADIX_PASSES = 4;
+
+	static constexpr uint32_t NODE_BINDING = 6;
+	static constexpr uint32_t PRIM_REF_BINDING = 7;
+	static constexpr uint32_t KEY_BINDING = 8;
+	static constexpr uint32_t VALUE_BINDING = 9;
+	static constexpr uint32_t HISTOGRAM_BINDING = 10;
+	static constexpr uint32_t BUILD_NODE_BINDING = 11;
+	static constexpr uint32_t GLOBALS_BINDING = 12;
+
+	// adds the scratch buffers and passes, must be called before Renderer::postInitialize
+	void init(Renderer* renderer, uint32_t primitiveCount);
+
+	// sizes the scratch buffers for a new primitive count. When enabled, bindings 6 and 7
+	// become device local buffers the passes write into.
+	void resize(uint32_t primitiveCount);
+
+	void setEnabled(bool enabled);
+
+	[[nodiscard]] bool enabled() const { return m_enabled; }
+
+private:
+
+	[[nodiscard]] std::array<uint32_t, 3> primitiveGroups() const { return {(m_primitiveCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1}; }
+
+	[[nodiscard]] uint32_t blockCount() const { return (m_primitiveCount + GROUP_SIZE - 1) / GROUP_SIZE; }
+
+	Renderer* m_renderer = nullptr;
+	uint32_t m_primitiveCount = 0;
+	bool m_enabled = false;
+};
+
+} // ph
+
+#endif //PTDEMO_LBVH_HPP
@@ -0,0 +1,104 @@
+//
+// Created by Fatih on 9/20/2022.
+//
+
+#ifndef PTDEMO_LIGHTBVH_HPP
+#define PTDEMO_LIGHTBVH_HPP
+
+#include "graphics/accel/BVH.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace ph {
+
+// Cone of the directions a group of emitters faces, see Conty Estevez and Kulla 2018.
+// Sphere lights face every direction, cosTheta is -1 for them and for every node above them.
+struct LightCone {
+	glm::vec3 axis{0.0f, 0.0f, 1.0f};
+	float cosTheta = 1.0f;
+	bool empty = true;
+
+	void grow(const LightCone& cone);
+};
+
+// Layout matches LightBVHNode in shaders/common/LightBVH.glsl (std430, 48 bytes).
+// Inner nodes have their first child right after them and the second at ref, leaves have
+// LEAF_BIT | light index in ref. The emitters are surfaces, they cover a half angle of pi / 2
+// around every normal of the cone, so that part of the bounds isn't stored.
+struct LightBVHNode {
+	glm::vec3 min;
+	uint32_t ref;
+	glm::vec3 max;
+	float power;
+	glm::vec3 axis;
+	float cosTheta;
+};
+
+// Light hierarchy over the sphere lights (Conty Estevez and Kulla 2018, as in pbrt-v4). Every node bounds
+// the position, power and facing of its lights, the shader walks it down to a single light and picks each
+// child in proportion to its estimated contribution at the shading point, see SampleLightBVH.
+// The MIS weight of a light hit needs the probability of that light again, m_trails holds the
+// child taken at every depth on the way to it.
+class LightBVH {
+public:
+
+	static constexpr uint32_t NODE_BINDING = 47;
+	static constexpr uint32_t TRAIL_BINDING = 48;
+
+	static constexpr uint32_t LEAF_BIT = 0x80000000u;
+	static constexpr uint32_t BIN_COUNT = 12;
+	// trails are a single uint, deeper subtrees fall back to median splits
+	static constexpr uint32_t MAX_DEPTH = 32;
+
+	// without lights the tree is a single leaf of no power, the shader never picks it
+	void build(const std::vector<SpotLight>& lights);
+
+	// Updates the bounds, power and cones for lights that moved or changed, keeping the topology and trails.
+	// The light count has to be the one of the last build.
+	void refit(const std::vector<SpotLight>& lights);
+
+	// CPU reference of SampleLightBVH in shaders/common/LightBVH.glsl, a zero normal ignores the facing
+	// of the receiver. Returns false when no light contributes at p.
+	bool sample(const glm::vec3& p, const glm::vec3& n, float u, uint32_t& light, float& pmf) const;
+
+	// probability of sample picking the light, mirrors LightBVHPmf
+	[[nodiscard]] float pmf(const glm::vec3& p, const glm::vec3& n, uint32_t light) const;
+
+	std::vector<LightBVHNode> m_nodes;
+	// bit i is set when the way to light j takes the second child at depth i
+	std::vector<uint32_t> m_trails;
+
+private:
+
+	struct BuildLight {
+		AABB bounds;
+		LightCone cone;
+		float power;
+		uint32_t index;
+	};
+
+	struct NodeBounds {
+		AABB bounds;
+		LightCone cone;
+		float power = 0.0f;
+
+		void grow(const BuildLight& light);
+	};
+
+	static BuildLight buildLight(const SpotLight& light, uint32_t index);
+
+	// returns the node index of the subtree over m_buildLights[first, last)
+	uint32_t subdivide(uint32_t first, uint32_t last, uint32_t depth, uint32_t trail);
+
+	// partitions the range and returns the first light of the second half
+	uint32_t split(uint32_t first, uint32_t last, uint32_t depth);
+
+	[[nodiscard]] static float importance(const LightBVHNode& node, const glm::vec3& p, const glm::vec3& n);
+
+	std::vector<BuildLight> m_buildLights;
+};
+
+} // ph
+
+#endif //PTDEMO_LIGHTBVH_HPP
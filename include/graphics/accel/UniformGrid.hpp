@@ -0,0 +1,61 @@
+//
+// Created by Fatih on 9/1/2022.
+//
+
+#ifndef PTDEMO_UNIFORMGRID_HPP
+#define PTDEMO_UNIFORMGRID_HPP
+
+#include "graphics/accel/BVH.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace ph {
+
+// Layout matches GridInfoBuf in shaders/common/Scene.glsl (std430, 64 bytes).
+struct GridInfo {
+	glm::vec3 min;
+	// the shader traces the grid instead of the BVH while this is set
+	uint32_t enabled;
+	glm::vec3 max;
+	uint32_t pad0;
+	glm::uvec3 resolution;
+	uint32_t pad1;
+	glm::vec3 cellSize;
+	uint32_t pad2;
+};
+
+// Uniform grid over the scene spheres, boxes and spot lights, traversed with a 3D-DDA. For scenes of similarly sized
+// primitives spread over a bounded region it is cheaper to build than a BVH and competitive to trace.
+// Cell (x, y, z) holds m_primRefs[m_cellOffsets[i] .. m_cellOffsets[i + 1]) with i = (z * res.y + y) * res.x + x.
+class UniformGrid {
+public:
+
+	// target primitives per cell is about 1 / DENSITY, see Ize et al. 2006
+	static constexpr float DENSITY = 4.0f;
+	static constexpr uint32_t MAX_RESOLUTION = 128;
+
+	void build(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, const std::vector<SpotLight>& spotLights);
+
+	// CPU reference traversal, mirrors IntersectGrid in shaders/RTNew.comp. Spot lights are skipped like in BVH::intersect.
+	bool intersect(const Ray& ray, RayHit& hit, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, TraversalStats* stats = nullptr) const;
+
+	[[nodiscard]] GridInfo info(bool enabled) const { return {m_bounds.min, enabled ? 1u : 0u, m_bounds.max, 0, m_resolution, 0, m_cellSize, 0}; }
+
+	[[nodiscard]] size_t cellCount() const { return size_t(m_resolution.x) * m_resolution.y * m_resolution.z; }
+
+	std::vector<uint32_t> m_cellOffsets;
+	std::vector<uint32_t> m_primRefs;
+
+private:
+
+	[[nodiscard]] glm::uvec3 cellOf(const glm::vec3& p) const;
+
+	AABB m_bounds;
+	glm::uvec3 m_resolution{1};
+	glm::vec3 m_cellSize{1};
+};
+
+} // ph
+
+#endif //PTDEMO_UNIFORMGRID_HPP
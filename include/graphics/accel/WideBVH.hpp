@@ -0,0 +1,66 @@
+//
+// Created by Fatih on 8/30/2022.
+//
+
+#ifndef PTDEMO_WIDEBVH_HPP
+#define PTDEMO_WIDEBVH_HPP
+
+#include "graphics/accel/BVH.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace ph {
+
+// Layout matches WideBVHNode in shaders/common/Scene.glsl (std430, 64 bytes).
+// Child bounds are stored as 8-bit offsets from origin in steps of a per-axis power of two,
+// rounded outwards so the decoded boxes always contain the exact ones.
+struct WideBVHNode {
+	glm::vec3 origin;
+	// bytes 0-2: biased float exponent of the x, y, z step, byte 3: child count
+	uint32_t meta;
+	// byte i of component a is child i's quantized min/max on axis a, w is unused
+	glm::uvec4 lo;
+	glm::uvec4 hi;
+	// inner children: node index, leaves: LEAF_BIT | (count << LEAF_COUNT_SHIFT) | first prim ref
+	glm::uvec4 children;
+};
+
+// 4-wide BVH collapsed from a binary one. Nodes hold their children's bounds, so a traversal step
+// tests four boxes from a single 64 byte fetch instead of two from two 32 byte nodes.
+class WideBVH {
+public:
+
+	static constexpr uint32_t WIDTH = 4;
+	static constexpr uint32_t LEAF_BIT = 1u << 31;
+	static constexpr uint32_t LEAF_COUNT_SHIFT = 28;
+	static constexpr uint32_t LEAF_FIRST_MASK = (1u << LEAF_COUNT_SHIFT) - 1;
+	// the count has the three bits between LEAF_BIT and the first prim ref
+	static constexpr uint32_t MAX_LEAF_COUNT = (LEAF_BIT >> LEAF_COUNT_SHIFT) - 1;
+
+	// leaves keep their prim refs, m_primRefs is a copy of the binary tree's. Binary leaves with more than
+	// MAX_LEAF_COUNT prims, which BVH::subdivide makes at MAX_DEPTH, are split over a chain of wide nodes.
+	void build(const BVH& bvh);
+
+	// CPU reference traversal, mirrors IntersectBLAS in shaders/RTNew.comp
+	bool intersect(const Ray& ray, RayHit& hit, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, TraversalStats* stats = nullptr) const;
+
+	[[nodiscard]] static uint32_t childCount(const WideBVHNode& node) { return node.meta >> 24; }
+
+	[[nodiscard]] static AABB childBounds(const WideBVHNode& node, uint32_t child);
+
+	[[nodiscard]] size_t nodeCount() const { return m_nodes.size(); }
+
+	std::vector<WideBVHNode> m_nodes;
+	std::vector<uint32_t> m_primRefs;
+
+private:
+
+	void collapse(const BVH& bvh, uint32_t binaryIndex, uint32_t wideIndex);
+
+	void splitLeaf(const BVHNode& leaf, uint32_t wideIndex);
+};
+
+} // ph
+
+#endif //PTDEMO_WIDEBVH_HPP
@@ -0,0 +1,22 @@
+//
+// Created by Fatih on 8/28/2022.
+//
+
+#ifndef PTDEMO_OBJLOADER_HPP
+#define PTDEMO_OBJLOADER_HPP
+
+#include "graphics/mesh/TriangleMesh.hpp"
+#include "util/ThreadPool.hpp"
+
+#include <string>
+
+namespace ph {
+
+// Streams the file in large blocks and parses each block on the pool. Only positions and faces are read,
+// polygons are fan triangulated. Throws std::runtime_error when the file can't be read or a face
+// references a vertex that doesn't exist.
+TriangleMesh loadObj(const std::string& path, ThreadPool* pool = nullptr);
+
+} // ph
+
+#endif //PTDEMO_OBJLOADER_HPP
@@ -0,0 +1,25 @@
+//
+// Created by Fatih on 8/28/2022.
+//
+
+#ifndef PTDEMO_TRIANGLEMESH_HPP
+#define PTDEMO_TRIANGLEMESH_HPP
+
+#include "graphics/Primitives.hpp"
+
+#include <vector>
+
+namespace ph {
+
+struct TriangleMesh {
+	// w is unused, vec4 matches the std430 stride of the vertex buffer
+	std::vector<glm::vec4> vertices;
+	// three per triangle
+	std::vector<uint32_t> indices;
+
+	[[nodiscard]] size_t triangleCount() const { return indices.size() / 3; }
+};
+
+} // ph
+
+#endif //PTDEMO_TRIANGLEMESH_HPP
@@ -0,0 +1,120 @@
+//
+// Created by Fatih on 9/11/2022.
+//
+
+#ifndef PTDEMO_RAYQUERYACCEL_HPP
+#define PTDEMO_RAYQUERYACCEL_HPP
+
+#include "vk_mem_alloc.h"
+#include "graphics/PrimitiveStream.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace ph {
+
+// Hardware acceleration structures over the sphere, box and spot light ranges of the primitive stream, traced
+// with rayQueryEXT by IntersectRayQuery in shaders/RTNew.comp. The BLAS holds one AABB geometry per type, the
+// shader maps a candidate's geometry index back to the type tag and its primitive index is the ref's index.
+// The exact tests stay in the shader. The TLAS is a single identity instance of the BLAS.
+// Extension functions aren't exported by the loader and are fetched from the device.
+class RayQueryAccel {
+public:
+
+	static constexpr uint32_t TLAS_BINDING = 26;
+
+	// spheres, boxes and spot lights, RAY_QUERY_TYPES in the shader lists them in the same order
+	static constexpr uint32_t GEOMETRY_COUNT = 3;
+
+	// refits in a row before the BLAS is built from scratch again, refits only stretch the boxes
+	static constexpr uint32_t MAX_REFITS = 64;
+
+	// device extensions the backend needs, the renderer keeps the compute traversal without them
+	static const std::vector<const char*> EXTENSIONS;
+
+	// the allocator must have been created with VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT.
+	// Creates the TLAS, its handle stays the same for the lifetime of the backend.
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator allocator);
+
+	// changed counts rebuild the BLAS, moved primitives only refit it
+	void markDirty(bool rebuild);
+
+	// Rewrites the AABBs from the stream and grows the BLAS and scratch buffers when needed.
+	// Call once the previous frame is done with them.
+	void prepare(const PrimitiveStream& stream);
+
+	// records the pending builds, followed by a barrier for the trace dispatch
+	void record(VkCommandBuffer buffer);
+
+	void cleanup();
+
+	[[nodiscard]] VkAccelerationStructureKHR tlas() const { return m_tlas.handle; }
+
+private:
+
+	enum class Build {
+		None,
+		Refit,
+		Full
+	};
+
+	struct AccelBuffer {
+		VkBuffer handle = VK_NULL_HANDLE;
+		VmaAllocation alloc = nullptr;
+		VkDeviceSize size = 0;
+		VkDeviceAddress address = 0;
+	};
+
+	struct Structure {
+		VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
+		AccelBuffer storage;
+	};
+
+	void createBuffer(AccelBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, bool hostVisible, VkDeviceSize alignment = 0);
+
+	void destroyBuffer(AccelBuffer& buffer);
+
+	// reallocates the structure when it needs more than its buffer holds, true when the handle changed
+	bool reserve(Structure& structure, VkAccelerationStructureTypeKHR type, VkDeviceSize size);
+
+	// fills the geometries and ranges of the BLAS from the current counts
+	void blasGeometries(VkAccelerationStructureGeometryKHR* geometries, VkAccelerationStructureBuildRangeInfoKHR* ranges) const;
+
+	[[nodiscard]] VkAccelerationStructureGeometryKHR instanceGeometry() const;
+
+	void buildInfo(VkAccelerationStructureBuildGeometryInfoKHR& info, const Structure& structure, const VkAccelerationStructureGeometryKHR* geometries,
+				   uint32_t geometryCount, VkAccelerationStructureTypeKHR type, Build build) const;
+
+	void copyMemory(const AccelBuffer& buffer, const void* data, size_t size) const;
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VmaAllocator m_allocator = nullptr;
+	VkDeviceSize m_scratchAlignment = 0;
+	VkDeviceSize m_tlasScratchSize = 0;
+
+	PFN_vkCreateAccelerationStructureKHR m_createAccelerationStructure = nullptr;
+	PFN_vkDestroyAccelerationStructureKHR m_destroyAccelerationStructure = nullptr;
+	PFN_vkGetAccelerationStructureBuildSizesKHR m_getBuildSizes = nullptr;
+	PFN_vkCmdBuildAccelerationStructuresKHR m_cmdBuildAccelerationStructures = nullptr;
+	PFN_vkGetAccelerationStructureDeviceAddressKHR m_getAccelerationStructureAddress = nullptr;
+
+	Structure m_blas;
+	Structure m_tlas;
+	AccelBuffer m_aabbs;
+	AccelBuffer m_instance;
+	AccelBuffer m_scratch;
+	std::vector<VkAabbPositionsKHR> m_hostAabbs;
+
+	// AABBs per geometry, the refit needs the counts the BLAS was built with
+	uint32_t m_counts[GEOMETRY_COUNT]{};
+	uint32_t m_refits = 0;
+	bool m_dirty = true;
+	bool m_rebuild = true;
+	Build m_pending = Build::None;
+};
+
+} // ph
+
+#endif //PTDEMO_RAYQUERYACCEL_HPP
@@ -6,6 +6,8 @@
 #define PTDEMO_VULKANRENDERER_HPP
 
 #include "graphics/Renderer.hpp"
+#include "graphics/PrimitiveStream.hpp"
+#include "graphics/vulkan/RayQueryAccel.hpp"
 #include "graphics/vulkan/VkBootstrap.h"
 #include "graphics/vulkan/VulkanTypes.hpp"
 
@@ -22,6 +24,9 @@ namespace ph {
 
 class VulkanRenderer : public virtual Renderer {
 public:
+	// fp32 running mean of the traced frames, the swapchain image gets its tonemapped copy
+	static constexpr uint32_t ACCUMULATION_BINDING = 27;
+
 	VulkanRenderer(SDL_Window* window, vk::Extent2D extent, const std::string& appName);
 
 	void postInitialize() override;
@@ -36,8 +41,28 @@ public:
 
 	void addUniform(uint32_t index, size_t size, void *data) override;
 
+	void addCounters(uint32_t index, size_t size, void *data) override;
+
+	void updateBuffer(uint32_t index, size_t size, void *data) override;
+
+	void markDirty(uint32_t index, size_t offset, size_t size) override;
+
 	void setPushConstants(uint32_t offset, size_t size, void *data) override;
 
+	void addComputePass(const ComputePassInfo& info) override;
+
+	void addPrimitiveType(uint32_t tag, uint32_t stride, bool unbounded) override;
+
+	void setPrimitives(uint32_t tag, size_t count, const void* payload, const uint32_t* materials) override;
+
+	void updatePrimitives(uint32_t tag, uint32_t first, uint32_t last, const void* payload) override;
+
+	void resetAccumulation() override;
+
+	void setRenderScale(float scale) override;
+
+	[[nodiscard]] VkExtent2D renderExtent() const override;
+
 	vkt::PushConstants m_pushConstants;
 	std::vector<vkt::StorageData> m_storageDataSet;
 
@@ -45,10 +70,27 @@ private:
 
 	std::vector<uint32_t> compileShader(const std::string& filename);
 
+	vkt::StorageData& findStorage(uint32_t index);
+
 	void prepareStorageBuffers();
 
+	// returns true when any buffer changed, the accumulated image is stale then
+	bool uploadStorageBuffers();
+
+	// copies the counters of the finished frame to the host and clears them for the next one
+	void readCounters();
+
+	// m_gpuTime from the timestamps of the finished frame
+	void readTimestamps();
+
+	// the traced part of the swapchain extent for the current render scale
+	void updateRenderExtent();
+
 	void createSynchronizationStructs();
 
+	// points the stream buffers at the current host arrays
+	void uploadPrimitives();
+
 	void createSwapchain();
 
 	void recreateSwapchain();
@@ -57,10 +99,23 @@ private:
 
 	void createComputeImage();
 
+	void createStorageImage(vkt::Image& image, vk::Format format, vk::ImageUsageFlags usage);
+
+	void destroyStorageImage(vkt::Image& image);
+
+	// the user block followed by the frame constants
+	void pushConstants(const vk::CommandBuffer& buffer);
+
     void createRenderPipeline(const std::string& shader);
 
 	void createComputePipeline(const std::string& shaderFileName);
 
+	void createComputePasses();
+
+	void recordComputePasses(const vk::CommandBuffer& buffer, PassStage stage);
+
+	void recordComputePass(const vk::CommandBuffer& buffer, vkt::ComputePass& pass);
+
 	void recordComputeCommands();
 
 	void applyFirstImageBarriers(const vk::CommandBuffer& buffer);
@@ -69,7 +124,7 @@ private:
 
 	void applySecondImageBarriers(const vk::CommandBuffer& buffer);
 
-	void createStorageBuffer(const void* data, size_t size, vkt::Buffer& buffer, vk::BufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryProperties) const;
+	void createStorageBuffer(const void* data, size_t size, vkt::Buffer& buffer, vk::BufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryProperties, bool hostRead = false) const;
 
 	uint32_t m_frameCounter = 0;
 	uint64_t m_lastTicks = 0;
@@ -89,7 +144,21 @@ private:
 	vkt::Queue m_presentQueue;
 	vkt::Queue m_computeQueue;
 	vkt::Image m_computeImage;
+	vkt::Image m_accumulationImage;
+	FrameConstants m_frameConstants;
+	float m_renderScale = 1.0f;
+	vk::Extent2D m_renderExtent;
+	// size of what the compute image holds, it is presented by the next frame
+	vk::Extent2D m_presentedExtent;
+	vk::UniqueQueryPool m_timestampPool;
+	float m_timestampPeriod = 0.0f;
+	bool m_timestampsWritten = false;
 	vkt::Pipeline m_computePipeline;
+	std::vector<vkt::ComputePass> m_computePasses;
+	PrimitiveStream m_primitives;
+	// hardware traversal of the spheres and boxes, only when the device has the ray query extensions
+	RayQueryAccel m_rayQueryAccel;
+	bool m_rayQuery = false;
 	std::vector<std::function<void(const vk::CommandBuffer&)>> m_computeCommands;
 
 	vkt::Image m_skyBoxImage;
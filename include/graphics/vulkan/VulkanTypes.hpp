@@ -6,8 +6,10 @@
 #define PTDEMO_VULKANTYPES_HPP
 
 #include "vk_mem_alloc.h"
+#include "graphics/Renderer.hpp"
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
+#include <deque>
 #include <vector>
 #include <ranges>
 #include <unordered_map>
@@ -74,6 +76,12 @@ public:
 		return *this;
 	}
 
+	DescriptorSetBuilder& bindAccelerationStructure(vk::DescriptorSetLayoutBinding binding, vk::AccelerationStructureKHR accelerationStructure) {
+		bind(binding);
+		accelerationStructures[binding.binding] = accelerationStructure;
+		return *this;
+	}
+
 	const vk::DescriptorSetLayout& build(const vk::Device& device, vk::DescriptorSetLayoutCreateFlags flags) {
 		layout = device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo(flags, bindings));
 		return layout;
@@ -83,6 +91,7 @@ public:
 	vk::DescriptorSetLayout layout;
 	std::unordered_map<uint32_t, std::vector<vk::DescriptorBufferInfo>> bufferInfos;
 	std::unordered_map<uint32_t, std::vector<vk::DescriptorImageInfo>> imageInfos;
+	std::unordered_map<uint32_t, vk::AccelerationStructureKHR> accelerationStructures;
 };
 
 struct DescriptorPoolBuilder {
@@ -115,6 +124,8 @@ public:
 		std::vector<vk::DescriptorPoolSize> sizes;
 		std::vector<vk::DescriptorSetLayout> layouts;
 		std::vector<vk::WriteDescriptorSet> writeSets;
+		// chained to their writes, must not move until the update
+		std::deque<vk::WriteDescriptorSetAccelerationStructureKHR> accelerationWrites;
 
 		sizes.resize(poolSizes.size());
 		layouts.resize(sets.size());
@@ -137,6 +148,9 @@ public:
 					writeSets.push_back(vk::WriteDescriptorSet(pipeline.descriptorSets[i], binding.binding, 0, binding.descriptorType, {}, set.bufferInfos[binding.binding]));
 				} else if (set.imageInfos.contains(binding.binding)) {
 					writeSets.emplace_back(pipeline.descriptorSets[i], binding.binding, 0, binding.descriptorType, set.imageInfos[binding.binding]);
+				} else if (set.accelerationStructures.contains(binding.binding)) {
+					auto& accelerationWrite = accelerationWrites.emplace_back(1, &set.accelerationStructures[binding.binding]);
+					writeSets.push_back(vk::WriteDescriptorSet(pipeline.descriptorSets[i], binding.binding, 0, 1, binding.descriptorType).setPNext(&accelerationWrite));
 				} else {
 					writeSets.push_back(vk::WriteDescriptorSet(pipeline.descriptorSets[i], binding.binding, 0, binding.descriptorType, {}, set.bufferInfos[binding.binding]));
 				}
@@ -289,21 +303,35 @@ struct Buffer {
 	vk::Buffer handle;
 	vk::DescriptorBufferInfo info;
 	VmaAllocation alloc;
+	VkMemoryPropertyFlags memoryFlags{};
 
-	void copyMemory(const VmaAllocator& allocator, const void* data, size_t size) const {
+	void copyMemory(const VmaAllocator& allocator, const void* data, size_t size, size_t offset = 0) const {
 		void* mapped = nullptr;
 
 		auto result = vmaMapMemory(allocator, alloc, &mapped);
 		if (result != VK_SUCCESS)
 			throw std::runtime_error("Failed to map memory for buffer !");
 
-		std::memcpy(mapped, data, size);
+		std::memcpy(static_cast<char*>(mapped) + offset, static_cast<const char*>(data) + offset, size);
 
 		if (mapped) {
 			vmaUnmapMemory(allocator, alloc);
 			mapped = nullptr;
 		}
 	}
+
+	// copies the contents to data and zeroes them, for counters the shaders add to
+	void readAndClear(const VmaAllocator& allocator, void* data, size_t size) const {
+		void* mapped = nullptr;
+
+		auto result = vmaMapMemory(allocator, alloc, &mapped);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to map memory for buffer !");
+
+		std::memcpy(data, mapped, size);
+		std::memset(mapped, 0, size);
+		vmaUnmapMemory(allocator, alloc);
+	}
 };
 
 struct ShaderBinding {
@@ -326,6 +354,11 @@ struct PushConstants {
 	}
 };
 
+struct ComputePass {
+	ComputePassInfo info;
+	vk::UniquePipeline handle;
+};
+
 struct StorageData {
 	Buffer buffer;
 	ShaderBinding binding;
@@ -333,9 +366,28 @@ struct StorageData {
 
 	size_t size{};
 	void* data{};
+	// read back and cleared every frame, see Renderer::addCounters
+	bool counters{};
+
+	// byte range modified on the host since the last upload
+	size_t dirtyBegin{};
+	size_t dirtyEnd{};
+
+	void markDirty(size_t offset, size_t length) {
+		offset = std::min(offset, size);
+		size_t end = length > size - offset ? size : offset + length;
+		if (dirtyBegin >= dirtyEnd) {
+			dirtyBegin = offset;
+			dirtyEnd = end;
+		} else {
+			dirtyBegin = std::min(dirtyBegin, offset);
+			dirtyEnd = std::max(dirtyEnd, end);
+		}
+	}
 
-	void update(const VmaAllocator& allocator) const {
-		if (data != nullptr) buffer.copyMemory(allocator, data, size);
+	void update(const VmaAllocator& allocator) {
+		if (data != nullptr && dirtyBegin < dirtyEnd) buffer.copyMemory(allocator, data, dirtyEnd - dirtyBegin, dirtyBegin);
+		dirtyBegin = dirtyEnd = 0;
 	}
 };
 
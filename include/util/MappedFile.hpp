@@ -0,0 +1,43 @@
+//
+// Created by Fatih on 9/3/2022.
+//
+
+#ifndef PTDEMO_MAPPEDFILE_HPP
+#define PTDEMO_MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ph {
+
+// Read-only memory mapping of a whole file, pages are faulted in by the OS as they are touched.
+class MappedFile {
+public:
+
+	// throws std::runtime_error when the file can't be opened or mapped
+	explicit MappedFile(const std::string& path);
+
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	[[nodiscard]] const uint8_t* data() const { return m_data; }
+
+	[[nodiscard]] size_t size() const { return m_size; }
+
+private:
+
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
+
+} // ph
+
+#endif //PTDEMO_MAPPEDFILE_HPP
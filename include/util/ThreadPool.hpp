@@ -0,0 +1,74 @@
+//
+// Created by Fatih on 8/22/2022.
+//
+
+#ifndef PTDEMO_THREADPOOL_HPP
+#define PTDEMO_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ph {
+
+// Counts outstanding tasks of a fork-join region. Tasks may spawn more tasks into the same group.
+class TaskGroup {
+public:
+	[[nodiscard]] bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class ThreadPool;
+	std::atomic<uint32_t> m_pending{0};
+};
+
+// Work-stealing pool: every worker owns a deque, pops its own work LIFO and steals FIFO from the others.
+// Threads that wait on a group execute queued tasks meanwhile, so nested fork-join never deadlocks.
+class ThreadPool {
+public:
+	using Task = std::function<void()>;
+
+	// threadCount includes the thread calling wait(), so ThreadPool(1) runs everything inline
+	explicit ThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void run(TaskGroup& group, Task task);
+
+	void wait(TaskGroup& group);
+
+	// splits [begin, end) into chunks of at least grainSize and blocks until all of them ran
+	void parallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& func);
+
+	[[nodiscard]] uint32_t threadCount() const { return uint32_t(m_workers.size()) + 1; }
+
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<std::pair<Task, TaskGroup*>> tasks;
+	};
+
+	void workerLoop(uint32_t index);
+
+	bool tryRunOne(uint32_t preferred);
+
+	std::vector<std::thread> m_workers;
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+	std::atomic<uint32_t> m_queued{0};
+	std::atomic<uint32_t> m_nextQueue{0};
+	std::atomic<bool> m_stop{false};
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeUp;
+};
+
+} // ph
+
+#endif //PTDEMO_THREADPOOL_HPP
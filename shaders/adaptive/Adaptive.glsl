@@ -0,0 +1,158 @@
+// Adaptive sampling, run by AdaptiveSampler. WritePixel keeps the luminance mean and variance of every
+// pixel, updated once per frame from the frame's mean with the frame's sample count as its weight.
+// After the trace the error pass sums the relative standard error of all pixels above the threshold and
+// the budget pass hands out the next frame's samples in proportion to it. Pixels below the threshold
+// get none, until something resets the accumulation.
+// Included by RTNew.comp before WritePixel.
+
+#define KERNEL_ADAPTIVE_ERROR 8
+#define KERNEL_ADAPTIVE_BUDGET 9
+
+// the variance needs two frames, pixels with fewer use camera.samples
+#define ADAPTIVE_MIN_FRAMES 2
+// mirror ADAPTIVE_MAX_SAMPLE_SCALE, ADAPTIVE_ERROR_SCALE and DebugView
+#define ADAPTIVE_MAX_SAMPLE_SCALE 4
+#define ADAPTIVE_ERROR_SCALE 256.0
+#define DEBUG_VIEW_NONE 0
+#define DEBUG_VIEW_SAMPLE_MAP 1
+
+// bounds a single pixel's share of the budget
+#define ADAPTIVE_MAX_ERROR 4.0
+// the fixed point error sum of a frame stays below this, see AdaptiveErrorScale
+#define ADAPTIVE_ERROR_SUM_LIMIT 2147483648.0
+// dark pixels would never converge in relative terms
+#define ADAPTIVE_MIN_MEAN 0.01
+
+struct PixelVariance
+{
+    float mean;
+    float m2;
+    uint samples;
+    uint frames;
+};
+
+layout (binding = 38) buffer PixelVarianceBuf { PixelVariance pixelVariance[]; };
+// samples of every pixel in the next frame, written by the budget pass
+layout (binding = 39) buffer SampleBudgetBuf { uint sampleBudget[]; };
+// totals of the frame, read back into AdaptiveStats
+layout (binding = 40) buffer AdaptiveStatsBuf
+{
+    uint statErrorSum;
+    uint statActivePixels;
+    uint statBudgetSamples;
+};
+
+uint PixelIndex(in ivec2 pixel)
+{
+    return uint(pixel.y * RenderSize().x + pixel.x);
+}
+
+bool InsideImage(in ivec2 pixel)
+{
+    ivec2 size = RenderSize();
+    return pixel.x < size.x && pixel.y < size.y && PixelIndex(pixel) < uint(pixelVariance.length());
+}
+
+// statistics since the last reset, empty on the first frame
+PixelVariance LoadPixelVariance(in uint index)
+{
+    if (camera.accumulatedFrames == 0) return PixelVariance(0.0, 0.0, 0, 0);
+    return pixelVariance[index];
+}
+
+uint MaxPixelSamples()
+{
+    return ADAPTIVE_MAX_SAMPLE_SCALE * uint(camera.samples);
+}
+
+// samples the pixel traces this frame
+uint PixelBudget(in uint index)
+{
+    PixelVariance stats = LoadPixelVariance(index);
+    if (adaptiveSampling == 0 || stats.frames < ADAPTIVE_MIN_FRAMES) return uint(camera.samples);
+    return sampleBudget[index];
+}
+
+// index of the pixel's first sample this frame, samples continue over the accumulated frames
+uint PixelSampleBase(in uint index)
+{
+    return LoadPixelVariance(index).samples;
+}
+
+// weighted Welford update with the frame mean of the given samples
+void AddPixelVariance(inout PixelVariance stats, in float value, in uint samples)
+{
+    float total = float(stats.samples + samples);
+    float delta = value - stats.mean;
+    stats.mean += delta * float(samples) / total;
+    stats.m2 += float(samples) * delta * (value - stats.mean);
+    stats.samples += samples;
+    stats.frames++;
+}
+
+// relative standard error of the pixel's mean, 0 once it is below the threshold
+float PixelError(in PixelVariance stats)
+{
+    if (stats.frames < ADAPTIVE_MIN_FRAMES) return 0.0;
+    // each frame mean counts as its samples, so m2 / (frames - 1) estimates the variance of one sample
+    float variance = stats.m2 / float(stats.frames - 1);
+    float error = sqrt(variance / float(stats.samples)) / max(stats.mean, ADAPTIVE_MIN_MEAN);
+    return error > adaptiveThreshold ? min(error, ADAPTIVE_MAX_ERROR) : 0.0;
+}
+
+vec3 SampleMapColor(in uint samples)
+{
+    if (samples == 0) return vec3(0.0, 0.0, 0.1);
+    float t = clamp(float(samples) / float(MaxPixelSamples()), 0.0, 1.0);
+    return clamp(vec3(1.5 * t - 0.25, 1.0 - abs(2.0 * t - 1.0), 1.25 - 1.5 * t), 0.0, 1.0);
+}
+
+// Fixed point steps per unit of error. Every pixel adds up to ADAPTIVE_MAX_ERROR, so images too large
+// for ADAPTIVE_ERROR_SCALE to keep the sum below ADAPTIVE_ERROR_SUM_LIMIT get coarser steps.
+float AdaptiveErrorScale()
+{
+    ivec2 size = RenderSize();
+    return min(ADAPTIVE_ERROR_SCALE, ADAPTIVE_ERROR_SUM_LIMIT / (ADAPTIVE_MAX_ERROR * float(size.x * size.y)));
+}
+
+void AdaptiveError()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    uint error = 0;
+    uint active = 0;
+    if (InsideImage(pixel)) {
+        float value = PixelError(LoadPixelVariance(PixelIndex(pixel)));
+        error = uint(value * AdaptiveErrorScale());
+        active = value > 0.0 ? 1u : 0u;
+    }
+
+    uint subgroupError = subgroupAdd(error);
+    uint subgroupActive = subgroupAdd(active);
+    if (subgroupElect()) {
+        atomicAdd(statErrorSum, subgroupError);
+        atomicAdd(statActivePixels, subgroupActive);
+    }
+}
+
+// Shares adaptiveBudget times the samples of a uniform frame between the pixels in proportion to their
+// error. Fractions are rounded randomly, so the expected total matches.
+void AdaptiveBudget()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    uint budget = 0;
+    if (InsideImage(pixel)) {
+        uint index = PixelIndex(pixel);
+        uint error = uint(PixelError(LoadPixelVariance(index)) * AdaptiveErrorScale());
+        if (error > 0) {
+            ivec2 size = RenderSize();
+            float total = adaptiveBudget * float(camera.samples) * float(size.x * size.y);
+            float share = total * float(error) / float(statErrorSum);
+            float u = UintToUnit(PcgHash(HashCombine(index, camera.frameIndex)));
+            budget = min(uint(share + u), MaxPixelSamples());
+        }
+        sampleBudget[index] = budget;
+    }
+
+    uint subgroupBudget = subgroupAdd(budget);
+    if (subgroupElect()) atomicAdd(statBudgetSamples, subgroupBudget);
+}
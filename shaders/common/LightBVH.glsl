@@ -0,0 +1,130 @@
+// Light hierarchy over the sphere lights, built by LightBVH in src/graphics/accel/LightBVH.cpp.
+// Lights are picked by walking down from the root and choosing each child in proportion to
+// LightImportance, so a light's chance follows its estimated contribution at the shading point.
+
+#ifndef LIGHT_BVH_GLSL
+#define LIGHT_BVH_GLSL
+
+// inner nodes: first child right after the node, second at ref. leaves: LIGHT_LEAF_BIT | light index.
+// The cone bounds the emitter normals, each of them emits over a half angle of pi / 2.
+struct LightBVHNode {
+    vec3 min;
+    uint ref;
+    vec3 max;
+    float power;
+    vec3 axis;
+    float cosTheta;
+};
+
+#define LIGHT_LEAF_BIT 0x80000000u
+#define LIGHT_ONE_MINUS_EPSILON 0.99999994
+
+layout (binding = 47) readonly buffer LightBVHNodeBuf {
+    LightBVHNode lightNodes[];
+};
+
+// bit i is set when the way to light j takes the second child at depth i
+layout (binding = 48) readonly buffer LightTrailBuf {
+    uint lightTrails[];
+};
+
+// cos(max(0, a - b)) from the sines and cosines of both angles
+float CosSubClamped(in float sinA, in float cosA, in float sinB, in float cosB)
+{
+    return cosA > cosB ? 1.0 : cosA * cosB + sinA * sinB;
+}
+
+float SinSubClamped(in float sinA, in float cosA, in float sinB, in float cosB)
+{
+    return cosA > cosB ? 0.0 : sinA * cosB - cosA * sinB;
+}
+
+// Conservative estimate of what the node's lights contribute at p, mirrors LightBVH::importance.
+// A zero normal ignores the facing of the receiver.
+float LightImportance(in LightBVHNode node, in vec3 p, in vec3 n)
+{
+    if (node.power <= 0.0) return 0.0;
+
+    vec3 center = (node.min + node.max) * 0.5;
+    vec3 toPoint = p - center;
+    float distanceSq = dot(toPoint, toPoint);
+    float radius = length(node.max - node.min) * 0.5;
+    vec3 wi = distanceSq > 0.0 ? toPoint / sqrt(distanceSq) : vec3(0.0, 0.0, 1.0);
+
+    // half angle the bounds subtend from p, everything when p is inside them
+    float sinBoundsSq = radius * radius / max(distanceSq, 1e-12);
+    float cosBounds = sinBoundsSq < 1.0 ? sqrt(max(1.0 - sinBoundsSq, 0.0)) : -1.0;
+    float sinBounds = sqrt(max(1.0 - cosBounds * cosBounds, 0.0));
+
+    // smallest angle between p and an emitter normal of the cone, seen from anywhere in the bounds
+    float cosW = dot(node.axis, wi);
+    float sinW = sqrt(max(1.0 - cosW * cosW, 0.0));
+    float sinO = sqrt(max(1.0 - node.cosTheta * node.cosTheta, 0.0));
+    float cosX = CosSubClamped(sinW, cosW, sinO, node.cosTheta);
+    float sinX = SinSubClamped(sinW, cosW, sinO, node.cosTheta);
+    float cosEmit = CosSubClamped(sinX, cosX, sinBounds, cosBounds);
+    if (cosEmit <= 0.0) return 0.0;
+
+    float importance = node.power * cosEmit / max(distanceSq, radius);
+    if (n != vec3(0.0)) {
+        // light sampling only covers the side the normal faces
+        float cosI = dot(-wi, n);
+        float sinI = sqrt(max(1.0 - cosI * cosI, 0.0));
+        importance *= max(CosSubClamped(sinI, cosI, sinBounds, cosBounds), 0.0);
+    }
+    return importance;
+}
+
+// Picks a sphere light for p with a single random number, its bits are reused at every level.
+// False when no light can contribute at p.
+bool SampleLightBVH(in vec3 p, in vec3 n, in float u, out uint light, out float pmf)
+{
+    light = 0;
+    pmf = 1.0;
+    if (LightImportance(lightNodes[0], p, n) <= 0.0) return false;
+
+    uint index = 0;
+    LightBVHNode node = lightNodes[0];
+    while ((node.ref & LIGHT_LEAF_BIT) == 0) {
+        float first = LightImportance(lightNodes[index + 1], p, n);
+        float total = first + LightImportance(lightNodes[node.ref], p, n);
+        if (total <= 0.0) return false;
+
+        float p0 = first / total;
+        if (u < p0) {
+            index = index + 1;
+            u = min(u / p0, LIGHT_ONE_MINUS_EPSILON);
+            pmf *= p0;
+        } else {
+            index = node.ref;
+            u = min((u - p0) / (1.0 - p0), LIGHT_ONE_MINUS_EPSILON);
+            pmf *= 1.0 - p0;
+        }
+        node = lightNodes[index];
+    }
+    light = node.ref & ~LIGHT_LEAF_BIT;
+    return true;
+}
+
+// probability of SampleLightBVH picking the light at p, follows the light's trail from the root
+float LightBVHPmf(in vec3 p, in vec3 n, in uint light)
+{
+    uint trail = lightTrails[light];
+    uint index = 0;
+    float pmf = 1.0;
+    LightBVHNode node = lightNodes[0];
+    while ((node.ref & LIGHT_LEAF_BIT) == 0) {
+        float first = LightImportance(lightNodes[index + 1], p, n);
+        float total = first + LightImportance(lightNodes[node.ref], p, n);
+        if (total <= 0.0) return 0.0;
+
+        bool second = (trail & 1u) != 0;
+        pmf *= (second ? total - first : first) / total;
+        index = second ? node.ref : index + 1;
+        trail >>= 1;
+        node = lightNodes[index];
+    }
+    return pmf;
+}
+
+#endif
@@ -0,0 +1,123 @@
+// Random numbers of the path tracer. Every value is a function of the pixel, the sample index and the
+// dimension, so a path can be resumed in any kernel and samples stay stratified across frames.
+//  - SAMPLER_PCG hashes all three.
+//  - SAMPLER_SOBOL is an Owen scrambled 4D Sobol sequence (Burley 2020). Dimensions are used in groups
+//    of four, every pixel and group shuffles the sequence and scrambles its digits with its own seed.
+//  - SAMPLER_BLUE_NOISE shares one scrambled sequence between all pixels and shifts it per pixel by a
+//    blue noise tile, which spreads the remaining error as blue noise over the screen.
+// The tables are generated by SamplerTables. Needs samplerType from RenderSettingsBuf.
+
+#define SAMPLER_PCG 0
+#define SAMPLER_SOBOL 1
+#define SAMPLER_BLUE_NOISE 2
+
+// mirror SamplerTables
+#define SOBOL_DIMENSIONS 4
+#define SOBOL_BITS 32
+#define BLUE_NOISE_SIZE 64
+
+// dimensions of a bounce, Sample1D and Sample2D take them relative to the current bounce
+#define DIM_LOBE 0
+#define DIM_BLEND 1
+#define DIM_LIGHT_SELECT 2
+#define DIM_ROULETTE 3
+#define DIM_LIGHT 4
+#define DIM_BSDF 6
+#define SAMPLER_BOUNCE_DIMENSIONS 8
+
+layout (binding = 36) readonly buffer SobolDirectionBuf {
+    uint sobolDirections[];
+};
+
+layout (binding = 37) readonly buffer BlueNoiseBuf {
+    float blueNoise[];
+};
+
+uvec2 _SamplerPixel;
+uint _SamplerIndex;
+// first dimension of the current bounce
+uint _SamplerBase;
+
+uint PcgHash(in uint v)
+{
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+uint HashCombine(in uint seed, in uint v)
+{
+    return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+// random permutation of the digits that keeps the sequence stratified, from Burley 2020
+uint NestedUniformScramble(in uint x, in uint seed)
+{
+    x = bitfieldReverse(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return bitfieldReverse(x);
+}
+
+uint SobolSample(in uint index, in uint dimension)
+{
+    uint result = 0;
+    for (uint bit = 0; index != 0; ++bit, index >>= 1) {
+        if ((index & 1u) != 0) result ^= sobolDirections[dimension * SOBOL_BITS + bit];
+    }
+    return result;
+}
+
+// top 24 bits, so the result stays below 1
+float UintToUnit(in uint x)
+{
+    return float(x >> 8) * (1.0 / 16777216.0);
+}
+
+// every dimension reads the tile at another offset, so they don't correlate
+float BlueNoise(in uint dimension)
+{
+    uvec2 offset = uvec2(fract(vec2(0.7548776662, 0.5698402910) * float(dimension + 1)) * float(BLUE_NOISE_SIZE));
+    uvec2 p = (_SamplerPixel + offset) % BLUE_NOISE_SIZE;
+    return blueNoise[p.y * BLUE_NOISE_SIZE + p.x];
+}
+
+float SampleDimension(in uint dimension)
+{
+    uint pixelSeed = PcgHash(_SamplerPixel.x + PcgHash(_SamplerPixel.y));
+    if (samplerType == SAMPLER_PCG) {
+        return UintToUnit(PcgHash(HashCombine(PcgHash(HashCombine(pixelSeed, _SamplerIndex)), dimension)));
+    }
+
+    bool blue = samplerType == SAMPLER_BLUE_NOISE;
+    uint seed = PcgHash(HashCombine(blue ? 0u : pixelSeed, dimension / SOBOL_DIMENSIONS));
+    uint index = NestedUniformScramble(_SamplerIndex, seed);
+    uint value = NestedUniformScramble(SobolSample(index, dimension % SOBOL_DIMENSIONS), HashCombine(seed, dimension));
+    return blue ? fract(UintToUnit(value) + BlueNoise(dimension)) : UintToUnit(value);
+}
+
+// starts the given sample of a pixel at its first bounce
+void SamplerStart(in uvec2 pixel, in uint sampleIndex)
+{
+    _SamplerPixel = pixel;
+    _SamplerIndex = sampleIndex;
+    _SamplerBase = 0;
+}
+
+void SamplerBounce(in uint bounce)
+{
+    _SamplerBase = bounce * SAMPLER_BOUNCE_DIMENSIONS;
+}
+
+float Sample1D(in uint dimension)
+{
+    return SampleDimension(_SamplerBase + dimension);
+}
+
+vec2 Sample2D(in uint dimension)
+{
+    return vec2(SampleDimension(_SamplerBase + dimension), SampleDimension(_SamplerBase + dimension + 1));
+}
@@ -0,0 +1,233 @@
+// Scene primitives and their buffers, shared by the path tracer and the acceleration structure passes.
+// Layouts must match include/graphics/Primitives.hpp and include/graphics/accel/BVH.hpp.
+// Includers enable GL_EXT_scalar_block_layout, the instanced sphere buffer uses it.
+
+#ifndef SCENE_GLSL
+#define SCENE_GLSL
+
+// entry of the shared material table, primitives store its index
+struct Material
+{
+    vec3 albedo;
+	float metallic;
+    float roughness;
+    float specular;
+    float specTrans;
+    float ior;
+    vec3 color;
+    float pad0;
+};
+
+struct Sphere
+{
+    vec3 position;
+    float radius;
+    uint material;
+};
+
+struct Box {
+    vec3 min;
+    uint material;
+    vec3 max;
+    float pad0;
+};
+
+// vertex indices are global into meshVertices
+struct Triangle {
+    uint v0;
+    uint v1;
+    uint v2;
+    uint material;
+};
+
+struct DirectLight {
+    vec3 direction;
+    float intensity;
+    vec3 color;
+    float pad0;
+};
+
+struct SpotLight {
+    vec3 position;
+    float intensity;
+    vec3 color;
+    float radius;
+};
+
+// inner nodes: count == 0, children at leftFirst and leftFirst + 1
+// leaves: primRefs[leftFirst .. leftFirst + count)
+struct BVHNode {
+    vec3 min;
+    uint leftFirst;
+    vec3 max;
+    uint count;
+};
+
+// rows of the affine world to object transform, the ray is moved into the group's space
+// and traverses its bottom-level tree starting at blasRoot
+struct Instance {
+    vec4 worldToObject[3];
+    uint blasRoot;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+// 4-wide node, child bounds are 8-bit offsets from origin in power of two steps.
+// meta bytes 0-2 are the float exponent bits of the x, y, z step, byte 3 the child count.
+// Byte i of lo/hi.xyz is child i's quantized min/max, children are node indices or
+// WIDE_LEAF_BIT | count << WIDE_LEAF_COUNT_SHIFT | first prim ref.
+struct WideBVHNode {
+    vec3 origin;
+    uint meta;
+    uvec4 lo;
+    uvec4 hi;
+    uvec4 children;
+};
+
+#define WIDE_BVH_WIDTH 4
+#define WIDE_LEAF_BIT 0x80000000u
+#define WIDE_LEAF_COUNT_SHIFT 28
+#define WIDE_LEAF_FIRST_MASK 0x0FFFFFFFu
+
+#define PRIM_TYPE_SHIFT 28
+#define PRIM_INDEX_MASK 0x0FFFFFFF
+#define PRIM_SPHERE 0
+#define PRIM_BOX 1
+#define PRIM_TRIANGLE 2
+#define PRIM_PLANE 3
+#define PRIM_SPOT_LIGHT 4
+#define MAX_PRIMITIVE_TYPES 16
+#define BVH_STACK_SIZE 64
+#define NO_MATERIAL 0xFFFFFFFFu
+
+// Tagged primitive stream, see PrimitiveStream and PackedScene. Every type is a range of the shared
+// payload and material arrays, refs use the same type tags as the acceleration structures.
+// Primitive i of type t starts at primitivePayload[primitiveTypes[t].payloadOffset + i * stride].
+struct PrimitiveTypeRange {
+    uint payloadOffset;
+    uint stride;
+    uint materialOffset;
+    uint count;
+};
+
+layout (binding = 1) readonly buffer PrimitivePayloadBuf
+{
+    vec4 primitivePayload[];
+};
+
+// only read for hits
+layout (binding = 2) readonly buffer PrimitiveMaterialBuf
+{
+    uint primitiveMaterials[];
+};
+
+layout (binding = 3) readonly buffer PrimitiveInfoBuf
+{
+    uint unboundedCount;
+    uint primitivePad0;
+    uint primitivePad1;
+    uint primitivePad2;
+    PrimitiveTypeRange primitiveTypes[MAX_PRIMITIVE_TYPES];
+};
+
+// refs of the primitives that stay out of the acceleration structures, e.g. planes
+layout (binding = 4) readonly buffer UnboundedRefBuf
+{
+    uint unboundedRefs[];
+};
+
+layout (binding = 5) buffer DirectLightBuf {
+    DirectLight directLights[];
+};
+
+// the GPU builder defines BVH_ACCESS empty to write the tree
+#ifndef BVH_ACCESS
+#define BVH_ACCESS readonly
+layout (binding = 20) readonly buffer MeshVertexBuf {
+    vec4 meshVertices[];
+};
+
+layout (binding = 21) readonly buffer TriangleBuf {
+    Triangle triangles[];
+};
+
+// only read for the closest hit of a ray
+layout (binding = 22) readonly buffer MaterialBuf {
+    Material materials[];
+};
+
+// uniform grid over spheres, boxes and spot lights, cell i holds gridPrimRefs[gridCells[i] .. gridCells[i + 1])
+layout (binding = 23) readonly buffer GridInfoBuf {
+    vec3 gridMin;
+    uint gridEnabled;
+    vec3 gridMax;
+    uint gridPad0;
+    uvec3 gridResolution;
+    uint gridPad1;
+    vec3 gridCellSize;
+    uint gridPad2;
+};
+
+layout (binding = 24) readonly buffer GridCellBuf {
+    uint gridCells[];
+};
+
+layout (binding = 25) readonly buffer GridPrimRefBuf {
+    uint gridPrimRefs[];
+};
+
+#endif
+
+vec4 PrimitiveWord(uint type, uint index, uint word) {
+    return primitivePayload[primitiveTypes[type].payloadOffset + index * primitiveTypes[type].stride + word];
+}
+
+uint SphereCount() {
+    return primitiveTypes[PRIM_SPHERE].count;
+}
+
+uint BoxCount() {
+    return primitiveTypes[PRIM_BOX].count;
+}
+
+layout (binding = 6) BVH_ACCESS buffer BVHNodeBuf {
+    BVHNode bvhNodes[];
+};
+
+layout (binding = 7) BVH_ACCESS buffer PrimRefBuf {
+    uint primRefs[];
+};
+
+// instanced geometry: every group's primitives and BLAS nodes are concatenated,
+// node and prim ref indices are already offset into the shared arrays
+layout (binding = 13, scalar) readonly buffer BlasSphereBuf {
+    Sphere blasSpheres[];
+};
+
+layout (binding = 14) readonly buffer BlasBoxBuf {
+    Box blasBoxes[];
+};
+
+layout (binding = 15) readonly buffer BlasNodeBuf {
+    WideBVHNode blasNodes[];
+};
+
+layout (binding = 16) readonly buffer BlasPrimRefBuf {
+    uint blasPrimRefs[];
+};
+
+layout (binding = 17) readonly buffer InstanceBuf {
+    Instance instances[];
+};
+
+// top-level tree over instance world bounds, leaves reference tlasInstanceRefs
+layout (binding = 18) readonly buffer TlasNodeBuf {
+    BVHNode tlasNodes[];
+};
+
+layout (binding = 19) readonly buffer TlasInstanceRefBuf {
+    uint tlasInstanceRefs[];
+};
+
+#endif
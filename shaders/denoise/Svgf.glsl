@@ -0,0 +1,185 @@
+// Spatiotemporal variance-guided filtering (Schied et al. 2017), run by Denoiser. The first sample of
+// every pixel writes its primary hit to the G-buffer. After the trace the prepare pass divides the
+// accumulation by the albedo and attaches the variance of its luminance, from the running per-pixel
+// statistics once there are two frames and from the neighbourhood before. The a-trous passes then
+// filter with growing steps, stopped at depth, normal and luminance edges, and the resolve pass
+// multiplies the albedo back in for display. The accumulation itself is never touched, and as its
+// variance shrinks the filter fades out on its own.
+// Included by RTNew.comp before WritePixel.
+
+#define KERNEL_DENOISE_PREPARE 13
+#define KERNEL_DENOISE_ATROUS 14
+#define KERNEL_DENOISE_RESOLVE 15
+
+// mirrors Denoiser::ITERATIONS
+#define DENOISE_ITERATIONS 5
+
+#define DENOISE_SIGMA_DEPTH 1.0
+#define DENOISE_SIGMA_NORMAL 128.0
+#define DENOISE_SIGMA_LUMINANCE 4.0
+// dark albedos aren't divided out, they would blow up the noise
+#define DENOISE_MIN_ALBEDO 0.05
+
+struct GBufferTexel
+{
+    vec3 normal;
+    float depth;
+    vec3 albedo;
+    uint pad0;
+};
+
+layout (binding = 45) buffer GBufferBuf { GBufferTexel gBuffer[]; };
+// illumination and its variance, two images back to back that the a-trous passes alternate between
+layout (binding = 46) buffer DenoiseBuf { vec4 denoiseBuffer[]; };
+
+void WriteGBuffer(in uint index, in RayHit hit)
+{
+    if (denoising == 0 || index >= uint(gBuffer.length())) return;
+    bool surface = hit.distance < Inf && hit.material != NO_MATERIAL;
+    gBuffer[index] = GBufferTexel(hit.distance < Inf ? hit.normal : vec3(0.0), hit.distance, surface ? hit.albedo : vec3(1.0), 0);
+}
+
+vec3 DemodulationAlbedo(in GBufferTexel texel)
+{
+    return Luminance(texel.albedo) < DENOISE_MIN_ALBEDO ? vec3(1.0) : max(texel.albedo, vec3(DENOISE_MIN_ALBEDO));
+}
+
+uint DenoiseSlot(in uint image, in uint index)
+{
+    return image * uint(gBuffer.length()) + index;
+}
+
+bool IsBackground(in GBufferTexel texel)
+{
+    return texel.depth >= Inf;
+}
+
+// weight of a neighbour's G-buffer texel, the depth is compared along the center's depth gradient
+float EdgeWeight(in GBufferTexel center, in GBufferTexel texel, in vec2 depthGradient, in vec2 offset)
+{
+    if (IsBackground(texel)) return 0.0;
+    float depth = exp(-abs(center.depth - texel.depth) / (DENOISE_SIGMA_DEPTH * abs(dot(depthGradient, offset)) + Epsilon));
+    float normal = pow(max(dot(center.normal, texel.normal), 0.0), DENOISE_SIGMA_NORMAL);
+    return depth * normal;
+}
+
+vec2 DepthGradient(in ivec2 pixel)
+{
+    ivec2 size = RenderSize();
+    ivec2 left = max(pixel - ivec2(1, 0), ivec2(0));
+    ivec2 right = min(pixel + ivec2(1, 0), size - 1);
+    ivec2 down = max(pixel - ivec2(0, 1), ivec2(0));
+    ivec2 up = min(pixel + ivec2(0, 1), size - 1);
+    return vec2(
+        (gBuffer[PixelIndex(right)].depth - gBuffer[PixelIndex(left)].depth) / float(max(right.x - left.x, 1)),
+        (gBuffer[PixelIndex(up)].depth - gBuffer[PixelIndex(down)].depth) / float(max(up.y - down.y, 1)));
+}
+
+// variance of the pixels around that see the same surface, for pixels without two frames of history
+float SpatialVariance(in ivec2 pixel, in GBufferTexel center)
+{
+    ivec2 size = RenderSize();
+    vec2 gradient = DepthGradient(pixel);
+    float weight = 0.0;
+    float m1 = 0.0;
+    float m2 = 0.0;
+    for (int y = -3; y <= 3; ++y) {
+        for (int x = -3; x <= 3; ++x) {
+            ivec2 p = pixel + ivec2(x, y);
+            if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, size))) continue;
+            GBufferTexel texel = gBuffer[PixelIndex(p)];
+            float w = (x == 0 && y == 0) ? 1.0 : EdgeWeight(center, texel, gradient, vec2(x, y));
+            float l = Luminance(imageLoad(accumulationImage, p).rgb / DemodulationAlbedo(texel));
+            m1 += w * l;
+            m2 += w * l * l;
+            weight += w;
+        }
+    }
+    m1 /= weight;
+    return max(m2 / weight - m1 * m1, 0.0);
+}
+
+void DenoisePrepare()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (!InsideImage(pixel)) return;
+    uint index = PixelIndex(pixel);
+
+    GBufferTexel texel = gBuffer[index];
+    vec3 albedo = DemodulationAlbedo(texel);
+    vec3 illumination = imageLoad(accumulationImage, pixel).rgb / albedo;
+
+    // the pixel statistics are of the color, the filter works on the illumination
+    PixelVariance stats = pixelVariance[index];
+    float variance;
+    if (stats.frames >= ADAPTIVE_MIN_FRAMES) {
+        variance = stats.m2 / float(stats.frames - 1) / float(stats.samples) / (Luminance(albedo) * Luminance(albedo));
+    } else {
+        variance = IsBackground(texel) ? 0.0 : SpatialVariance(pixel, texel);
+    }
+    denoiseBuffer[DenoiseSlot(0, index)] = vec4(illumination, variance);
+}
+
+// one level of the wavelet transform, the loop iteration picks its step and the images it swaps
+void DenoiseAtrous()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (!InsideImage(pixel)) return;
+    uint index = PixelIndex(pixel);
+
+    uint source = camera.loopIteration & 1u;
+    int step = 1 << camera.loopIteration;
+    vec4 center = denoiseBuffer[DenoiseSlot(source, index)];
+    GBufferTexel texel = gBuffer[index];
+    if (IsBackground(texel)) {
+        denoiseBuffer[DenoiseSlot(source ^ 1u, index)] = center;
+        return;
+    }
+
+    ivec2 size = RenderSize();
+    const float atrousKernel[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+
+    // the luminance is only compared relative to the deviation around the pixel, smoothed by a 3x3 gaussian
+    float variance = 0.0;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            ivec2 p = clamp(pixel + ivec2(x, y), ivec2(0), size - 1);
+            variance += denoiseBuffer[DenoiseSlot(source, PixelIndex(p))].a * (x == 0 ? 0.5 : 0.25) * (y == 0 ? 0.5 : 0.25);
+        }
+    }
+    float luminanceScale = DENOISE_SIGMA_LUMINANCE * sqrt(variance) + Epsilon;
+    float centerLuminance = Luminance(center.rgb);
+    vec2 gradient = DepthGradient(pixel);
+
+    vec3 color = center.rgb * atrousKernel[0] * atrousKernel[0];
+    float filteredVariance = center.a * atrousKernel[0] * atrousKernel[0] * atrousKernel[0] * atrousKernel[0];
+    float weight = atrousKernel[0] * atrousKernel[0];
+    for (int y = -2; y <= 2; ++y) {
+        for (int x = -2; x <= 2; ++x) {
+            if (x == 0 && y == 0) continue;
+            ivec2 p = pixel + ivec2(x, y) * step;
+            if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, size))) continue;
+
+            uint neighbour = PixelIndex(p);
+            vec4 tap = denoiseBuffer[DenoiseSlot(source, neighbour)];
+            float w = atrousKernel[abs(x)] * atrousKernel[abs(y)]
+                    * EdgeWeight(texel, gBuffer[neighbour], gradient, vec2(ivec2(x, y) * step))
+                    * exp(-abs(centerLuminance - Luminance(tap.rgb)) / luminanceScale);
+
+            color += w * tap.rgb;
+            filteredVariance += w * w * tap.a;
+            weight += w;
+        }
+    }
+    denoiseBuffer[DenoiseSlot(source ^ 1u, index)] = vec4(color / weight, filteredVariance / (weight * weight));
+}
+
+void DenoiseResolve()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (debugView != DEBUG_VIEW_NONE || !InsideImage(pixel)) return;
+    uint index = PixelIndex(pixel);
+
+    vec3 illumination = denoiseBuffer[DenoiseSlot(DENOISE_ITERATIONS & 1, index)].rgb;
+    imageStore(computeImage, pixel, DisplayColor(illumination * DemodulationAlbedo(gBuffer[index])));
+}
@@ -0,0 +1,102 @@
+// Shared state of the GPU LBVH builder (Karras 2012). The passes run in this order every frame:
+// Reset, Bounds, Morton, 4x (RadixHistogram, RadixScan, RadixScatter), Hierarchy, Propagate.
+// Spheres, boxes and spot lights are numbered as one primitive list in that order.
+
+#ifndef LBVH_COMMON_GLSL
+#define LBVH_COMMON_GLSL
+
+#define BVH_ACCESS
+#include "../common/Scene.glsl"
+
+#define LBVH_GROUP_SIZE 256
+#define RADIX_BITS 8
+#define RADIX_SIZE 256
+#define LBVH_INVALID 0xFFFFFFFFu
+
+// internal nodes are 0 .. n - 2, leaves follow at n - 1 .. 2n - 2.
+// slot is the node's index in bvhNodes, children of internal node i live at slots 2i + 1 and 2i + 2.
+struct LbvhNode {
+    vec3 min;
+    uint parent;
+    vec3 max;
+    uint slot;
+    uint left;
+    uint right;
+    uint visits;
+    uint pad0;
+};
+
+// both sort buffers hold two halves of n entries and ping-pong between radix passes
+layout (binding = 8) buffer LbvhKeyBuf {
+    uint lbvhKeys[];
+};
+
+layout (binding = 9) buffer LbvhValueBuf {
+    uint lbvhValues[];
+};
+
+// digit-major: lbvhHistogram[digit * blockCount + block]
+layout (binding = 10) buffer LbvhHistogramBuf {
+    uint lbvhHistogram[];
+};
+
+layout (binding = 11) coherent buffer LbvhNodeBuf {
+    LbvhNode lbvhNodes[];
+};
+
+// centroid bounds as order preserving uints, min xyz then max xyz
+layout (binding = 12) buffer LbvhGlobalBuf {
+    uint lbvhCentroidBounds[6];
+};
+
+uint PrimitiveCount() {
+    return SphereCount() + BoxCount() + primitiveTypes[PRIM_SPOT_LIGHT].count;
+}
+
+uint RadixBlockCount() {
+    return (PrimitiveCount() + LBVH_GROUP_SIZE - 1) / LBVH_GROUP_SIZE;
+}
+
+void PrimitiveBounds(uint prim, out vec3 bmin, out vec3 bmax) {
+    uint sphereCount = SphereCount();
+    if (prim < sphereCount) {
+        vec4 sphere = PrimitiveWord(PRIM_SPHERE, prim, 0);
+        bmin = sphere.xyz - vec3(sphere.w);
+        bmax = sphere.xyz + vec3(sphere.w);
+    } else if (prim < sphereCount + BoxCount()) {
+        uint box = prim - sphereCount;
+        bmin = PrimitiveWord(PRIM_BOX, box, 0).xyz;
+        bmax = PrimitiveWord(PRIM_BOX, box, 1).xyz;
+    } else {
+        // word 0 is position and intensity, word 1 color and radius
+        uint light = prim - sphereCount - BoxCount();
+        vec3 position = PrimitiveWord(PRIM_SPOT_LIGHT, light, 0).xyz;
+        float radius = PrimitiveWord(PRIM_SPOT_LIGHT, light, 1).w;
+        bmin = position - vec3(radius);
+        bmax = position + vec3(radius);
+    }
+}
+
+uint PrimitiveRef(uint prim) {
+    uint sphereCount = SphereCount();
+    if (prim < sphereCount) {
+        return (uint(PRIM_SPHERE) << PRIM_TYPE_SHIFT) | prim;
+    }
+    uint boxCount = BoxCount();
+    if (prim < sphereCount + boxCount) {
+        return (uint(PRIM_BOX) << PRIM_TYPE_SHIFT) | (prim - sphereCount);
+    }
+    return (uint(PRIM_SPOT_LIGHT) << PRIM_TYPE_SHIFT) | (prim - sphereCount - boxCount);
+}
+
+// maps floats to uints with the same ordering so atomicMin/atomicMax work on them
+uint FloatToOrdered(float f) {
+    uint u = floatBitsToUint(f);
+    return (u & 0x80000000u) != 0 ? ~u : u | 0x80000000u;
+}
+
+float OrderedToFloat(uint u) {
+    return uintBitsToFloat((u & 0x80000000u) != 0 ? u & 0x7FFFFFFFu : ~u);
+}
+
+#endif
@@ -0,0 +1,373 @@
+// Spatiotemporal reservoir resampling of the direct light (ReSTIR, Bitterli et al. 2020), run by
+// LightResampler before the trace. Only the primary hits are resampled, camera rays aren't jittered so
+// every sample of a pixel shares them. The candidate pass streams restirCandidates light samples, drawn
+// the way SampleLight draws them, through a reservoir weighted by their unshadowed contribution and drops
+// the pick if something blocks it. The temporal pass merges the final reservoir the surface had in the
+// previous frame, the spatial pass those of restirNeighbours similar pixels around it. The shade pass
+// traces the pick's shadow ray and stores what it adds, the path tracer uses that in place of its own
+// light sample at the first bounce. Merged picks are weighted with the balance heuristic over the targets
+// of all merged surfaces scaled by their candidate counts, which keeps the reuse unbiased as long as the
+// shadows agree, without the noise counting whole reservoirs brings when neighbours see other lights.
+// Included by RTNew.comp after temporal/Temporal.glsl.
+
+#define KERNEL_RESTIR_CANDIDATES 16
+#define KERNEL_RESTIR_TEMPORAL 17
+#define KERNEL_RESTIR_SPATIAL 18
+#define KERNEL_RESTIR_SHADE 19
+
+// mirrors LightResampler::MAX_NEIGHBOURS
+#define RESTIR_MAX_NEIGHBOURS 16
+// mirror Reservoir::NO_LIGHT and Reservoir::DIRECT_LIGHT_BIT
+#define RESTIR_NO_LIGHT 0xFFFFFFFFu
+#define RESTIR_DIRECT_LIGHT_BIT 0x80000000u
+// neighbours with normals further apart, or depths further apart relative to the depth, see another surface
+#define RESTIR_NORMAL_THRESHOLD 0.9
+#define RESTIR_DEPTH_THRESHOLD 0.1
+
+// mirrors Reservoir in include/graphics/Reservoir.hpp
+struct Reservoir
+{
+    // where on the sphere light the pick is, as the unit offset from its center. Unused for directional lights.
+    vec3 point;
+    uint light;
+    float weightSum;
+    // candidates the reservoir stands for, M in the paper
+    float count;
+    // unbiased contribution weight of the pick, W in the paper
+    float weight;
+    float pad0;
+};
+
+// primary hit of a pixel, material is NO_MATERIAL where it isn't a surface
+struct RestirSurface
+{
+    vec3 position;
+    uint material;
+    vec3 normal;
+    float depth;
+};
+
+// the final reservoirs, which the next frame reuses, then those of the running frame
+layout (binding = 49) buffer ReservoirBuf { Reservoir reservoirs[]; };
+// primary hits of two frames back to back
+layout (binding = 50) buffer RestirSurfaceBuf { RestirSurface restirSurfaces[]; };
+// shadowed contribution of the final pick of every pixel
+layout (binding = 51) buffer ResampledLightBuf { vec4 resampledLight[]; };
+
+uint restirState;
+
+// its own stream per pixel, frame and pass, the path sampler's dimensions are left alone
+void RestirSeed(in ivec2 pixel, in uint stage)
+{
+    restirState = PcgHash(HashCombine(HashCombine(PcgHash(PixelIndex(pixel)), camera.frameIndex), stage));
+}
+
+float RestirRandom()
+{
+    restirState = PcgHash(restirState);
+    return UintToUnit(restirState);
+}
+
+uint RestirPixels()
+{
+    ivec2 size = RenderSize();
+    return uint(size.x * size.y);
+}
+
+uint ReservoirSlot(in uint image, in uint index)
+{
+    return image * RestirPixels() + index;
+}
+
+uint SurfaceSlot(in uint frame, in uint index)
+{
+    return (frame & 1u) * RestirPixels() + index;
+}
+
+Reservoir EmptyReservoir()
+{
+    return Reservoir(vec3(0.0), RESTIR_NO_LIGHT, 0.0, 0.0, 0.0, 0.0);
+}
+
+// streams in a candidate with resampling weight w, true when it replaces the pick
+bool ReservoirUpdate(inout Reservoir r, in uint light, in vec3 point, in float w, in float u)
+{
+    r.weightSum += w;
+    r.count += 1.0;
+    if (w <= 0.0 || u * r.weightSum >= w) return false;
+    r.light = light;
+    r.point = point;
+    return true;
+}
+
+// streams in another reservoir, targetPdf is the target function of its pick at this reservoir's surface
+// and misWeight the share of the pick that falls to the other reservoir among all that are merged
+bool ReservoirMerge(inout Reservoir r, in Reservoir other, in float targetPdf, in float misWeight, in float u)
+{
+    float total = r.count + other.count;
+    bool picked = other.light != RESTIR_NO_LIGHT && ReservoirUpdate(r, other.light, other.point, misWeight * targetPdf * other.weight, u);
+    r.count = total;
+    return picked;
+}
+
+void ReservoirFinalize(inout Reservoir r, in float targetPdf, in float normalization)
+{
+    r.weight = targetPdf > 0.0 && normalization > 0.0 ? r.weightSum / (normalization * targetPdf) : 0.0;
+}
+
+RayHit SurfaceHit(in RestirSurface surface)
+{
+    RayHit hit = CreateRayHit();
+    hit.position = surface.position;
+    hit.distance = surface.depth;
+    hit.normal = surface.normal;
+    hit.material = surface.material;
+    HitMaterial(hit, materials[surface.material]);
+    return hit;
+}
+
+// Direction and distance from p to the light sample and the radiance arriving along it unshadowed. For sphere
+// lights that includes the geometry term, which takes the area measure of the picks to the solid angle at p.
+bool ResolveLightSample(in uint light, in vec3 point, in vec3 p, out vec3 direction, out float tMax, out vec3 radiance)
+{
+    direction = vec3(0.0);
+    tMax = 0.0;
+    radiance = vec3(0.0);
+    if (light == RESTIR_NO_LIGHT) return false;
+
+    if ((light & RESTIR_DIRECT_LIGHT_BIT) != 0) {
+        uint index = light & ~RESTIR_DIRECT_LIGHT_BIT;
+        if (index >= uint(directLights.length())) return false;
+        DirectLight sun = directLights[index];
+        direction = normalize(sun.direction);
+        tMax = Inf;
+        radiance = sun.color * sun.intensity;
+        return true;
+    }
+
+    if (light >= primitiveTypes[PRIM_SPOT_LIGHT].count) return false;
+    // the pick moves along with its light
+    SpotLight spot = LoadSpotLight(light);
+    vec3 d = spot.position + point * spot.radius - p;
+    float distanceSq = dot(d, d);
+    tMax = sqrt(distanceSq);
+    direction = d / tMax;
+    float cosLight = -dot(point, direction);
+    radiance = spot.color * spot.intensity * (max(cosLight, 0.0) / distanceSq);
+    return cosLight > 0.0;
+}
+
+// unshadowed luminance the sample adds to the surface seen from eye, the target function of the reservoirs
+float RestirTarget(in RayHit hit, in vec3 eye, in uint light, in vec3 point)
+{
+    vec3 direction;
+    float tMax;
+    vec3 radiance;
+    if (!ResolveLightSample(light, point, hit.position + hit.normal * 0.001, direction, tMax, radiance)) return 0.0;
+    if (dot(hit.normal, direction) <= 0.0) return 0.0;
+
+    float pdf;
+    return Luminance(EvalReflection(hit, normalize(eye - hit.position), direction, pdf) * radiance);
+}
+
+// one light sample picked like SampleLight picks it, sourcePdf is in the area measure for sphere lights
+bool DrawLightCandidate(in vec3 origin, in vec3 normal, out uint light, out vec3 point, out float sourcePdf)
+{
+    light = RESTIR_NO_LIGHT;
+    point = vec3(0.0);
+    sourcePdf = 0.0;
+    uint directCount = uint(directLights.length());
+    float sphereShare = SphereLightShare();
+
+    float u = RestirRandom();
+    if (u >= sphereShare) {
+        if (directCount == 0) return false;
+        light = min(uint((u - sphereShare) / (1.0 - sphereShare) * float(directCount)), directCount - 1) | RESTIR_DIRECT_LIGHT_BIT;
+        sourcePdf = (1.0 - sphereShare) / float(directCount);
+        return true;
+    }
+
+    float selectPmf;
+    if (!SampleLightBVH(origin, normal, u / sphereShare, light, selectPmf)) return false;
+    SpotLight spot = LoadSpotLight(light);
+    vec3 direction;
+    float tMax;
+    float lightPdf;
+    if (!SampleSphereLight(spot, origin, vec2(RestirRandom(), RestirRandom()), direction, tMax, lightPdf)) return false;
+
+    point = normalize(origin + direction * tMax - spot.position);
+    float cosLight = -dot(point, direction);
+    sourcePdf = sphereShare * selectPmf * lightPdf * max(cosLight, 0.0) / (tMax * tMax);
+    return sourcePdf > 0.0;
+}
+
+bool SimilarSurface(in RestirSurface surface, in RestirSurface other, in float expectedDepth)
+{
+    return other.material != NO_MATERIAL && dot(surface.normal, other.normal) > RESTIR_NORMAL_THRESHOLD &&
+           abs(other.depth - expectedDepth) <= RESTIR_DEPTH_THRESHOLD * expectedDepth;
+}
+
+// direct light of the pixel's primary hit, the shade pass already traced its shadow ray
+vec3 ResampledLight(in uint index)
+{
+    return resampledLight[index].rgb;
+}
+
+void RestirCandidates()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (!InsideImage(pixel)) return;
+    uint index = PixelIndex(pixel);
+    RestirSeed(pixel, KERNEL_RESTIR_CANDIDATES);
+
+    // the same ray the path tracer starts with, so both see the same surface
+    Ray ray = CreateCameraRay(float(pixel.x), float(pixel.y));
+    RayHit hit = CreateRayHit();
+    bool surface = TryIntersection(ray, hit) && hit.material != NO_MATERIAL;
+    restirSurfaces[SurfaceSlot(camera.frameIndex, index)] = RestirSurface(hit.position, surface ? hit.material : NO_MATERIAL, hit.normal, hit.distance);
+
+    Reservoir r = EmptyReservoir();
+    if (surface) {
+        vec3 origin = hit.position + hit.normal * 0.001;
+        float target = 0.0;
+        for (uint i = 0; i < restirCandidates; ++i) {
+            uint light;
+            vec3 point;
+            float sourcePdf;
+            float candidateTarget = 0.0;
+            if (DrawLightCandidate(origin, hit.normal, light, point, sourcePdf)) candidateTarget = RestirTarget(hit, ray.origin, light, point);
+            float w = candidateTarget > 0.0 ? candidateTarget / sourcePdf : 0.0;
+            if (ReservoirUpdate(r, light, point, w, RestirRandom())) target = candidateTarget;
+        }
+        ReservoirFinalize(r, target, r.count);
+
+        // a blocked pick would only spread its shadow to the neighbours
+        vec3 direction;
+        float tMax;
+        vec3 radiance;
+        if (r.weight > 0.0 && ResolveLightSample(r.light, r.point, origin, direction, tMax, radiance) &&
+            Occluded(CreateRay(origin, direction), tMax)) r.weight = 0.0;
+    }
+    reservoirs[ReservoirSlot(1, index)] = r;
+}
+
+void RestirTemporal()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (!InsideImage(pixel)) return;
+    uint index = PixelIndex(pixel);
+    RestirSurface surface = restirSurfaces[SurfaceSlot(camera.frameIndex, index)];
+    if (surface.material == NO_MATERIAL) return;
+
+    // the surface's pixel in the previous frame, its final reservoir is still in the first half
+    vec2 previous;
+    if (historySize != RenderSize() || !HistoryPixel(surface.position, previous)) return;
+    ivec2 previousPixel = ivec2(round(previous));
+    if (any(lessThan(previousPixel, ivec2(0))) || any(greaterThanEqual(previousPixel, historySize))) return;
+    uint previousIndex = PixelIndex(previousPixel);
+    RestirSurface previousSurface = restirSurfaces[SurfaceSlot(camera.frameIndex + 1u, previousIndex)];
+    if (!SimilarSurface(surface, previousSurface, length(surface.position - historyPosition.xyz))) return;
+
+    RestirSeed(pixel, KERNEL_RESTIR_TEMPORAL);
+    Reservoir current = reservoirs[ReservoirSlot(1, index)];
+    Reservoir history = reservoirs[ReservoirSlot(0, previousIndex)];
+    // the history may outweigh the new candidates only so much, or it would never follow changes
+    history.count = min(history.count, float(restirHistoryLimit) * current.count);
+
+    RayHit hit = SurfaceHit(surface);
+    RayHit previousHit = SurfaceHit(previousSurface);
+    vec3 eye = camera.position.xyz;
+    // each pick's share is its own surface's target scaled by the count, seen from that frame's camera
+    float currentTarget = RestirTarget(hit, eye, current.light, current.point);
+    float currentShare = current.count * currentTarget;
+    float currentTotal = currentShare + history.count * RestirTarget(previousHit, historyPosition.xyz, current.light, current.point);
+    float historyTarget = RestirTarget(hit, eye, history.light, history.point);
+    float historyShare = history.count * RestirTarget(previousHit, historyPosition.xyz, history.light, history.point);
+    float historyTotal = historyShare + current.count * historyTarget;
+
+    Reservoir r = EmptyReservoir();
+    float target = 0.0;
+    if (ReservoirMerge(r, current, currentTarget, currentTotal > 0.0 ? currentShare / currentTotal : 0.0, RestirRandom())) target = currentTarget;
+    if (ReservoirMerge(r, history, historyTarget, historyTotal > 0.0 ? historyShare / historyTotal : 0.0, RestirRandom())) target = historyTarget;
+    ReservoirFinalize(r, target, 1.0);
+    reservoirs[ReservoirSlot(1, index)] = r;
+}
+
+// reads the second half and writes the first, so neighbours never see a reservoir that already reused theirs
+void RestirSpatial()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (!InsideImage(pixel)) return;
+    uint index = PixelIndex(pixel);
+    Reservoir current = reservoirs[ReservoirSlot(1, index)];
+    RestirSurface surface = restirSurfaces[SurfaceSlot(camera.frameIndex, index)];
+    if (surface.material == NO_MATERIAL || restirNeighbours == 0) {
+        reservoirs[ReservoirSlot(0, index)] = current;
+        return;
+    }
+
+    // the pixel itself is the first tap
+    RestirSeed(pixel, KERNEL_RESTIR_SPATIAL);
+    ivec2 size = RenderSize();
+    uint taps[RESTIR_MAX_NEIGHBOURS + 1];
+    uint tapCount = 1;
+    taps[0] = index;
+    for (uint i = 0; i < min(restirNeighbours, RESTIR_MAX_NEIGHBOURS); ++i) {
+        float radius = restirRadius * sqrt(RestirRandom());
+        float angle = 2.0 * PI * RestirRandom();
+        ivec2 other = pixel + ivec2(round(radius * vec2(cos(angle), sin(angle))));
+        if (other == pixel || any(lessThan(other, ivec2(0))) || any(greaterThanEqual(other, size))) continue;
+        uint otherIndex = PixelIndex(other);
+        if (SimilarSurface(surface, restirSurfaces[SurfaceSlot(camera.frameIndex, otherIndex)], surface.depth)) taps[tapCount++] = otherIndex;
+    }
+
+    RayHit hit = SurfaceHit(surface);
+    vec3 eye = camera.position.xyz;
+    Reservoir r = EmptyReservoir();
+    float target = 0.0;
+    for (uint i = 0; i < tapCount; ++i) {
+        Reservoir tap = reservoirs[ReservoirSlot(1, taps[i])];
+        float tapTarget = RestirTarget(hit, eye, tap.light, tap.point);
+        float share = 0.0;
+        float total = 0.0;
+        // blocked and empty picks add nothing, their weight doesn't matter
+        for (uint j = 0; j < tapCount && tap.weight > 0.0; ++j) {
+            RayHit other = j == 0 ? hit : SurfaceHit(restirSurfaces[SurfaceSlot(camera.frameIndex, taps[j])]);
+            float w = reservoirs[ReservoirSlot(1, taps[j])].count * (j == 0 ? tapTarget : RestirTarget(other, eye, tap.light, tap.point));
+            total += w;
+            if (j == i) share = w;
+        }
+        if (ReservoirMerge(r, tap, tapTarget, total > 0.0 ? share / total : 0.0, RestirRandom())) target = tapTarget;
+    }
+    ReservoirFinalize(r, target, 1.0);
+    reservoirs[ReservoirSlot(0, index)] = r;
+}
+
+void RestirShade()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    // the temporal pass of the next frame reprojects with this camera
+    if (pixel == ivec2(0)) RecordHistoryCamera();
+    if (!InsideImage(pixel)) return;
+    uint index = PixelIndex(pixel);
+
+    RestirSurface surface = restirSurfaces[SurfaceSlot(camera.frameIndex, index)];
+    Reservoir r = reservoirs[ReservoirSlot(0, index)];
+    vec3 radiance = vec3(0.0);
+    if (surface.material != NO_MATERIAL && r.weight > 0.0) {
+        RayHit hit = SurfaceHit(surface);
+        vec3 origin = hit.position + hit.normal * 0.001;
+        vec3 direction;
+        float tMax;
+        vec3 incoming;
+        if (ResolveLightSample(r.light, r.point, origin, direction, tMax, incoming) && dot(hit.normal, direction) > 0.0 &&
+            !Occluded(CreateRay(origin, direction), tMax)) {
+            float pdf;
+            radiance = EvalReflection(hit, normalize(camera.position.xyz - hit.position), direction, pdf) * incoming * r.weight;
+        } else {
+            // the next frame shouldn't reuse a pick that turned out to be blocked
+            reservoirs[ReservoirSlot(0, index)].weight = 0.0;
+        }
+    }
+    resampledLight[index] = vec4(radiance, 0.0);
+}
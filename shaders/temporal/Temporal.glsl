@@ -0,0 +1,181 @@
+// Temporal reuse, run by TemporalReuse. Every frame the reproject pass traces the primary ray through
+// each pixel center, stores its depth and the motion vector to where the hit was in the previous frame.
+// When the accumulation was restarted, e.g. by a moving camera, it also fetches the previous result
+// from there as the pixel's history. After the trace, the resolve pass clamps that history to the
+// neighbourhood of the new samples and blends them by sample count, and the commit pass writes the
+// result back as the accumulation, which then continues from it once the camera stops.
+// Included by RTNew.comp after the shading functions.
+
+#define KERNEL_TEMPORAL_REPROJECT 10
+#define KERNEL_TEMPORAL_RESOLVE 11
+#define KERNEL_TEMPORAL_COMMIT 12
+
+// samples the history may stand for, also how quickly it follows changes
+#define TEMPORAL_MAX_SAMPLES 16.0
+// history outside the neighbourhood's mean +- this many deviations is clamped
+#define TEMPORAL_CLAMP_GAMMA 1.25
+// relative depth difference above which a history sample is a disocclusion
+#define TEMPORAL_DEPTH_TOLERANCE 0.05
+
+// the camera of the previous frame, written by the commit pass. A zero size marks it as unusable.
+layout (binding = 41) buffer TemporalCameraBuf
+{
+    vec4 historyPosition;
+    vec4 historyForward;
+    vec4 historyUp;
+    ivec2 historySize;
+    float historyAspectRatio;
+    float historyFocalDistance;
+};
+// first hit distance of every pixel, two frames back to back
+layout (binding = 42) buffer TemporalDepthBuf { float temporalDepth[]; };
+// pixels from the previous to the current position of each pixel's first hit
+layout (binding = 43) buffer MotionBuf { vec2 motionVectors[]; };
+// reprojected color and the samples it stands for, then the resolved color
+layout (binding = 44) buffer HistoryBuf { vec4 temporalHistory[]; };
+
+uint TemporalPixels()
+{
+    ivec2 size = RenderSize();
+    return uint(size.x * size.y);
+}
+
+uint DepthSlot(in uint frame, in uint index)
+{
+    return (frame & 1u) * TemporalPixels() + index;
+}
+
+// where a point was in the previous frame's image, false when it was behind that camera
+bool HistoryPixel(in vec3 position, out vec2 pixel)
+{
+    vec3 forward = historyForward.xyz;
+    vec3 right = normalize(cross(forward, historyUp.xyz));
+    vec3 up = cross(right, forward);
+
+    // inverse of CreateCameraRay
+    vec3 direction = position - historyPosition.xyz;
+    float depth = dot(direction, forward);
+    if (depth <= Epsilon) return false;
+    float i = dot(direction, right) / depth;
+    float j = dot(direction, up) / depth;
+
+    pixel.x = (i / (historyFocalDistance * historyAspectRatio) + 0.5) * float(historySize.x);
+    pixel.y = (0.5 - j / historyFocalDistance) * float(historySize.y);
+    return true;
+}
+
+// history of a pixel of the previous frame, zero weight when it saw another surface
+vec4 HistoryTap(in ivec2 pixel, in float expectedDepth)
+{
+    if (any(lessThan(pixel, ivec2(0))) || any(greaterThanEqual(pixel, historySize))) return vec4(0.0);
+    uint index = PixelIndex(pixel);
+    float depth = temporalDepth[DepthSlot(camera.frameIndex + 1u, index)];
+    if (abs(depth - expectedDepth) > TEMPORAL_DEPTH_TOLERANCE * expectedDepth) return vec4(0.0);
+
+    float samples = float(pixelVariance[index].samples);
+    return vec4(imageLoad(accumulationImage, pixel).rgb, 1.0) * samples;
+}
+
+void TemporalReproject()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (!InsideImage(pixel)) return;
+    uint index = PixelIndex(pixel);
+
+    Ray ray = CreateCameraRay(float(pixel.x), float(pixel.y));
+    RayHit hit = CreateRayHit();
+    TryIntersection(ray, hit);
+    vec3 position = ray.origin + ray.direction * hit.distance;
+    temporalDepth[DepthSlot(camera.frameIndex, index)] = hit.distance;
+
+    vec2 previous;
+    bool valid = historySize == RenderSize() && HistoryPixel(position, previous);
+    motionVectors[index] = valid ? vec2(pixel) - previous : vec2(0.0);
+
+    // the accumulation still holds this pixel's history unless it was restarted
+    if (camera.accumulatedFrames > 0) return;
+
+    // bilinear over the taps that saw the same surface, weighted by their samples
+    vec4 history = vec4(0.0);
+    float weight = 0.0;
+    if (valid) {
+        float expectedDepth = length(position - historyPosition.xyz);
+        ivec2 base = ivec2(floor(previous));
+        vec2 f = previous - vec2(base);
+        for (int y = 0; y < 2; ++y) {
+            for (int x = 0; x < 2; ++x) {
+                float w = (x == 0 ? 1.0 - f.x : f.x) * (y == 0 ? 1.0 - f.y : f.y);
+                vec4 tap = HistoryTap(base + ivec2(x, y), expectedDepth);
+                history += tap * w;
+                weight += tap.w > 0.0 ? w : 0.0;
+            }
+        }
+    }
+
+    // rgb is the weighted color, w the samples it stands for
+    vec3 color = history.w > 0.0 ? history.rgb / history.w : vec3(0.0);
+    float samples = weight > 0.0 ? min(history.w / weight, TEMPORAL_MAX_SAMPLES) : 0.0;
+    temporalHistory[index] = vec4(color, samples);
+}
+
+void TemporalResolve()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (camera.accumulatedFrames > 0 || !InsideImage(pixel)) return;
+    uint index = PixelIndex(pixel);
+
+    vec4 history = temporalHistory[index];
+    vec3 current = imageLoad(accumulationImage, pixel).rgb;
+    float samples = float(pixelVariance[index].samples);
+    if (history.w <= 0.0 || samples <= 0.0) {
+        temporalHistory[index] = vec4(current, samples);
+        return;
+    }
+
+    // the new samples of the 3x3 neighbourhood bound what the history may be
+    ivec2 size = RenderSize();
+    vec3 m1 = vec3(0.0);
+    vec3 m2 = vec3(0.0);
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec3 c = imageLoad(accumulationImage, clamp(pixel + ivec2(x, y), ivec2(0), size - 1)).rgb;
+            m1 += c;
+            m2 += c * c;
+        }
+    }
+    m1 /= 9.0;
+    vec3 sigma = sqrt(max(m2 / 9.0 - m1 * m1, 0.0));
+    vec3 clamped = clamp(history.rgb, m1 - TEMPORAL_CLAMP_GAMMA * sigma, m1 + TEMPORAL_CLAMP_GAMMA * sigma);
+
+    float total = history.w + samples;
+    temporalHistory[index] = vec4(mix(clamped, current, samples / total), total);
+}
+
+// keeps the camera for the next frame's reprojection, also run by the shade pass of restir/Restir.glsl
+void RecordHistoryCamera()
+{
+    historyPosition = camera.position;
+    historyForward = camera.forward;
+    historyUp = camera.up;
+    historySize = RenderSize();
+    historyAspectRatio = camera.aspectRatio;
+    historyFocalDistance = camera.focalDistance;
+}
+
+// the resolve pass reads the neighbourhood of the accumulation, so the result is written in its own pass
+void TemporalCommit()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel == ivec2(0)) RecordHistoryCamera();
+    if (camera.accumulatedFrames > 0 || !InsideImage(pixel)) return;
+    uint index = PixelIndex(pixel);
+
+    vec4 resolved = temporalHistory[index];
+    uint samples = uint(resolved.w);
+    if (samples == 0) return;
+
+    imageStore(accumulationImage, pixel, vec4(resolved.rgb, 1.0));
+    // the variance starts over, so adaptive sampling treats the pixel as new
+    pixelVariance[index] = PixelVariance(Luminance(resolved.rgb), 0.0, samples, 1);
+    if (debugView == DEBUG_VIEW_NONE) imageStore(computeImage, pixel, DisplayColor(resolved.rgb));
+}
@@ -0,0 +1,271 @@
+// Wavefront path tracing kernels (Laine et al. 2013), the alternative to Megakernel() run by
+// WavefrontIntegrator. Every pixel owns one path slot. Generate queues the first sample of each pixel,
+// then every loop iteration runs Extend, Shade, Shadow and Advance over the ray queue of its parity.
+// Shade appends surviving paths, and paths restarted for the pixel's next sample, to the other queue,
+// so each kernel only ever sees live paths. Its direct light samples go to the shadow queue. Appends
+// bump the indirect dispatch arguments of the queue they fill, the next kernel runs exactly as many
+// groups as there are entries.
+// Included by RTNew.comp after the shading functions.
+
+#define KERNEL_MEGAKERNEL 0
+#define KERNEL_RESET 1
+#define KERNEL_GENERATE 2
+#define KERNEL_EXTEND 3
+#define KERNEL_SHADE 4
+#define KERNEL_SHADOW 5
+#define KERNEL_ADVANCE 6
+#define KERNEL_RESOLVE 7
+
+// mirrors WavefrontIntegrator::GROUP_SIZE
+#define WAVEFRONT_GROUP_SIZE 256
+
+struct PathState
+{
+    vec3 origin;
+    uint pixel;
+    vec3 direction;
+    uint sampleIndex;
+    vec3 energy;
+    uint bounce;
+    vec3 acc;
+    float bsdfPdf;
+    vec3 normal;
+    uint pad0;
+};
+
+// what Shade needs of the closest hit, the material or the light is looked up again
+struct PathHit
+{
+    vec3 normal;
+    float distance;
+    uint material;
+    uint light;
+    uint pad0;
+    uint pad1;
+};
+
+// LightSample of a shaded path, its contribution is added to the path's pixel when nothing blocks it
+struct ShadowRay
+{
+    vec3 origin;
+    float tMax;
+    vec3 direction;
+    uint path;
+    vec3 contribution;
+    uint pad0;
+};
+
+layout (binding = 28) buffer PathStateBuf { PathState paths[]; };
+layout (binding = 29) buffer PathHitBuf { PathHit pathHits[]; };
+// two queues of path indices back to back, each as long as paths
+layout (binding = 30) buffer RayQueueBuf { uint rayQueue[]; };
+layout (binding = 31) buffer ShadowQueueBuf { ShadowRay shadowQueue[]; };
+// dispatch arguments in xyz, w counts the queued entries
+layout (binding = 32) buffer QueueArgsBuf
+{
+    uvec4 rayQueueArgs[2];
+    uvec4 shadowQueueArgs;
+};
+// sum of the finished samples of every pixel this frame
+layout (binding = 33) buffer RadianceBuf { vec4 pathRadiance[]; };
+
+uint PathCapacity()
+{
+    return uint(paths.length());
+}
+
+uint CurrentQueue()
+{
+    return camera.loopIteration & 1u;
+}
+
+void QueueRay(in uint queue, in uint path)
+{
+    uint slot = atomicAdd(rayQueueArgs[queue].w, 1u);
+    rayQueue[queue * PathCapacity() + slot] = path;
+    if (slot % WAVEFRONT_GROUP_SIZE == 0) atomicAdd(rayQueueArgs[queue].x, 1u);
+}
+
+// a path queues at most one shadow ray per iteration, the queue is as long as paths
+void QueueShadowRay(in ShadowRay shadow)
+{
+    uint slot = atomicAdd(shadowQueueArgs.w, 1u);
+    shadowQueue[slot] = shadow;
+    if (slot % WAVEFRONT_GROUP_SIZE == 0) atomicAdd(shadowQueueArgs.x, 1u);
+}
+
+ivec2 PathPixel(in PathState path)
+{
+    uint width = uint(RenderSize().x);
+    return ivec2(path.pixel % width, path.pixel / width);
+}
+
+// starts the next sample of the pixel at the camera, the sampler state carries over like in Megakernel
+void StartPath(inout PathState path)
+{
+    ivec2 pixel = PathPixel(path);
+    Ray ray = CreateCameraRay(float(pixel.x), float(pixel.y));
+    path.origin = ray.origin;
+    path.direction = ray.direction;
+    path.energy = ray.energy;
+    path.bsdfPdf = ray.bsdfPdf;
+    path.normal = ray.normal;
+    path.acc = vec3(0.0);
+    path.bounce = 0;
+}
+
+Ray PathRay(in PathState path)
+{
+    Ray ray = CreateRay(path.origin, path.direction);
+    ray.energy = path.energy;
+    ray.bsdfPdf = path.bsdfPdf;
+    ray.normal = path.normal;
+    return ray;
+}
+
+// rebuilds the closest hit Extend found for the ray
+RayHit LoadHit(in Ray ray, in PathHit stored)
+{
+    RayHit hit = CreateRayHit();
+    hit.distance = stored.distance;
+    hit.position = ray.origin + ray.direction * stored.distance;
+    hit.normal = stored.normal;
+    hit.material = stored.material;
+    hit.light = stored.light;
+    if (stored.material != NO_MATERIAL) {
+        HitMaterial(hit, materials[stored.material]);
+    } else {
+        // only sphere lights are hit without a material, mirrors IntersectSpotLight
+        SpotLight light = LoadSpotLight(stored.light);
+        hit.emission = light.color * light.intensity;
+        hit.emissive = hit.emission;
+    }
+    return hit;
+}
+
+// thread index into the current ray queue, false past its end
+bool QueuedPath(out uint path)
+{
+    uint queue = CurrentQueue();
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= rayQueueArgs[queue].w) return false;
+    path = rayQueue[queue * PathCapacity() + i];
+    return true;
+}
+
+// pixel of an image-sized dispatch, false outside the image or the path buffer
+bool DispatchPixel(out ivec2 pixel, out uint index)
+{
+    ivec2 size = RenderSize();
+    pixel = ivec2(gl_GlobalInvocationID.xy);
+    index = uint(pixel.y * size.x + pixel.x);
+    return pixel.x < size.x && pixel.y < size.y && index < PathCapacity();
+}
+
+void WavefrontReset()
+{
+    if (gl_GlobalInvocationID.x != 0) return;
+    rayQueueArgs[0] = uvec4(0, 1, 1, 0);
+    rayQueueArgs[1] = uvec4(0, 1, 1, 0);
+    shadowQueueArgs = uvec4(0, 1, 1, 0);
+}
+
+void WavefrontGenerate()
+{
+    ivec2 pixel;
+    uint index;
+    if (!DispatchPixel(pixel, index)) return;
+
+    PathState path;
+    path.pixel = index;
+    path.sampleIndex = 0;
+    path.pad0 = 0;
+    StartPath(path);
+
+    paths[index] = path;
+    pathRadiance[index] = vec4(0.0);
+    if (PixelBudget(index) > 0) QueueRay(0, index);
+}
+
+void WavefrontExtend()
+{
+    uint index;
+    if (!QueuedPath(index)) return;
+
+    RayHit hit = CreateRayHit();
+    TryIntersection(PathRay(paths[index]), hit);
+    pathHits[index] = PathHit(hit.normal, hit.distance, hit.material, hit.light, 0, 0);
+}
+
+void WavefrontShade()
+{
+    uint index;
+    if (!QueuedPath(index)) return;
+
+    PathState path = paths[index];
+    // the sampler is stateless, the path's sample and bounce pick its dimensions
+    SamplerStart(uvec2(PathPixel(path)), PixelSampleBase(path.pixel) + path.sampleIndex);
+    SamplerBounce(path.bounce);
+
+    Ray ray = PathRay(path);
+    RayHit hit = LoadHit(ray, pathHits[index]);
+    if (path.bounce == 0 && path.sampleIndex == 0) WriteGBuffer(path.pixel, hit);
+    vec3 energy = ray.energy;
+    if (hit.distance < Inf) {
+        LightSample light;
+        bool resampled = path.bounce == 0 && directResampling != 0;
+        path.acc += energy * ShadeHit(ray, hit, resampled, light);
+        if (resampled) path.acc += ResampledLight(path.pixel);
+        if (light.tMax > 0.0) QueueShadowRay(ShadowRay(light.origin, light.tMax, light.direction, index, light.contribution, 0));
+    } else {
+        path.acc += energy * ShadeMiss(ray);
+    }
+    path.bounce++;
+
+    bool queued = ContinuePath(ray, path.bounce);
+    uint finishedBounces = queued ? 0 : path.bounce;
+    if (queued) {
+        path.origin = ray.origin;
+        path.direction = ray.direction;
+        path.energy = ray.energy;
+        path.bsdfPdf = ray.bsdfPdf;
+        path.normal = ray.normal;
+    } else {
+        // a pixel has a single path, nothing else touches its entry during this dispatch
+        pathRadiance[index].rgb += path.acc;
+        path.sampleIndex++;
+        queued = path.sampleIndex < PixelBudget(path.pixel);
+        if (queued) StartPath(path);
+    }
+
+    paths[index] = path;
+    if (queued) QueueRay(CurrentQueue() ^ 1u, index);
+    CountPaths(finishedBounces > 0 ? 1u : 0u, finishedBounces);
+}
+
+void WavefrontShadow()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= shadowQueueArgs.w) return;
+
+    ShadowRay shadow = shadowQueue[i];
+    if (!Occluded(CreateRay(shadow.origin, shadow.direction), shadow.tMax)) {
+        pathRadiance[shadow.path].rgb += shadow.contribution;
+    }
+}
+
+// empties the queue this iteration consumed, Shade already filled the other one
+void WavefrontAdvance()
+{
+    if (gl_GlobalInvocationID.x != 0) return;
+    rayQueueArgs[CurrentQueue()] = uvec4(0, 1, 1, 0);
+    shadowQueueArgs = uvec4(0, 1, 1, 0);
+}
+
+void WavefrontResolve()
+{
+    ivec2 pixel;
+    uint index;
+    if (!DispatchPixel(pixel, index)) return;
+    WritePixel(pixel, pathRadiance[index].rgb, PixelBudget(index));
+}
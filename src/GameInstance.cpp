@@ -4,14 +4,76 @@
 
 #include "GameInstance.hpp"
 
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
 namespace ph {
 
-void GameInstance::init() {
+void GameInstance::init(const std::string& path) {
 	m_engine.init();
 	auto renderer = new VulkanRenderer(m_engine.m_window, m_engine.m_windowExtent, "PT Demo");
 	m_engine.m_renderer = renderer;
 	m_engine.m_eventHandler = [this] (const auto& e) { handleEvent(std::move(e)); };
 
+	bool sceneFile = path.ends_with(SCENE_FILE_EXTENSION);
+	if (sceneFile) {
+		loadScene(path);
+	} else {
+		createDefaultScene();
+		m_bvh.build(spheres, boxes, spotLights, &m_pool);
+	}
+
+	m_camera = RenderCamera({0, 2, 5, 1}, 1.7, 2.2);
+	m_camera.lookAt({0, 0, -1});
+	m_yaw = -90;
+
+	/*stbi_set_flip_vertically_on_load(true);
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load("assets/panorama.exr", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);*/
+
+
+	renderer->setPushConstants(0, sizeof(RenderCamera), &m_camera);
+	m_packed.init(renderer, spheres, boxes, planes, spotLights);
+	renderer->addBuffer(5, sizeof(DirectLight) * directLights.size(), directLights.data());
+	m_lightBVH.build(spotLights);
+	renderer->addBuffer(LightBVH::NODE_BINDING, sizeof(LightBVHNode) * m_lightBVH.m_nodes.size(), m_lightBVH.m_nodes.data());
+	renderer->addBuffer(LightBVH::TRAIL_BINDING, sizeof(uint32_t) * m_lightBVH.m_trails.size(), m_lightBVH.m_trails.data());
+
+	renderer->addBuffer(6, sizeof(BVHNode) * m_bvh.m_nodes.size(), m_bvh.m_nodes.data());
+	renderer->addBuffer(7, sizeof(uint32_t) * m_bvh.m_primRefs.size(), m_bvh.m_primRefs.data());
+	m_lbvh.init(renderer, uint32_t(spheres.size() + boxes.size() + spotLights.size()));
+	renderer->addBuffer(RENDER_SETTINGS_BINDING, sizeof(RenderSettings), &m_settings);
+	renderer->addCounters(35, sizeof(PathStats), &m_pathStats);
+	m_samplerTables.generate();
+	renderer->addBuffer(SamplerTables::SOBOL_BINDING, sizeof(uint32_t) * m_samplerTables.m_sobolDirections.size(), m_samplerTables.m_sobolDirections.data());
+	renderer->addBuffer(SamplerTables::BLUE_NOISE_BINDING, sizeof(float) * m_samplerTables.m_blueNoise.size(), m_samplerTables.m_blueNoise.data());
+	m_wavefront.init(renderer, &m_camera, &m_settings, m_engine.m_windowExtent.width, m_engine.m_windowExtent.height);
+	m_adaptive.init(renderer, &m_settings, m_engine.m_windowExtent.width, m_engine.m_windowExtent.height);
+	m_temporal.init(renderer, &m_settings, m_engine.m_windowExtent.width, m_engine.m_windowExtent.height);
+	m_denoiser.init(renderer, &m_settings, m_engine.m_windowExtent.width, m_engine.m_windowExtent.height);
+	m_resampler.init(renderer, &m_settings, m_engine.m_windowExtent.width, m_engine.m_windowExtent.height);
+
+	m_grid.build(spheres, boxes, spotLights);
+	m_gridInfo = m_grid.info(m_useGrid);
+	renderer->addBuffer(23, sizeof(GridInfo), &m_gridInfo);
+	renderer->addBuffer(24, sizeof(uint32_t) * m_grid.m_cellOffsets.size(), m_grid.m_cellOffsets.data());
+	renderer->addBuffer(25, sizeof(uint32_t) * std::max<size_t>(m_grid.m_primRefs.size(), 1), m_grid.m_primRefs.empty() ? nullptr : m_grid.m_primRefs.data());
+
+	createInstances();
+	if (!sceneFile && !path.empty()) loadMesh(path);
+	m_instances.init(renderer, &m_pool);
+	// every primitive above has its material in the table by now
+	renderer->addBuffer(22, sizeof(Material) * m_materials.size(), m_materials.m_materials.data());
+
+	renderer->postInitialize();
+}
+
+void GameInstance::createDefaultScene() {
 	Material mat1{
 		.albedo = {0.0, 0.0, 0.0},
 		.metallic = 0.0,
@@ -37,37 +99,88 @@ void GameInstance::init() {
 		.ior = 0
 	};
 
-	spheres.push_back(Sphere{{-0.55, 1.55, -8.0}, 0, {0, 0, 1.0}, 1.0, mat2});
-	spheres.push_back(Sphere{{1.3, 1.2, 40.2}, 0, {1.0, 1.0, 1.0}, 0.8, mat1});
-	planes.push_back(Plane{{0, -2, 0}, 0, {0, 1, 0}, 0, {0.3, 0.3, 0.3}, 0, mat3});
+	auto material = [this](Material mat, const glm::vec3& color) {
+		mat.color = color;
+		return m_materials.add(mat);
+	};
 
-	boxes.push_back(Box({10, -1, -1}, {3, 5, 3}, {0.3, 0.4, 255}, mat1));
-	randomizeSpheres();
+	spheres.push_back(Sphere{{-0.55, 1.55, -8.0}, 1.0, material(mat2, {0, 0, 1.0})});
+	spheres.push_back(Sphere{{1.3, 1.2, 40.2}, 0.8, material(mat1, {1.0, 1.0, 1.0})});
+	planes.push_back(Plane{{0, -2, 0}, material(mat3, {0.3, 0.3, 0.3}), {0, 1, 0}, 0});
+
+	boxes.push_back(Box({10, -1, -1}, {3, 5, 3}, material(mat1, {0.3, 0.4, 255})));
+	randomizeSpheres(spheres);
 
 	//spotLights.push_back(SpotLight{{0, 1, -3.2}, 4, glm::vec3(1.0), 2.0});
 	spotLights.push_back(SpotLight{{-4, 40, -3.2}, 4, glm::vec3(1.0), 2.0});
 	directLights.push_back(DirectLight{{0, 1, 0}, 0, {1, 1, 1}, 0});
+}
 
-	m_camera = RenderCamera({0, 2, 5, 1}, 1.7, 2.2);
-	m_camera.lookAt({0, 0, -1});
-	m_yaw = -90;
+void GameInstance::loadScene(const std::string& path) {
+	using namespace std::chrono;
+	auto start = steady_clock::now();
 
-	/*stbi_set_flip_vertically_on_load(true);
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load("assets/panorama.exr", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);*/
+	SceneFile file(path);
+	const auto& scene = file.arrays();
+	// the demo edits its scene arrays, so they get their own copy instead of pointing into the mapping
+	spheres.assign(scene.spheres.begin(), scene.spheres.end());
+	planes.assign(scene.planes.begin(), scene.planes.end());
+	boxes.assign(scene.boxes.begin(), scene.boxes.end());
+	spotLights.assign(scene.spotLights.begin(), scene.spotLights.end());
+	directLights.assign(scene.directLights.begin(), scene.directLights.end());
+	m_materials.assign(scene.materials);
 
+	auto validMaterial = [&](const auto& prim) { return prim.material < m_materials.size(); };
+	if (!std::all_of(spheres.begin(), spheres.end(), validMaterial) || !std::all_of(planes.begin(), planes.end(), validMaterial)
+		|| !std::all_of(boxes.begin(), boxes.end(), validMaterial)) {
+		throw std::runtime_error("Scene file " + path + " references a missing material");
+	}
 
-	renderer->setPushConstants(0, sizeof(RenderCamera), &m_camera);
-	renderer->addBuffer(1, sizeof(Sphere) * spheres.size(), spheres.data());
-	renderer->addBuffer(2, sizeof(Plane) * planes.size(), planes.data());
-	renderer->addBuffer(3, sizeof(Box) * boxes.size(), boxes.data());
-	renderer->addBuffer(4, sizeof(SpotLight) * spotLights.size(), spotLights.data());
-	renderer->addBuffer(5, sizeof(DirectLight) * directLights.size(), directLights.data());
+	// the input code moves the first spot light and the direct light buffer can't be empty
+	if (spotLights.empty() || directLights.empty()) {
+		throw std::runtime_error("Scene file " + path + " needs at least one spot light and direct light");
+	}
 
-	renderer->postInitialize();
+	if (file.hasBVH()) {
+		m_bvh.load(scene.bvhNodes, scene.bvhPrimRefs, uint32_t(spheres.size()), uint32_t(boxes.size()), uint32_t(spotLights.size()));
+	} else {
+		m_bvh.build(spheres, boxes, spotLights, &m_pool);
+	}
+
+	auto ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+	std::cout << "Loaded " << path << ": " << spheres.size() << " spheres, " << boxes.size() << " boxes, "
+		<< (file.hasBVH() ? "prebuilt" : "rebuilt") << " BVH in " << ms << " ms" << std::endl;
+}
+
+void GameInstance::saveScene(const std::string& path) {
+	// a pending rebuild would swap in a tree built for older spheres
+	if (m_rebuildPending) return;
+
+	SceneArrays scene{
+		.spheres = spheres,
+		.planes = planes,
+		.boxes = boxes,
+		.spotLights = spotLights,
+		.directLights = directLights,
+		.materials = m_materials.m_materials,
+		.bvhNodes = m_bvh.m_nodes,
+		.bvhPrimRefs = m_bvh.m_primRefs
+	};
+	// the GPU builder leaves the CPU tree stale while it runs
+	if (m_lbvh.enabled()) {
+		scene.bvhNodes = {};
+		scene.bvhPrimRefs = {};
+	}
+
+	try {
+		writeSceneFile(path, scene);
+		std::cout << "Saved scene to " << path << std::endl;
+	} catch (const std::exception& e) {
+		std::cout << "ERROR: " << e.what() << std::endl;
+	}
 }
 
-void GameInstance::randomizeSpheres() {
+void GameInstance::randomizeSpheres(std::vector<Sphere>& out) {
 	// random sphere generation
 	auto dist = std::uniform_int_distribution<int>(10, 15);
 	auto distXZ = std::uniform_real_distribution<float>(-10.0, 10.0);
@@ -75,8 +188,11 @@ void GameInstance::randomizeSpheres() {
 	auto distMat = std::uniform_real_distribution<float>(0, 1.0);
 	int maxSp = dist(rnd);
 
+	// parameters snap to quarter steps so repeated randomizing draws from a bounded set of materials
+	auto quantized = [&] { return std::round(distMat(rnd) * 4.0f) / 4.0f; };
+
 	for (int i = 0; i < 16; ++i) {
-		float spec = distMat(rnd) * 0.8;
+		float spec = quantized() * 0.8f;
 		float refI = 1.0;
 		if (spec < 0.1) {
 			refI = 1 + spec;
@@ -84,14 +200,311 @@ void GameInstance::randomizeSpheres() {
 		}
 		Material mat = {
 			.albedo = glm::vec3{0.2, 0.2, 0.2},
-			.metallic = distMat(rnd),
-			.roughness = distMat(rnd),
+			.metallic = quantized(),
+			.roughness = quantized(),
 			.specular = spec,
 			.specTrans = 1.0,
-			.ior = refI
+			.ior = refI,
+			.color = {quantized(), quantized(), quantized()}
 		};
-		spheres.push_back({ {distXZ(rnd), distY(rnd), distXZ(rnd)}, 0, {distMat(rnd), distMat(rnd), distMat(rnd)}, distMat(rnd) + 0.3f, mat});
+		out.push_back({{distXZ(rnd), distY(rnd), distXZ(rnd)}, distMat(rnd) + 0.3f, m_materials.add(mat)});
+	}
+}
+
+void GameInstance::createInstances() {
+	Material rock{
+		.albedo = {0.2, 0.2, 0.2},
+		.metallic = 0.0,
+		.roughness = 0.9,
+		.specular = 0.0,
+		.specTrans = 0.0,
+		.ior = 0
+	};
+	auto material = [&](const glm::vec3& color) {
+		rock.color = color;
+		return m_materials.add(rock);
+	};
+	std::vector<Sphere> clusterSpheres{
+		{{0, 0.5, 0}, 0.5, material({0.8, 0.3, 0.2})},
+		{{0.9, 0.3, 0.2}, 0.3, material({0.2, 0.6, 0.3})},
+		{{-0.6, 0.25, 0.7}, 0.25, material({0.3, 0.3, 0.8})}
+	};
+	std::vector<Box> clusterBoxes{
+		Box({-0.4, 0, -1.0}, {0.8, 0.6, 0.4}, material({0.6, 0.6, 0.6}))
+	};
+	auto group = m_instances.addGroup(clusterSpheres, clusterBoxes);
+
+	auto distAngle = std::uniform_real_distribution<float>(0.0, 6.283f);
+	auto distScale = std::uniform_real_distribution<float>(0.5, 1.5);
+	for (int x = 0; x < 32; ++x) {
+		for (int z = 0; z < 32; ++z) {
+			float scale = distScale(rnd);
+			auto transform = glm::translate(glm::mat4(1.0f), glm::vec3(-96.0f + float(x) * 6.0f, -2.0f, -20.0f - float(z) * 6.0f));
+			transform = glm::rotate(transform, distAngle(rnd), glm::vec3(0, 1, 0));
+			transform = glm::scale(transform, glm::vec3(scale));
+			m_instances.addInstance(group, transform);
+		}
+	}
+}
+
+void GameInstance::loadMesh(const std::string& path) {
+	using namespace std::chrono;
+	auto start = steady_clock::now();
+
+	auto mesh = loadObj(path, &m_pool);
+	Material material{
+		.albedo = {0.2, 0.2, 0.2},
+		.metallic = 0.0,
+		.roughness = 0.6,
+		.specular = 0.0,
+		.specTrans = 0.0,
+		.ior = 0,
+		.color = {0.8, 0.8, 0.8}
+	};
+	auto group = m_instances.addMesh(mesh, m_materials.add(material), &m_pool);
+	m_instances.addInstance(group, glm::mat4(1.0f));
+
+	auto ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+	std::cout << "Loaded " << path << ": " << mesh.triangleCount() << " triangles in " << ms << " ms" << std::endl;
+}
+
+void GameInstance::rebuildSceneAsync(bool randomize) {
+	if (m_rebuildPending) return;
+
+	if (randomize) {
+		m_pendingSpheres.clear();
+		// the first sphere is part of the fixed scene, scene files may have none
+		if (!spheres.empty()) m_pendingSpheres.push_back(spheres[0]);
+		randomizeSpheres(m_pendingSpheres);
+	} else {
+		// snapshot, the live spheres keep moving while the build runs
+		m_pendingSpheres = spheres;
+	}
+
+	m_pendingSpotLights = spotLights;
+
+	m_rebuildPending = true;
+	m_pendingRandomized = randomize;
+	m_movedDuringRebuild.clear();
+	m_pool.run(m_rebuildTask, [this] {
+		m_pendingBvh.build(m_pendingSpheres, boxes, m_pendingSpotLights, &m_pool);
+	});
+}
+
+void GameInstance::finishRebuild() {
+	std::swap(m_bvh, m_pendingBvh);
+	if (m_pendingRandomized) {
+		spheres.swap(m_pendingSpheres);
+		// randomizing may have grown the table
+		m_engine.m_renderer->updateBuffer(22, sizeof(Material) * m_materials.size(), m_materials.m_materials.data());
+	} else {
+		// catch the fresh tree up with everything that moved since the snapshot
+		std::sort(m_movedDuringRebuild.begin(), m_movedDuringRebuild.end());
+		m_movedDuringRebuild.erase(std::unique(m_movedDuringRebuild.begin(), m_movedDuringRebuild.end()), m_movedDuringRebuild.end());
+		m_bvh.refit(spheres, boxes, spotLights, m_movedDuringRebuild);
+	}
+	uploadBVH();
+	if (m_useGrid) uploadGrid();
+	m_rebuildPending = false;
+}
+
+void GameInstance::animateSpheres(float dt) {
+	m_animationTime += dt * 0.1f;
+
+	// the first sphere is part of the fixed scene, the random ones bob up and down
+	m_dirtyRefs.clear();
+	for (uint32_t i = 1; i < spheres.size(); ++i) {
+		spheres[i].position.y += std::cos(m_animationTime + float(i)) * 0.02f * dt;
+		m_dirtyRefs.push_back(makePrimRef(PrimitiveType::Sphere, i));
+	}
+	if (m_dirtyRefs.empty()) return;
+
+	auto renderer = m_engine.m_renderer;
+	m_packed.updateSpheres(spheres, 1, uint32_t(spheres.size()));
+	// grids are cheap enough to rebuild from scratch every tick
+	if (m_useGrid) uploadGrid();
+	// the GPU rebuilds its tree from the sphere buffer every frame
+	if (m_lbvh.enabled()) return;
+
+	auto [first, last] = m_bvh.refit(spheres, boxes, spotLights, m_dirtyRefs);
+	if (first < last) {
+		renderer->markDirty(6, sizeof(BVHNode) * first, sizeof(BVHNode) * (last - first));
+	}
+
+	if (m_rebuildPending) {
+		m_movedDuringRebuild.insert(m_movedDuringRebuild.end(), m_dirtyRefs.begin(), m_dirtyRefs.end());
+	} else if (m_bvh.sahDegradation() > BVH_REBUILD_THRESHOLD) {
+		rebuildSceneAsync(false);
+	}
+}
+
+void GameInstance::uploadBVH() {
+	auto renderer = m_engine.m_renderer;
+	m_packed.update(spheres, boxes);
+	if (m_lbvh.enabled()) {
+		m_lbvh.resize(uint32_t(spheres.size() + boxes.size() + spotLights.size()));
+		return;
+	}
+	renderer->updateBuffer(6, sizeof(BVHNode) * m_bvh.m_nodes.size(), m_bvh.m_nodes.data());
+	renderer->updateBuffer(7, sizeof(uint32_t) * m_bvh.m_primRefs.size(), m_bvh.m_primRefs.data());
+}
+
+void GameInstance::toggleGpuBVH() {
+	m_lbvh.setEnabled(!m_lbvh.enabled());
+	if (!m_lbvh.enabled()) {
+		// refits were skipped while the GPU owned the tree
+		m_bvh.build(spheres, boxes, spotLights, &m_pool);
+		uploadBVH();
+	}
+}
+
+void GameInstance::uploadGrid() {
+	auto renderer = m_engine.m_renderer;
+	m_grid.build(spheres, boxes, spotLights);
+	m_gridInfo = m_grid.info(m_useGrid);
+	renderer->markDirty(23);
+	renderer->updateBuffer(24, sizeof(uint32_t) * m_grid.m_cellOffsets.size(), m_grid.m_cellOffsets.data());
+	renderer->updateBuffer(25, sizeof(uint32_t) * std::max<size_t>(m_grid.m_primRefs.size(), 1), m_grid.m_primRefs.empty() ? nullptr : m_grid.m_primRefs.data());
+}
+
+void GameInstance::toggleGrid() {
+	m_useGrid = !m_useGrid;
+	uploadGrid();
+}
+
+void GameInstance::updateSpotLight(uint32_t index) {
+	auto renderer = m_engine.m_renderer;
+	m_packed.updateSpotLight(spotLights, index);
+	// the trails stay valid, only the node bounds change
+	m_lightBVH.refit(spotLights);
+	renderer->updateBuffer(LightBVH::NODE_BINDING, sizeof(LightBVHNode) * m_lightBVH.m_nodes.size(), m_lightBVH.m_nodes.data());
+
+	// camera rays hit the light's sphere, so the scene structures follow it too
+	if (m_useGrid) uploadGrid();
+	if (m_lbvh.enabled()) return;
+
+	uint32_t ref = makePrimRef(PrimitiveType::SpotLight, index);
+	auto [first, last] = m_bvh.refit(spheres, boxes, spotLights, {ref});
+	if (first < last) {
+		renderer->markDirty(6, sizeof(BVHNode) * first, sizeof(BVHNode) * (last - first));
 	}
+	if (m_rebuildPending) m_movedDuringRebuild.push_back(ref);
+}
+
+void GameInstance::toggleWavefront() {
+	m_wavefront.setEnabled(!m_wavefront.enabled());
+	std::cout << "Integrator: " << (m_wavefront.enabled() ? "wavefront" : "megakernel") << std::endl;
+}
+
+void GameInstance::changePathDepth(int maxStep, int minStep) {
+	m_qualityLimits.maxDepth = uint32_t(std::clamp(int(m_qualityLimits.maxDepth) + maxStep, 1, int(MAX_PATH_DEPTH)));
+	m_settings.minDepth = uint32_t(std::clamp(int(m_settings.minDepth) + minStep, 0, int(m_qualityLimits.maxDepth)));
+	m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+	if (!m_autoQuality) applyQuality(m_qualityLimits);
+	std::cout << "Path depth: " << m_settings.minDepth << " - " << m_qualityLimits.maxDepth << std::endl;
+}
+
+void GameInstance::applyQuality(const QualityController::Quality& quality) {
+	m_camera.m_samples = quality.samples;
+	if (m_settings.maxDepth != quality.maxDepth) {
+		m_settings.maxDepth = quality.maxDepth;
+		m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+	}
+	m_engine.m_renderer->setRenderScale(quality.scale);
+}
+
+void GameInstance::toggleAutoQuality() {
+	m_autoQuality = !m_autoQuality;
+	m_qualityController.reset(m_qualityLimits);
+	applyQuality(m_qualityLimits);
+	if (m_autoQuality) std::printf("Frame budget: %.1f ms\n", m_qualityController.budget());
+	else std::cout << "Frame budget: off" << std::endl;
+}
+
+void GameInstance::cycleSampler() {
+	m_settings.sampler = SamplerType((uint32_t(m_settings.sampler) + 1) % 3);
+	m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+	std::cout << "Sampler: " << samplerName(m_settings.sampler) << std::endl;
+}
+
+void GameInstance::toggleAdaptive() {
+	m_settings.adaptive = !m_settings.adaptive;
+	m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+	std::cout << "Adaptive sampling: " << (m_settings.adaptive ? "on" : "off") << std::endl;
+}
+
+void GameInstance::changeAdaptiveBudget(float step) {
+	m_settings.adaptiveBudget = std::clamp(m_settings.adaptiveBudget + step, 0.05f, float(ADAPTIVE_MAX_SAMPLE_SCALE));
+	m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+	std::cout << "Adaptive budget: " << int(std::round(m_settings.adaptiveBudget * 100.0f)) << "%" << std::endl;
+}
+
+void GameInstance::toggleTemporal() {
+	m_settings.temporal = !m_settings.temporal;
+	m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+	// the recorded camera is stale after frames without the passes
+	if (m_settings.temporal) m_temporal.invalidate();
+	std::cout << "Temporal reuse: " << (m_settings.temporal ? "on" : "off") << std::endl;
+}
+
+void GameInstance::toggleDenoiser() {
+	m_settings.denoise = !m_settings.denoise;
+	m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+	std::cout << "Denoiser: " << (m_settings.denoise ? "on" : "off") << std::endl;
+}
+
+void GameInstance::toggleRestir() {
+	m_settings.restir = !m_settings.restir;
+	m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+	// the reservoirs and the recorded camera are stale after frames without the passes
+	if (m_settings.restir) m_temporal.invalidate();
+	std::cout << "ReSTIR: " << (m_settings.restir ? "on" : "off") << std::endl;
+}
+
+void GameInstance::cycleRestirCandidates() {
+	constexpr uint32_t steps[] = {1, 4, 16, 32};
+	auto next = std::find(std::begin(steps), std::end(steps), m_settings.restirCandidates);
+	m_settings.restirCandidates = next == std::end(steps) || next + 1 == std::end(steps) ? steps[0] : *(next + 1);
+	m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+	std::cout << "ReSTIR candidates: " << m_settings.restirCandidates << std::endl;
+}
+
+void GameInstance::cycleRestirNeighbours() {
+	constexpr uint32_t steps[] = {0, 3, 5, 8};
+	auto next = std::find(std::begin(steps), std::end(steps), m_settings.restirNeighbours);
+	m_settings.restirNeighbours = next == std::end(steps) || next + 1 == std::end(steps) ? steps[0] : *(next + 1);
+	m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+	std::cout << "ReSTIR neighbours: " << m_settings.restirNeighbours << std::endl;
+}
+
+void GameInstance::toggleSampleMap() {
+	m_settings.debugView = m_settings.debugView == DebugView::SampleMap ? DebugView::None : DebugView::SampleMap;
+	m_engine.m_renderer->markDirty(RENDER_SETTINGS_BINDING);
+}
+
+std::string GameInstance::renderStatus() const {
+	// every sample is one path, adaptive frames trace a different number per pixel
+	double samplesPerSecond = double(m_engine.m_renderer->m_frames) * m_pathStats.paths;
+
+	char stats[96];
+	std::snprintf(stats, sizeof(stats), "%s | depth %u-%u | avg path %.2f", samplerName(m_settings.sampler), m_settings.minDepth, m_settings.maxDepth, m_pathStats.averageLength());
+	std::string status = std::string(m_wavefront.enabled() ? "wavefront" : "megakernel") + " | " + std::to_string(int(samplesPerSecond / 1e6)) + " Msamples/s | " + stats;
+	if (m_settings.temporal) status += " | temporal";
+	if (m_settings.denoise) status += " | denoised";
+	if (m_settings.restir) status += " | restir " + std::to_string(m_settings.restirCandidates) + "+" + std::to_string(m_settings.restirNeighbours);
+	if (m_autoQuality) {
+		char quality[96];
+		std::snprintf(quality, sizeof(quality), " | budget %.1f ms: %d%% scale, %d spp, depth %u, gpu %.1f ms", m_qualityController.budget(),
+					  int(std::round(m_engine.m_renderer->renderExtent().width * 100.0f / float(m_engine.m_windowExtent.width))), m_camera.m_samples, m_settings.maxDepth,
+					  m_engine.m_renderer->m_gpuTime);
+		status += quality;
+	}
+	if (m_settings.adaptive) {
+		char adaptive[64];
+		std::snprintf(adaptive, sizeof(adaptive), " | adaptive %d%% budget, %.1f%% active", int(std::round(m_settings.adaptiveBudget * 100.0f)), m_adaptive.activeShare() * 100.0f);
+		status += adaptive;
+	}
+	return status;
 }
 
 int maxFPS = 300;
@@ -116,7 +529,7 @@ void GameInstance::run() {
 		diff = duration_cast<milliseconds>(now - lastTime).count();
 		if (diff >= 10) {
 			tickGame(diff * 0.01);
-			m_engine.updateTitle();
+			if (m_engine.titleDue()) m_engine.updateTitle(renderStatus());
 			lastTime = now;
 		}
 	}
@@ -134,30 +547,43 @@ void GameInstance::tickGame(float dt) {
 	if (keyState[SDL_SCANCODE_D]) m_input.moveRight();
 	if (keyState[SDL_SCANCODE_LSHIFT]) m_input.moveDown();
 	if (keyState[SDL_SCANCODE_SPACE]) m_input.moveUp();
+	bool rolled = keyState[SDL_SCANCODE_RIGHT] || keyState[SDL_SCANCODE_LEFT];
 	if (keyState[SDL_SCANCODE_RIGHT]) m_camera.roll(0.01);
 	if (keyState[SDL_SCANCODE_LEFT]) m_camera.roll(-0.01);
-	if (keyState[SDL_SCANCODE_E]) m_camera.m_samples += 1;
-	if (keyState[SDL_SCANCODE_Q]) m_camera.m_samples -= 1;
-	if (keyState[SDL_SCANCODE_R]) {
-		auto first = spheres[0];
-		spheres.clear();
-		spheres.push_back(first);
-		randomizeSpheres();
-	}
+	// with the frame budget on, the keys move the limit the controller refines up to
+	if (keyState[SDL_SCANCODE_E]) m_qualityLimits.samples += 1;
+	if (keyState[SDL_SCANCODE_Q]) m_qualityLimits.samples = std::max(m_qualityLimits.samples - 1, 1);
+	if (!m_autoQuality) m_camera.m_samples = m_qualityLimits.samples;
+	if (keyState[SDL_SCANCODE_R]) rebuildSceneAsync(true);
+
+	if (m_rebuildPending && m_rebuildTask.done()) finishRebuild();
+	if (m_animate) animateSpheres(dt);
+	m_instances.update(&m_pool);
 
 	auto mouseState = SDL_GetMouseState(nullptr, nullptr);
 	if ((mouseState & SDL_BUTTON_RMASK) != 0) {
 		spotLights[0].position += m_input.motion;
 		m_input.motion = {};
+		updateSpotLight(0);
 	}
 
 	// update aspect ratio when window size changed
 	m_camera.m_aspectRatio = float(m_engine.m_windowExtent.width) / m_engine.m_windowExtent.height;
+	m_wavefront.resize(m_engine.m_windowExtent.width, m_engine.m_windowExtent.height);
+	m_adaptive.resize(m_engine.m_windowExtent.width, m_engine.m_windowExtent.height);
+	m_temporal.resize(m_engine.m_windowExtent.width, m_engine.m_windowExtent.height);
+	m_denoiser.resize(m_engine.m_windowExtent.width, m_engine.m_windowExtent.height);
+	m_resampler.resize(m_engine.m_windowExtent.width, m_engine.m_windowExtent.height);
 	m_camera.m_time += 0.01;
 	if (m_camera.m_time > 1.0) {
 		m_camera.m_time = 0.0;
 	}
 	m_input.update(dt);
+
+	// scene changes restart the accumulation in the renderer, the view is only known here
+	bool moved = m_camera.syncView() || rolled;
+	if (moved) m_engine.m_renderer->resetAccumulation();
+	if (m_autoQuality) applyQuality(m_qualityController.update(m_engine.m_renderer->m_gpuTime, moved, m_qualityLimits));
 }
 
 void GameInstance::handleEvent(const SDL_Event& event) {
@@ -168,8 +594,32 @@ void GameInstance::handleEvent(const SDL_Event& event) {
 		if (m_pitch < -89.0f) m_pitch = -89.0f;
 
 		m_camera.updateDirection(m_yaw, m_pitch);
+		// frames can render before the next tick sees the new direction
+		m_engine.m_renderer->resetAccumulation();
 	} else if (event.type == SDL_MOUSEWHEEL) {
 		spotLights[0].intensity += event.wheel.preciseY * 2;
+		updateSpotLight(0);
+	} else if (event.type == SDL_KEYDOWN && !event.key.repeat) {
+		if (event.key.keysym.scancode == SDL_SCANCODE_T) m_animate = !m_animate;
+		if (event.key.keysym.scancode == SDL_SCANCODE_G) toggleGpuBVH();
+		if (event.key.keysym.scancode == SDL_SCANCODE_U) toggleGrid();
+		if (event.key.keysym.scancode == SDL_SCANCODE_I) toggleWavefront();
+		if (event.key.keysym.scancode == SDL_SCANCODE_N) cycleSampler();
+		if (event.key.keysym.scancode == SDL_SCANCODE_M) toggleAdaptive();
+		if (event.key.keysym.scancode == SDL_SCANCODE_PERIOD) changeAdaptiveBudget(0.05f);
+		if (event.key.keysym.scancode == SDL_SCANCODE_COMMA) changeAdaptiveBudget(-0.05f);
+		if (event.key.keysym.scancode == SDL_SCANCODE_V) toggleSampleMap();
+		if (event.key.keysym.scancode == SDL_SCANCODE_H) toggleTemporal();
+		if (event.key.keysym.scancode == SDL_SCANCODE_F) toggleDenoiser();
+		if (event.key.keysym.scancode == SDL_SCANCODE_B) toggleAutoQuality();
+		if (event.key.keysym.scancode == SDL_SCANCODE_J) toggleRestir();
+		if (event.key.keysym.scancode == SDL_SCANCODE_K) cycleRestirCandidates();
+		if (event.key.keysym.scancode == SDL_SCANCODE_L) cycleRestirNeighbours();
+		if (event.key.keysym.scancode == SDL_SCANCODE_RIGHTBRACKET) changePathDepth(1, 0);
+		if (event.key.keysym.scancode == SDL_SCANCODE_LEFTBRACKET) changePathDepth(-1, 0);
+		if (event.key.keysym.scancode == SDL_SCANCODE_EQUALS) changePathDepth(0, 1);
+		if (event.key.keysym.scancode == SDL_SCANCODE_MINUS) changePathDepth(0, -1);
+		if (event.key.keysym.scancode == SDL_SCANCODE_P) saveScene(std::string("scene") + SCENE_FILE_EXTENSION);
 	}
 }
 
@@ -0,0 +1,54 @@
+//
+// Created by Fatih on 9/16/2022.
+//
+
+#include "graphics/AdaptiveSampler.hpp"
+#include "graphics/WavefrontIntegrator.hpp"
+
+#include <algorithm>
+
+namespace ph {
+
+// mirrors PixelVariance in shaders/adaptive/Adaptive.glsl
+constexpr size_t PIXEL_VARIANCE_SIZE = 16;
+
+constexpr const char* SHADER = "shaders/RTNew.comp";
+
+void AdaptiveSampler::init(Renderer* renderer, const RenderSettings* settings, uint32_t width, uint32_t height) {
+	m_renderer = renderer;
+	m_settings = settings;
+	m_width = std::max(width, 1u);
+	m_height = std::max(height, 1u);
+
+	size_t pixels = size_t(m_width) * m_height;
+	renderer->addBuffer(VARIANCE_BINDING, PIXEL_VARIANCE_SIZE * pixels, nullptr);
+	renderer->addBuffer(BUDGET_BINDING, sizeof(uint32_t) * pixels, nullptr);
+	renderer->addCounters(STATS_BINDING, sizeof(AdaptiveStats), &m_stats);
+
+	using Kernel = WavefrontIntegrator::Kernel;
+	auto enabled = [this] { return m_settings->adaptive != 0; };
+	auto image = [this] { return m_renderer->renderGroups(); };
+
+	// the budget pass divides by the error sum of the whole image, so it needs its own dispatch
+	renderer->addComputePass({SHADER, PassStage::PostTrace, image, enabled, {uint32_t(Kernel::AdaptiveError), 8, 8}});
+	renderer->addComputePass({SHADER, PassStage::PostTrace, image, enabled, {uint32_t(Kernel::AdaptiveBudget), 8, 8}});
+}
+
+void AdaptiveSampler::resize(uint32_t width, uint32_t height) {
+	width = std::max(width, 1u);
+	height = std::max(height, 1u);
+	if (width == m_width && height == m_height) return;
+
+	m_width = width;
+	m_height = height;
+	allocate();
+}
+
+void AdaptiveSampler::allocate() {
+	size_t pixels = size_t(m_width) * m_height;
+
+	m_renderer->updateBuffer(VARIANCE_BINDING, PIXEL_VARIANCE_SIZE * pixels, nullptr);
+	m_renderer->updateBuffer(BUDGET_BINDING, sizeof(uint32_t) * pixels, nullptr);
+}
+
+} // ph
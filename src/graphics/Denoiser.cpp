@@ -0,0 +1,60 @@
+//
+// Created by Fatih on 9/18/2022.
+//
+
+#include "graphics/Denoiser.hpp"
+#include "graphics/WavefrontIntegrator.hpp"
+
+#include <algorithm>
+
+namespace ph {
+
+// mirrors GBufferTexel in shaders/denoise/Svgf.glsl
+constexpr size_t GBUFFER_TEXEL_SIZE = 32;
+// illumination and variance, two images for the a-trous levels to alternate between
+constexpr size_t FILTER_TEXEL_SIZE = 2 * 4 * sizeof(float);
+
+constexpr const char* SHADER = "shaders/RTNew.comp";
+
+void Denoiser::init(Renderer* renderer, const RenderSettings* settings, uint32_t width, uint32_t height) {
+	m_renderer = renderer;
+	m_settings = settings;
+	m_width = std::max(width, 1u);
+	m_height = std::max(height, 1u);
+
+	size_t pixels = size_t(m_width) * m_height;
+	renderer->addBuffer(GBUFFER_BINDING, GBUFFER_TEXEL_SIZE * pixels, nullptr);
+	renderer->addBuffer(FILTER_BINDING, FILTER_TEXEL_SIZE * pixels, nullptr);
+
+	using Kernel = WavefrontIntegrator::Kernel;
+	auto enabled = [this] { return m_settings->denoise != 0; };
+	auto image = [this] { return m_renderer->renderGroups(); };
+
+	renderer->addComputePass({SHADER, PassStage::PostTrace, image, enabled, {uint32_t(Kernel::DenoisePrepare), 8, 8}});
+
+	// every level is its own dispatch, the next one reads the neighbours this one wrote
+	ComputePassInfo atrous{SHADER, PassStage::PostTrace, image, enabled, {uint32_t(Kernel::DenoiseAtrous), 8, 8}};
+	atrous.iterations = [] { return ITERATIONS; };
+	renderer->addComputePass(atrous);
+
+	renderer->addComputePass({SHADER, PassStage::PostTrace, image, enabled, {uint32_t(Kernel::DenoiseResolve), 8, 8}});
+}
+
+void Denoiser::resize(uint32_t width, uint32_t height) {
+	width = std::max(width, 1u);
+	height = std::max(height, 1u);
+	if (width == m_width && height == m_height) return;
+
+	m_width = width;
+	m_height = height;
+	allocate();
+}
+
+void Denoiser::allocate() {
+	size_t pixels = size_t(m_width) * m_height;
+
+	m_renderer->updateBuffer(GBUFFER_BINDING, GBUFFER_TEXEL_SIZE * pixels, nullptr);
+	m_renderer->updateBuffer(FILTER_BINDING, FILTER_TEXEL_SIZE * pixels, nullptr);
+}
+
+} // ph
@@ -0,0 +1,62 @@
+//
+// Created by Fatih on 9/21/2022.
+//
+
+#include "graphics/LightResampler.hpp"
+#include "graphics/Reservoir.hpp"
+#include "graphics/WavefrontIntegrator.hpp"
+
+#include <algorithm>
+
+namespace ph {
+
+// mirrors RestirSurface in shaders/restir/Restir.glsl
+constexpr size_t SURFACE_SIZE = 32;
+
+constexpr const char* SHADER = "shaders/RTNew.comp";
+
+static_assert(sizeof(Reservoir) == 32);
+
+void LightResampler::init(Renderer* renderer, const RenderSettings* settings, uint32_t width, uint32_t height) {
+	m_renderer = renderer;
+	m_settings = settings;
+	m_width = std::max(width, 1u);
+	m_height = std::max(height, 1u);
+
+	size_t pixels = size_t(m_width) * m_height;
+	// the final reservoirs, read by the next frame, and the ones of the current frame back to back
+	renderer->addBuffer(RESERVOIR_BINDING, 2 * sizeof(Reservoir) * pixels, nullptr);
+	// two frames of primary hits, the temporal pass compares against the previous one
+	renderer->addBuffer(SURFACE_BINDING, 2 * SURFACE_SIZE * pixels, nullptr);
+	renderer->addBuffer(RADIANCE_BINDING, 4 * sizeof(float) * pixels, nullptr);
+
+	using Kernel = WavefrontIntegrator::Kernel;
+	auto enabled = [this] { return m_settings->restir != 0; };
+	auto image = [this] { return m_renderer->renderGroups(); };
+
+	// the path tracer reads the result at its first bounce, so all of it runs before the trace
+	renderer->addComputePass({SHADER, PassStage::PreTrace, image, enabled, {uint32_t(Kernel::RestirCandidates), 8, 8}});
+	renderer->addComputePass({SHADER, PassStage::PreTrace, image, enabled, {uint32_t(Kernel::RestirTemporal), 8, 8}});
+	renderer->addComputePass({SHADER, PassStage::PreTrace, image, enabled, {uint32_t(Kernel::RestirSpatial), 8, 8}});
+	renderer->addComputePass({SHADER, PassStage::PreTrace, image, enabled, {uint32_t(Kernel::RestirShade), 8, 8}});
+}
+
+void LightResampler::resize(uint32_t width, uint32_t height) {
+	width = std::max(width, 1u);
+	height = std::max(height, 1u);
+	if (width == m_width && height == m_height) return;
+
+	m_width = width;
+	m_height = height;
+	allocate();
+}
+
+void LightResampler::allocate() {
+	size_t pixels = size_t(m_width) * m_height;
+
+	m_renderer->updateBuffer(RESERVOIR_BINDING, 2 * sizeof(Reservoir) * pixels, nullptr);
+	m_renderer->updateBuffer(SURFACE_BINDING, 2 * SURFACE_SIZE * pixels, nullptr);
+	m_renderer->updateBuffer(RADIANCE_BINDING, 4 * sizeof(float) * pixels, nullptr);
+}
+
+} // ph
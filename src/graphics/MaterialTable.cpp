@@ -0,0 +1,42 @@
+//
+// Created by Fatih on 9/5/2022.
+//
+
+#include "graphics/MaterialTable.hpp"
+
+#include <cstring>
+
+namespace ph {
+
+// materials are plain floats, so equality and hashing work on the bytes. pad0 is compared too,
+// callers leave it zero.
+size_t MaterialTable::Hash::operator()(const Material& material) const {
+	uint32_t words[sizeof(Material) / sizeof(uint32_t)];
+	std::memcpy(words, &material, sizeof(Material));
+
+	size_t hash = 0;
+	for (auto word : words) {
+		hash = (hash ^ word) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+bool MaterialTable::Equal::operator()(const Material& a, const Material& b) const {
+	return std::memcmp(&a, &b, sizeof(Material)) == 0;
+}
+
+uint32_t MaterialTable::add(const Material& material) {
+	auto [it, inserted] = m_lookup.try_emplace(material, uint32_t(m_materials.size()));
+	if (inserted) m_materials.push_back(material);
+	return it->second;
+}
+
+void MaterialTable::assign(std::span<const Material> materials) {
+	m_materials.assign(materials.begin(), materials.end());
+	m_lookup.clear();
+	for (uint32_t i = 0; i < m_materials.size(); ++i) {
+		m_lookup.try_emplace(m_materials[i], i);
+	}
+}
+
+} // ph
@@ -0,0 +1,77 @@
+//
+// Created by Fatih on 9/7/2022.
+//
+
+#include "graphics/PackedScene.hpp"
+#include "graphics/accel/BVH.hpp"
+
+namespace ph {
+
+static_assert(sizeof(SpotLight) == sizeof(glm::vec4) * PackedScene::SPOT_LIGHT_STRIDE);
+// the packers write a sphere as position and radius, boxes and planes as two vectors
+static_assert(PackedScene::SPHERE_STRIDE == 1 && PackedScene::BOX_STRIDE == 2 && PackedScene::PLANE_STRIDE == 2);
+
+void PackedScene::init(Renderer* renderer, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes,
+					   const std::vector<Plane>& planes, const std::vector<SpotLight>& spotLights) {
+	m_renderer = renderer;
+	renderer->addPrimitiveType(uint32_t(PrimitiveType::Sphere), SPHERE_STRIDE, false);
+	renderer->addPrimitiveType(uint32_t(PrimitiveType::Box), BOX_STRIDE, false);
+	renderer->addPrimitiveType(uint32_t(PrimitiveType::Plane), PLANE_STRIDE, true);
+	renderer->addPrimitiveType(uint32_t(PrimitiveType::SpotLight), SPOT_LIGHT_STRIDE, false);
+
+	update(spheres, boxes);
+
+	m_payload.resize(planes.size() * PLANE_STRIDE);
+	m_materials.resize(planes.size());
+	for (size_t i = 0; i < planes.size(); ++i) {
+		m_payload[i * PLANE_STRIDE] = glm::vec4(planes[i].position, 0.0f);
+		m_payload[i * PLANE_STRIDE + 1] = glm::vec4(planes[i].normal, 0.0f);
+		m_materials[i] = planes[i].material;
+	}
+	renderer->setPrimitives(uint32_t(PrimitiveType::Plane), planes.size(), m_payload.data(), m_materials.data());
+
+	// lights are emissive, their material index is never read
+	m_materials.assign(spotLights.size(), 0);
+	renderer->setPrimitives(uint32_t(PrimitiveType::SpotLight), spotLights.size(), spotLights.data(), m_materials.data());
+}
+
+void PackedScene::update(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes) {
+	packSpheres(spheres);
+	m_renderer->setPrimitives(uint32_t(PrimitiveType::Sphere), spheres.size(), m_payload.data(), m_materials.data());
+	packBoxes(boxes);
+	m_renderer->setPrimitives(uint32_t(PrimitiveType::Box), boxes.size(), m_payload.data(), m_materials.data());
+}
+
+void PackedScene::updateSpheres(const std::vector<Sphere>& spheres, uint32_t first, uint32_t last) {
+	if (first >= last) return;
+	m_payload.resize((last - first) * SPHERE_STRIDE);
+	for (uint32_t i = first; i < last; ++i) {
+		m_payload[(i - first) * SPHERE_STRIDE] = glm::vec4(spheres[i].position, spheres[i].radius);
+	}
+	m_renderer->updatePrimitives(uint32_t(PrimitiveType::Sphere), first, last, m_payload.data());
+}
+
+void PackedScene::updateSpotLight(const std::vector<SpotLight>& spotLights, uint32_t index) {
+	m_renderer->updatePrimitives(uint32_t(PrimitiveType::SpotLight), index, index + 1, &spotLights[index]);
+}
+
+void PackedScene::packSpheres(const std::vector<Sphere>& spheres) {
+	m_payload.resize(spheres.size() * SPHERE_STRIDE);
+	m_materials.resize(spheres.size());
+	for (size_t i = 0; i < spheres.size(); ++i) {
+		m_payload[i * SPHERE_STRIDE] = glm::vec4(spheres[i].position, spheres[i].radius);
+		m_materials[i] = spheres[i].material;
+	}
+}
+
+void PackedScene::packBoxes(const std::vector<Box>& boxes) {
+	m_payload.resize(boxes.size() * BOX_STRIDE);
+	m_materials.resize(boxes.size());
+	for (size_t i = 0; i < boxes.size(); ++i) {
+		m_payload[i * BOX_STRIDE] = glm::vec4(boxes[i].min, 0.0f);
+		m_payload[i * BOX_STRIDE + 1] = glm::vec4(boxes[i].max, 0.0f);
+		m_materials[i] = boxes[i].material;
+	}
+}
+
+} // ph
@@ -0,0 +1,71 @@
+//
+// Created by Fatih on 9/9/2022.
+//
+
+#include "graphics/PrimitiveStream.hpp"
+#include "graphics/accel/BVH.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace ph {
+
+PrimitiveTypeRange& PrimitiveStream::range(uint32_t tag) {
+	if (tag >= MAX_PRIMITIVE_TYPES || (m_registered & (1u << tag)) == 0) {
+		throw std::runtime_error("Primitive type " + std::to_string(tag) + " isn't registered");
+	}
+	return m_info.types[tag];
+}
+
+void PrimitiveStream::addType(uint32_t tag, uint32_t stride, bool unbounded) {
+	if (tag >= MAX_PRIMITIVE_TYPES || (m_registered & (1u << tag)) != 0) {
+		throw std::runtime_error("Can't register primitive type " + std::to_string(tag));
+	}
+	m_registered |= 1u << tag;
+	if (unbounded) m_unbounded |= 1u << tag;
+	m_info.types[tag] = {0, stride, 0, 0};
+	layout();
+}
+
+void PrimitiveStream::set(uint32_t tag, size_t count, const glm::vec4* payload, const uint32_t* materials) {
+	auto& type = range(tag);
+
+	auto payloadBegin = m_payload.begin() + type.payloadOffset;
+	payloadBegin = m_payload.erase(payloadBegin, payloadBegin + size_t(type.count) * type.stride);
+	m_payload.insert(payloadBegin, payload, payload + count * type.stride);
+
+	auto materialBegin = m_materials.begin() + type.materialOffset;
+	materialBegin = m_materials.erase(materialBegin, materialBegin + type.count);
+	m_materials.insert(materialBegin, materials, materials + count);
+
+	type.count = uint32_t(count);
+	layout();
+}
+
+std::pair<size_t, size_t> PrimitiveStream::update(uint32_t tag, uint32_t first, uint32_t last, const glm::vec4* payload) {
+	const auto& type = range(tag);
+	size_t begin = type.payloadOffset + size_t(first) * type.stride;
+	size_t words = size_t(last - first) * type.stride;
+	std::copy(payload, payload + words, m_payload.begin() + begin);
+	return {begin * sizeof(glm::vec4), words * sizeof(glm::vec4)};
+}
+
+void PrimitiveStream::layout() {
+	uint32_t payloadOffset = 0, materialOffset = 0;
+	m_unboundedRefs.clear();
+	for (uint32_t tag = 0; tag < MAX_PRIMITIVE_TYPES; ++tag) {
+		auto& type = m_info.types[tag];
+		type.payloadOffset = payloadOffset;
+		type.materialOffset = materialOffset;
+		payloadOffset += type.count * type.stride;
+		materialOffset += type.count;
+
+		if (m_unbounded & (1u << tag)) {
+			for (uint32_t i = 0; i < type.count; ++i) m_unboundedRefs.push_back(makePrimRef(PrimitiveType(tag), i));
+		}
+	}
+	m_info.unboundedCount = uint32_t(m_unboundedRefs.size());
+}
+
+} // ph
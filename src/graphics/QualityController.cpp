@@ -0,0 +1,97 @@
+//
+// Created by Fatih on 9/19/2022.
+//
+
+#include "graphics/QualityController.hpp"
+#include "graphics/Renderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ph {
+
+// weight of the newest frame in the running average
+constexpr float FRAME_TIME_SMOOTHING = 0.3f;
+// the samples only grow while there is this much headroom, so they don't flip between two counts
+constexpr float REFINE_HEADROOM = 0.8f;
+
+QualityController::Quality QualityController::update(float gpuTime, bool moving, const Quality& limits) {
+	if (gpuTime > 0.0f) {
+		m_frameTime = m_frameTime > 0.0f ? m_frameTime + (gpuTime - m_frameTime) * FRAME_TIME_SMOOTHING : gpuTime;
+	}
+
+	if (moving && !m_moving) {
+		// the first frame of a motion is already cheap, waiting for a measurement would show a hitch
+		m_quality = {m_motionScale, 1, std::min(limits.maxDepth, MOTION_DEPTH)};
+		m_moving = true;
+		m_frameTime = 0.0f;
+		m_cooldown = COOLDOWN_TICKS;
+		return m_quality;
+	}
+
+	m_stillTicks = moving ? 0 : m_stillTicks + 1;
+	if (m_moving && m_stillTicks >= STILL_TICKS) {
+		m_moving = false;
+		m_quality = {1.0f, 1, limits.maxDepth};
+		m_frameTime = 0.0f;
+		m_cooldown = COOLDOWN_TICKS;
+		return m_quality;
+	}
+
+	m_quality.samples = std::min(m_quality.samples, limits.samples);
+	m_quality.maxDepth = std::min(m_quality.maxDepth, limits.maxDepth);
+	if (m_cooldown > 0) {
+		--m_cooldown;
+		return m_quality;
+	}
+	if (m_frameTime <= 0.0f) return m_quality;
+
+	Quality next = m_quality;
+	float ratio = m_budget / m_frameTime;
+	if (m_moving) {
+		// the cost of a frame grows with its pixels, so with the square of the scale
+		next.scale = fitScale(m_quality.scale * std::clamp(std::sqrt(ratio), 0.85f, 1.1f));
+		m_motionScale = next.scale;
+	} else if (ratio < 1.0f) {
+		// samples go first, then resolution, then bounces once a single sample at the smallest scale is too slow
+		if (m_quality.samples > 1) {
+			next.samples = std::max(int(float(m_quality.samples) * ratio), 1);
+		} else if (m_quality.scale > Renderer::MIN_RENDER_SCALE) {
+			next.scale = fitScale(std::min(m_quality.scale * std::max(std::sqrt(ratio), 0.85f), m_quality.scale - SCALE_STEP));
+		} else if (m_quality.maxDepth > 1) {
+			next.maxDepth = m_quality.maxDepth - 1;
+		}
+	} else if (ratio * REFINE_HEADROOM > 1.0f) {
+		// headroom gives back what was taken in the opposite order
+		if (m_quality.maxDepth < limits.maxDepth) {
+			next.maxDepth = m_quality.maxDepth + 1;
+		} else if (m_quality.scale < 1.0f) {
+			next.scale = fitScale(std::max(m_quality.scale * std::min(std::sqrt(ratio), 1.1f), m_quality.scale + SCALE_STEP));
+		} else {
+			next.samples = std::min(m_quality.samples + 1, limits.samples);
+		}
+	}
+
+	if (next.scale != m_quality.scale || next.samples != m_quality.samples || next.maxDepth != m_quality.maxDepth) {
+		m_quality = next;
+		m_frameTime = 0.0f;
+		m_cooldown = COOLDOWN_TICKS;
+	}
+	return m_quality;
+}
+
+void QualityController::reset(const Quality& limits) {
+	m_quality = limits;
+	m_motionScale = limits.scale;
+	m_frameTime = 0.0f;
+	m_stillTicks = 0;
+	m_cooldown = COOLDOWN_TICKS;
+	m_moving = false;
+}
+
+float QualityController::fitScale(float scale) const {
+	scale = std::round(scale / SCALE_STEP) * SCALE_STEP;
+	return std::clamp(scale, Renderer::MIN_RENDER_SCALE, 1.0f);
+}
+
+} // ph
@@ -75,8 +75,10 @@ void RenderEngine::tick() {
 	}
 }
 
-void RenderEngine::updateTitle() {
-	// SDL_SetWindowTitle(m_window, ("vulkan raytracer | fps: " + std::to_string(m_renderer->m_frames)).data());
+void RenderEngine::updateTitle(const std::string& status) {
+	if (m_renderer == nullptr) return;
+	m_lastTitle = std::chrono::steady_clock::now();
+	SDL_SetWindowTitle(m_window, ("vulkan raytracer | fps: " + std::to_string(m_renderer->m_frames) + " | " + status).data());
 }
 
 void RenderEngine::destroy() {
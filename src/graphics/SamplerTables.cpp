@@ -0,0 +1,189 @@
+//
+// Created by Fatih on 9/15/2022.
+//
+
+#include "graphics/SamplerTables.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+
+namespace ph {
+
+namespace {
+
+// primitive polynomials and initial direction numbers of dimensions 2 to 4 from Joe & Kuo 2008
+struct SobolPolynomial {
+	uint32_t degree;
+	uint32_t coefficients;
+	uint32_t initial[3];
+};
+
+constexpr SobolPolynomial SOBOL_POLYNOMIALS[] = {
+	{1, 0, {1}},
+	{2, 1, {1, 3}},
+	{3, 1, {1, 3, 1}}
+};
+
+constexpr uint32_t BLUE_NOISE_PIXELS = SamplerTables::BLUE_NOISE_SIZE * SamplerTables::BLUE_NOISE_SIZE;
+
+// initial pattern density and width of the energy filter
+constexpr uint32_t BLUE_NOISE_SEEDS = BLUE_NOISE_PIXELS / 10;
+constexpr float BLUE_NOISE_SIGMA = 1.5f;
+
+// Gaussian energy that the pixels of one value spread over the tile. The field is kept up to date
+// while pixels are added and removed, so finding clusters and voids is a single scan.
+class EnergyField {
+public:
+
+	EnergyField() {
+		constexpr int size = int(SamplerTables::BLUE_NOISE_SIZE);
+		for (int y = 0; y < size; ++y) {
+			for (int x = 0; x < size; ++x) {
+				// toroidal distance, the tile repeats over the screen
+				float dx = float(std::min(x, size - x));
+				float dy = float(std::min(y, size - y));
+				m_kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * BLUE_NOISE_SIGMA * BLUE_NOISE_SIGMA));
+			}
+		}
+	}
+
+	void reset(const std::vector<uint8_t>& pattern, uint8_t value) {
+		std::fill(std::begin(m_energy), std::end(m_energy), 0.0f);
+		for (uint32_t i = 0; i < BLUE_NOISE_PIXELS; ++i) {
+			if (pattern[i] == value) splat(i, 1.0f);
+		}
+	}
+
+	void splat(uint32_t pixel, float sign) {
+		constexpr uint32_t size = SamplerTables::BLUE_NOISE_SIZE;
+		uint32_t px = pixel % size, py = pixel / size;
+		for (uint32_t y = 0; y < size; ++y) {
+			const float* row = &m_kernel[((y + size - py) % size) * size];
+			for (uint32_t x = 0; x < size; ++x) {
+				m_energy[y * size + x] += sign * row[(x + size - px) % size];
+			}
+		}
+	}
+
+	// pixel holding value with the highest energy when tightest, the lowest otherwise
+	[[nodiscard]] uint32_t find(const std::vector<uint8_t>& pattern, uint8_t value, bool tightest) const {
+		uint32_t best = 0;
+		float bestEnergy = tightest ? -1.0f : std::numeric_limits<float>::max();
+		for (uint32_t i = 0; i < BLUE_NOISE_PIXELS; ++i) {
+			if (pattern[i] != value) continue;
+			if (tightest ? m_energy[i] > bestEnergy : m_energy[i] < bestEnergy) {
+				best = i;
+				bestEnergy = m_energy[i];
+			}
+		}
+		return best;
+	}
+
+private:
+
+	float m_kernel[BLUE_NOISE_PIXELS]{};
+	float m_energy[BLUE_NOISE_PIXELS]{};
+};
+
+} // namespace
+
+void SamplerTables::generate() {
+	generateSobol();
+	generateBlueNoise();
+}
+
+void SamplerTables::generateSobol() {
+	m_sobolDirections.assign(SOBOL_DIMENSIONS * SOBOL_BITS, 0);
+
+	// the first dimension is the van der Corput sequence
+	for (uint32_t i = 0; i < SOBOL_BITS; ++i) {
+		m_sobolDirections[i] = 1u << (31 - i);
+	}
+
+	for (uint32_t d = 1; d < SOBOL_DIMENSIONS; ++d) {
+		const auto& poly = SOBOL_POLYNOMIALS[d - 1];
+		uint32_t* v = &m_sobolDirections[d * SOBOL_BITS];
+		uint32_t s = poly.degree;
+
+		for (uint32_t i = 0; i < s; ++i) {
+			v[i] = poly.initial[i] << (31 - i);
+		}
+		for (uint32_t i = s; i < SOBOL_BITS; ++i) {
+			v[i] = v[i - s] ^ (v[i - s] >> s);
+			for (uint32_t k = 1; k < s; ++k) {
+				if ((poly.coefficients >> (s - 1 - k)) & 1u) v[i] ^= v[i - k];
+			}
+		}
+	}
+}
+
+void SamplerTables::generateBlueNoise() {
+	// fixed seed, the tile is the same on every run
+	std::mt19937 rng(0x5eed);
+	std::uniform_int_distribution<uint32_t> pixelDist(0, BLUE_NOISE_PIXELS - 1);
+	auto field = std::make_unique<EnergyField>();
+
+	std::vector<uint8_t> prototype(BLUE_NOISE_PIXELS, 0);
+	for (uint32_t placed = 0; placed < BLUE_NOISE_SEEDS;) {
+		uint32_t pixel = pixelDist(rng);
+		if (prototype[pixel] == 0) {
+			prototype[pixel] = 1;
+			++placed;
+		}
+	}
+
+	// moves the tightest cluster into the largest void until the pattern is stable
+	field->reset(prototype, 1);
+	while (true) {
+		uint32_t cluster = field->find(prototype, 1, true);
+		prototype[cluster] = 0;
+		field->splat(cluster, -1.0f);
+
+		uint32_t hole = field->find(prototype, 0, false);
+		prototype[hole] = 1;
+		field->splat(hole, 1.0f);
+		if (hole == cluster) break;
+	}
+
+	std::vector<uint32_t> ranks(BLUE_NOISE_PIXELS, 0);
+
+	// phase 1, the initial pixels are ranked by removing the tightest clusters
+	std::vector<uint8_t> pattern = prototype;
+	field->reset(pattern, 1);
+	for (uint32_t rank = BLUE_NOISE_SEEDS; rank-- > 0;) {
+		uint32_t cluster = field->find(pattern, 1, true);
+		pattern[cluster] = 0;
+		field->splat(cluster, -1.0f);
+		ranks[cluster] = rank;
+	}
+
+	// phase 2, filling the largest voids up to half of the tile
+	pattern = prototype;
+	field->reset(pattern, 1);
+	uint32_t rank = BLUE_NOISE_SEEDS;
+	for (; rank < BLUE_NOISE_PIXELS / 2; ++rank) {
+		uint32_t hole = field->find(pattern, 0, false);
+		pattern[hole] = 1;
+		field->splat(hole, 1.0f);
+		ranks[hole] = rank;
+	}
+
+	// phase 3, the empty pixels are the minority now and are ranked by their own clusters
+	field->reset(pattern, 0);
+	for (; rank < BLUE_NOISE_PIXELS; ++rank) {
+		uint32_t cluster = field->find(pattern, 0, true);
+		pattern[cluster] = 1;
+		field->splat(cluster, -1.0f);
+		ranks[cluster] = rank;
+	}
+
+	m_blueNoise.resize(BLUE_NOISE_PIXELS);
+	for (uint32_t i = 0; i < BLUE_NOISE_PIXELS; ++i) {
+		m_blueNoise[i] = (float(ranks[i]) + 0.5f) / float(BLUE_NOISE_PIXELS);
+	}
+}
+
+} // ph
@@ -0,0 +1,111 @@
+//
+// Created by Fatih on 9/3/2022.
+//
+
+#include "graphics/SceneFile.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace ph {
+
+static uint64_t alignUp(uint64_t value) {
+	return (value + SCENE_FILE_ALIGNMENT - 1) & ~(SCENE_FILE_ALIGNMENT - 1);
+}
+
+void writeSceneFile(const std::string& path, const SceneArrays& scene) {
+	struct Blob {
+		SceneSection type;
+		uint32_t elementSize;
+		const void* data;
+		uint64_t count;
+	};
+	const Blob blobs[] = {
+		{SceneSection::Spheres, sizeof(Sphere), scene.spheres.data(), scene.spheres.size()},
+		{SceneSection::Planes, sizeof(Plane), scene.planes.data(), scene.planes.size()},
+		{SceneSection::Boxes, sizeof(Box), scene.boxes.data(), scene.boxes.size()},
+		{SceneSection::SpotLights, sizeof(SpotLight), scene.spotLights.data(), scene.spotLights.size()},
+		{SceneSection::DirectLights, sizeof(DirectLight), scene.directLights.data(), scene.directLights.size()},
+		{SceneSection::BVHNodes, sizeof(BVHNode), scene.bvhNodes.data(), scene.bvhNodes.size()},
+		{SceneSection::BVHPrimRefs, sizeof(uint32_t), scene.bvhPrimRefs.data(), scene.bvhPrimRefs.size()},
+		{SceneSection::Materials, sizeof(Material), scene.materials.data(), scene.materials.size()},
+	};
+
+	SceneFileHeader header{SCENE_FILE_MAGIC, SCENE_FILE_VERSION, uint32_t(SceneSection::Count), 0};
+	std::vector<SceneFileSection> sections;
+	uint64_t offset = alignUp(sizeof(SceneFileHeader) + sizeof(SceneFileSection) * header.sectionCount);
+	for (const auto& blob : blobs) {
+		sections.push_back({uint32_t(blob.type), blob.elementSize, offset, blob.count});
+		offset = alignUp(offset + blob.elementSize * blob.count);
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		throw std::runtime_error("Failed to open " + path + " for writing");
+	}
+
+	const char zeros[SCENE_FILE_ALIGNMENT]{};
+	auto pad = [&](uint64_t to) {
+		auto at = uint64_t(out.tellp());
+		out.write(zeros, std::streamsize(to - at));
+	};
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(sections.data()), std::streamsize(sizeof(SceneFileSection) * sections.size()));
+	for (size_t i = 0; i < sections.size(); ++i) {
+		pad(sections[i].offset);
+		out.write(static_cast<const char*>(blobs[i].data), std::streamsize(blobs[i].elementSize * blobs[i].count));
+	}
+
+	if (!out) {
+		throw std::runtime_error("Failed to write " + path);
+	}
+}
+
+template<typename T>
+std::span<const T> SceneFile::section(const SceneFileSection& entry, const std::string& path) const {
+	if (entry.elementSize != sizeof(T)) {
+		throw std::runtime_error("Scene file " + path + " has a section of " + std::to_string(entry.elementSize) + " byte elements, expected " + std::to_string(sizeof(T)));
+	}
+	if (entry.offset % SCENE_FILE_ALIGNMENT != 0 || entry.count > (m_file.size() - std::min<uint64_t>(entry.offset, m_file.size())) / sizeof(T)) {
+		throw std::runtime_error("Scene file " + path + " has a section outside the file");
+	}
+	return {reinterpret_cast<const T*>(m_file.data() + entry.offset), size_t(entry.count)};
+}
+
+SceneFile::SceneFile(const std::string& path) : m_file(path) {
+	if (m_file.size() < sizeof(SceneFileHeader)) {
+		throw std::runtime_error(path + " is not a scene file");
+	}
+
+	auto header = reinterpret_cast<const SceneFileHeader*>(m_file.data());
+	if (header->magic != SCENE_FILE_MAGIC) {
+		throw std::runtime_error(path + " is not a scene file");
+	}
+	if (header->version != SCENE_FILE_VERSION) {
+		throw std::runtime_error("Scene file " + path + " has version " + std::to_string(header->version) + ", expected " + std::to_string(SCENE_FILE_VERSION));
+	}
+	if (sizeof(SceneFileHeader) + sizeof(SceneFileSection) * uint64_t(header->sectionCount) > m_file.size()) {
+		throw std::runtime_error("Scene file " + path + " is truncated");
+	}
+
+	// unknown sections are skipped so newer writers can add some without a version bump
+	auto sections = reinterpret_cast<const SceneFileSection*>(m_file.data() + sizeof(SceneFileHeader));
+	for (uint32_t i = 0; i < header->sectionCount; ++i) {
+		const auto& entry = sections[i];
+		switch (SceneSection(entry.type)) {
+			case SceneSection::Spheres: m_arrays.spheres = section<Sphere>(entry, path); break;
+			case SceneSection::Planes: m_arrays.planes = section<Plane>(entry, path); break;
+			case SceneSection::Boxes: m_arrays.boxes = section<Box>(entry, path); break;
+			case SceneSection::SpotLights: m_arrays.spotLights = section<SpotLight>(entry, path); break;
+			case SceneSection::DirectLights: m_arrays.directLights = section<DirectLight>(entry, path); break;
+			case SceneSection::BVHNodes: m_arrays.bvhNodes = section<BVHNode>(entry, path); break;
+			case SceneSection::BVHPrimRefs: m_arrays.bvhPrimRefs = section<uint32_t>(entry, path); break;
+			case SceneSection::Materials: m_arrays.materials = section<Material>(entry, path); break;
+			default: break;
+		}
+	}
+}
+
+} // ph
@@ -0,0 +1,60 @@
+//
+// Created by Fatih on 9/17/2022.
+//
+
+#include "graphics/TemporalReuse.hpp"
+#include "graphics/WavefrontIntegrator.hpp"
+
+#include <algorithm>
+
+namespace ph {
+
+constexpr const char* SHADER = "shaders/RTNew.comp";
+
+void TemporalReuse::init(Renderer* renderer, const RenderSettings* settings, uint32_t width, uint32_t height) {
+	m_renderer = renderer;
+	m_settings = settings;
+	m_width = std::max(width, 1u);
+	m_height = std::max(height, 1u);
+
+	size_t pixels = size_t(m_width) * m_height;
+	renderer->addBuffer(CAMERA_BINDING, sizeof(TemporalCamera), &m_camera);
+	// two frames of depth, the previous one is compared against while the current one is written
+	renderer->addBuffer(DEPTH_BINDING, 2 * sizeof(float) * pixels, nullptr);
+	renderer->addBuffer(MOTION_BINDING, 2 * sizeof(float) * pixels, nullptr);
+	renderer->addBuffer(HISTORY_BINDING, 4 * sizeof(float) * pixels, nullptr);
+
+	using Kernel = WavefrontIntegrator::Kernel;
+	auto enabled = [this] { return m_settings->temporal != 0; };
+	auto image = [this] { return m_renderer->renderGroups(); };
+
+	// the trace overwrites the accumulation the history is fetched from
+	renderer->addComputePass({SHADER, PassStage::PreTrace, image, enabled, {uint32_t(Kernel::TemporalReproject), 8, 8}});
+	renderer->addComputePass({SHADER, PassStage::PostTrace, image, enabled, {uint32_t(Kernel::TemporalResolve), 8, 8}});
+	renderer->addComputePass({SHADER, PassStage::PostTrace, image, enabled, {uint32_t(Kernel::TemporalCommit), 8, 8}});
+}
+
+void TemporalReuse::resize(uint32_t width, uint32_t height) {
+	width = std::max(width, 1u);
+	height = std::max(height, 1u);
+	if (width == m_width && height == m_height) return;
+
+	m_width = width;
+	m_height = height;
+	allocate();
+}
+
+void TemporalReuse::invalidate() {
+	m_camera = {};
+	m_renderer->markDirty(CAMERA_BINDING);
+}
+
+void TemporalReuse::allocate() {
+	size_t pixels = size_t(m_width) * m_height;
+
+	m_renderer->updateBuffer(DEPTH_BINDING, 2 * sizeof(float) * pixels, nullptr);
+	m_renderer->updateBuffer(MOTION_BINDING, 2 * sizeof(float) * pixels, nullptr);
+	m_renderer->updateBuffer(HISTORY_BINDING, 4 * sizeof(float) * pixels, nullptr);
+}
+
+} // ph
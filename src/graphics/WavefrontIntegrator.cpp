@@ -0,0 +1,102 @@
+//
+// Created by Fatih on 9/13/2022.
+//
+
+#include "graphics/WavefrontIntegrator.hpp"
+
+#include <algorithm>
+
+namespace ph {
+
+// mirror PathState, PathHit and ShadowRay in shaders/wavefront/Kernels.glsl
+constexpr size_t PATH_STATE_SIZE = 80;
+constexpr size_t PATH_HIT_SIZE = 32;
+constexpr size_t SHADOW_RAY_SIZE = 48;
+// two ray queues and the shadow queue, uvec4 each
+constexpr size_t QUEUE_ARGS_SIZE = 3 * 4 * sizeof(uint32_t);
+constexpr uint32_t SHADOW_ARGS_OFFSET = 2 * 4 * sizeof(uint32_t);
+
+constexpr const char* SHADER = "shaders/RTNew.comp";
+
+void WavefrontIntegrator::init(Renderer* renderer, const RenderCamera* camera, const RenderSettings* settings, uint32_t width, uint32_t height) {
+	m_renderer = renderer;
+	m_camera = camera;
+	m_settings = settings;
+	m_width = std::max(width, 1u);
+	m_height = std::max(height, 1u);
+
+	renderer->addBuffer(PATH_BINDING, PATH_STATE_SIZE, nullptr);
+	renderer->addBuffer(HIT_BINDING, PATH_HIT_SIZE, nullptr);
+	renderer->addBuffer(RAY_QUEUE_BINDING, 2 * sizeof(uint32_t), nullptr);
+	renderer->addBuffer(SHADOW_QUEUE_BINDING, SHADOW_RAY_SIZE, nullptr);
+	renderer->addBuffer(QUEUE_ARGS_BINDING, QUEUE_ARGS_SIZE, nullptr);
+	renderer->addBuffer(RADIANCE_BINDING, 4 * sizeof(float), nullptr);
+
+	auto enabled = [this] { return m_enabled; };
+	auto single = [] { return std::array<uint32_t, 3>{1, 1, 1}; };
+	auto image = [this] { return m_renderer->renderGroups(); };
+	auto kernel = [](Kernel kernel, uint32_t sizeX, uint32_t sizeY) {
+		return std::vector<uint32_t>{uint32_t(kernel), sizeX, sizeY};
+	};
+	auto rayQueue = [](uint32_t iteration) { return (iteration & 1) * 4 * uint32_t(sizeof(uint32_t)); };
+
+	renderer->addComputePass({SHADER, PassStage::Trace, single, enabled, kernel(Kernel::Reset, 1, 1)});
+	renderer->addComputePass({SHADER, PassStage::Trace, image, enabled, kernel(Kernel::Generate, 8, 8)});
+
+	// one bounce of every queued path per iteration
+	ComputePassInfo extend{SHADER, PassStage::Trace, {}, enabled, kernel(Kernel::Extend, GROUP_SIZE, 1)};
+	extend.loopLength = 4;
+	extend.iterations = [this] { return iterations(); };
+	extend.indirectBinding = QUEUE_ARGS_BINDING;
+	extend.indirectOffset = rayQueue;
+	renderer->addComputePass(extend);
+
+	ComputePassInfo shade{SHADER, PassStage::Trace, {}, enabled, kernel(Kernel::Shade, GROUP_SIZE, 1)};
+	shade.indirectBinding = QUEUE_ARGS_BINDING;
+	shade.indirectOffset = rayQueue;
+	renderer->addComputePass(shade);
+
+	ComputePassInfo shadow{SHADER, PassStage::Trace, {}, enabled, kernel(Kernel::Shadow, GROUP_SIZE, 1)};
+	shadow.indirectBinding = QUEUE_ARGS_BINDING;
+	shadow.indirectOffset = [](uint32_t) { return SHADOW_ARGS_OFFSET; };
+	renderer->addComputePass(shadow);
+
+	renderer->addComputePass({SHADER, PassStage::Trace, single, enabled, kernel(Kernel::Advance, 1, 1)});
+
+	renderer->addComputePass({SHADER, PassStage::Trace, image, enabled, kernel(Kernel::Resolve, 8, 8)});
+}
+
+void WavefrontIntegrator::resize(uint32_t width, uint32_t height) {
+	width = std::max(width, 1u);
+	height = std::max(height, 1u);
+	if (width == m_width && height == m_height) return;
+
+	m_width = width;
+	m_height = height;
+	if (m_enabled) allocate();
+}
+
+void WavefrontIntegrator::setEnabled(bool enabled) {
+	m_enabled = enabled;
+	allocate();
+	// the first wavefront frame shouldn't blend with megakernel history or the other way around
+	m_renderer->resetAccumulation();
+}
+
+void WavefrontIntegrator::allocate() {
+	size_t paths = m_enabled ? size_t(m_width) * m_height : 1;
+
+	m_renderer->updateBuffer(PATH_BINDING, PATH_STATE_SIZE * paths, nullptr);
+	m_renderer->updateBuffer(HIT_BINDING, PATH_HIT_SIZE * paths, nullptr);
+	m_renderer->updateBuffer(RAY_QUEUE_BINDING, 2 * sizeof(uint32_t) * paths, nullptr);
+	m_renderer->updateBuffer(SHADOW_QUEUE_BINDING, SHADOW_RAY_SIZE * paths, nullptr);
+	m_renderer->updateBuffer(RADIANCE_BINDING, 4 * sizeof(float) * paths, nullptr);
+}
+
+uint32_t WavefrontIntegrator::iterations() const {
+	uint32_t samples = uint32_t(std::max(m_camera->m_samples, 1));
+	if (m_settings->adaptive) samples *= ADAPTIVE_MAX_SAMPLE_SCALE;
+	return samples * std::max(m_settings->maxDepth, 1u);
+}
+
+} // ph
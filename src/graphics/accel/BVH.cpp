@@ -0,0 +1,694 @@
+//
+// Created by Fatih on 8/20/2022.
+//
+
+#include "graphics/accel/BVH.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+
+namespace ph {
+
+constexpr float NO_HIT = std::numeric_limits<float>::max();
+
+static uint32_t expandBits(uint32_t v) {
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+// 30-bit Morton code of a point normalized to [0, 1]^3
+static uint32_t mortonCode(const glm::vec3& p) {
+	auto x = uint32_t(std::clamp(p.x * 1024.0f, 0.0f, 1023.0f));
+	auto y = uint32_t(std::clamp(p.y * 1024.0f, 0.0f, 1023.0f));
+	auto z = uint32_t(std::clamp(p.z * 1024.0f, 0.0f, 1023.0f));
+	return (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+}
+
+void BVH::SplitBins::merge(const SplitBins& other) {
+	for (int a = 0; a < 3; ++a) {
+		for (uint32_t i = 0; i < BIN_COUNT; ++i) {
+			bounds[a][i].grow(other.bounds[a][i]);
+			counts[a][i] += other.counts[a][i];
+		}
+	}
+}
+
+void BVH::forChunks(BuildContext& ctx, uint32_t count, uint32_t chunkCount, const std::function<void(uint32_t, uint32_t, uint32_t)>& func) {
+	uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	auto runChunk = [&](uint32_t chunk) {
+		uint32_t begin = std::min(count, chunk * chunkSize);
+		func(chunk, begin, std::min(count, begin + chunkSize));
+	};
+
+	if (ctx.pool == nullptr || chunkCount == 1) {
+		for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) runChunk(chunk);
+		return;
+	}
+	ctx.pool->parallelFor(0, chunkCount, 1, [&](uint32_t first, uint32_t last) {
+		for (uint32_t chunk = first; chunk < last; ++chunk) runChunk(chunk);
+	});
+}
+
+void BVH::build(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, const std::vector<SpotLight>& spotLights, ThreadPool* pool) {
+	BuildContext ctx;
+	ctx.pool = pool;
+
+	auto sphereCount = uint32_t(spheres.size());
+	auto boxCount = uint32_t(boxes.size());
+	auto refCount = uint32_t(spheres.size() + boxes.size() + spotLights.size());
+	uint32_t chunkCount = pool ? pool->threadCount() * 4 : 1;
+
+	m_sphereCount = sphereCount;
+	m_boxCount = boxCount;
+	m_buildRefs.resize(refCount);
+	forChunks(ctx, refCount, chunkCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			auto ref = i < sphereCount ? makePrimRef(PrimitiveType::Sphere, i)
+				: i < sphereCount + boxCount ? makePrimRef(PrimitiveType::Box, i - sphereCount)
+				: makePrimRef(PrimitiveType::SpotLight, i - sphereCount - boxCount);
+			auto bounds = primitiveBounds(ref, spheres, boxes, spotLights);
+			m_buildRefs[i] = {bounds, bounds.center(), ref};
+		}
+	});
+
+	buildFromRefs(ctx);
+}
+
+void BVH::build(const std::vector<AABB>& bounds, ThreadPool* pool) {
+	BuildContext ctx;
+	ctx.pool = pool;
+
+	auto refCount = uint32_t(bounds.size());
+	uint32_t chunkCount = pool ? pool->threadCount() * 4 : 1;
+
+	m_sphereCount = refCount;
+	m_boxCount = 0;
+	m_buildRefs.resize(refCount);
+	forChunks(ctx, refCount, chunkCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			m_buildRefs[i] = {bounds[i], bounds[i].center(), i};
+		}
+	});
+
+	buildFromRefs(ctx);
+}
+
+void BVH::buildFromRefs(BuildContext& ctx) {
+	auto refCount = uint32_t(m_buildRefs.size());
+	uint32_t chunkCount = ctx.pool ? ctx.pool->threadCount() * 4 : 1;
+
+	if (m_buildRefs.empty()) {
+		// inverted bounds, rays never enter an empty tree
+		AABB empty;
+		m_nodes.assign(1, {empty.min, 0, empty.max, 0});
+		m_primRefs.clear();
+		m_parents.assign(1, 0);
+		m_leafOf.clear();
+		m_rootArea = m_sahCost = m_buildSahCost = 0.0f;
+		return;
+	}
+
+	sortByMortonCode(ctx);
+	// parallel partitions scatter through here, each node only touches its own range
+	m_scratchRefs.resize(refCount);
+
+	m_nodes.resize(refCount * 2);
+	m_nodes[0] = {{}, 0, {}, refCount};
+	ctx.nodesUsed = 1;
+
+	updateBounds(ctx, 0);
+	subdivide(ctx, 0, 0);
+	if (ctx.pool) ctx.pool->wait(ctx.group);
+
+	m_nodes.resize(ctx.nodesUsed);
+	m_nodes.shrink_to_fit();
+
+	m_primRefs.resize(refCount);
+	forChunks(ctx, refCount, chunkCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			m_primRefs[i] = m_buildRefs[i].ref;
+		}
+	});
+	m_scratchRefs.clear();
+	m_scratchRefs.shrink_to_fit();
+
+	buildRefitData(ctx);
+}
+
+void BVH::load(std::span<const BVHNode> nodes, std::span<const uint32_t> primRefs, uint32_t sphereCount, uint32_t boxCount, uint32_t spotLightCount) {
+	// refit indexes its bookkeeping by primitive, so every sphere, box and spot light has to be referenced once
+	if (nodes.empty() || primRefs.size() != uint64_t(sphereCount) + boxCount + spotLightCount) {
+		throw std::runtime_error("Prebuilt BVH doesn't match the scene");
+	}
+	if (primRefs.empty()) {
+		// the stored root of an empty tree looks like an inner node, so it gets the one buildFromRefs makes
+		AABB empty;
+		m_nodes.assign(1, {empty.min, 0, empty.max, 0});
+		m_primRefs.clear();
+		m_sphereCount = sphereCount;
+		m_boxCount = boxCount;
+		m_parents.assign(1, 0);
+		m_leafOf.clear();
+		m_rootArea = m_sahCost = m_buildSahCost = 0.0f;
+		return;
+	}
+	for (uint32_t i = 0; i < nodes.size(); ++i) {
+		const auto& node = nodes[i];
+		// children after their parent rule out cycles
+		bool inRange = node.isLeaf()
+			? uint64_t(node.leftFirst) + node.count <= primRefs.size()
+			: node.leftFirst > i && uint64_t(node.leftFirst) + 1 < nodes.size();
+		if (!inRange) {
+			throw std::runtime_error("Prebuilt BVH node references data out of range");
+		}
+	}
+	for (auto ref : primRefs) {
+		auto type = primRefType(ref);
+		bool valid = (type == PrimitiveType::Sphere && primRefIndex(ref) < sphereCount) || (type == PrimitiveType::Box && primRefIndex(ref) < boxCount)
+			|| (type == PrimitiveType::SpotLight && primRefIndex(ref) < spotLightCount);
+		if (!valid) {
+			throw std::runtime_error("Prebuilt BVH references a missing primitive");
+		}
+	}
+
+	// Walk the tree: the traversal stacks hold MAX_DEPTH entries, refit follows a single parent per node
+	// and a single leaf per primitive, so every node has to be reached once and every primitive covered once.
+	std::vector<uint8_t> nodeSeen(nodes.size(), 0);
+	std::vector<uint8_t> primSeen(primRefs.size(), 0);
+	std::vector<std::pair<uint32_t, uint32_t>> pending{{0, 0}};
+	while (!pending.empty()) {
+		auto [index, depth] = pending.back();
+		pending.pop_back();
+		if (depth > MAX_DEPTH) {
+			throw std::runtime_error("Prebuilt BVH is deeper than the traversal supports");
+		}
+		if (nodeSeen[index]++) {
+			throw std::runtime_error("Prebuilt BVH node has more than one parent");
+		}
+
+		const auto& node = nodes[index];
+		if (!node.isLeaf()) {
+			pending.emplace_back(node.leftFirst, depth + 1);
+			pending.emplace_back(node.leftFirst + 1, depth + 1);
+			continue;
+		}
+		for (uint32_t i = 0; i < node.count; ++i) {
+			auto ref = primRefs[node.leftFirst + i];
+			auto type = primRefType(ref);
+			uint32_t slot = primRefIndex(ref) + (type == PrimitiveType::Box ? sphereCount : type == PrimitiveType::SpotLight ? sphereCount + boxCount : 0);
+			if (primSeen[slot]++) {
+				throw std::runtime_error("Prebuilt BVH references a primitive more than once");
+			}
+		}
+	}
+	if (std::find(nodeSeen.begin(), nodeSeen.end(), 0) != nodeSeen.end() || std::find(primSeen.begin(), primSeen.end(), 0) != primSeen.end()) {
+		throw std::runtime_error("Prebuilt BVH doesn't cover every node and primitive");
+	}
+
+	m_nodes.assign(nodes.begin(), nodes.end());
+	m_primRefs.assign(primRefs.begin(), primRefs.end());
+	m_sphereCount = sphereCount;
+	m_boxCount = boxCount;
+
+	BuildContext ctx;
+	buildRefitData(ctx);
+}
+
+void BVH::buildRefitData(BuildContext& ctx) {
+	auto count = uint32_t(m_nodes.size());
+	uint32_t chunkCount = ctx.pool ? ctx.pool->threadCount() * 4 : 1;
+
+	m_parents.resize(count);
+	m_leafOf.resize(m_primRefs.size());
+	m_parents[0] = 0;
+	forChunks(ctx, count, chunkCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			const auto& node = m_nodes[i];
+			if (node.isLeaf()) {
+				for (uint32_t j = 0; j < node.count; ++j) m_leafOf[refSlot(m_primRefs[node.leftFirst + j])] = i;
+			} else {
+				m_parents[node.leftFirst] = i;
+				m_parents[node.leftFirst + 1] = i;
+			}
+		}
+	});
+
+	m_rootArea = AABB{m_nodes[0].min, m_nodes[0].max}.area();
+	m_sahCost = m_buildSahCost = sahCost();
+}
+
+float BVH::nodeCostWeight(const BVHNode& node) const {
+	return node.isLeaf() ? INTERSECTION_COST * float(node.count) : TRAVERSAL_COST;
+}
+
+std::pair<uint32_t, uint32_t> BVH::refit(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, const std::vector<SpotLight>& spotLights,
+										 const std::vector<uint32_t>& dirtyRefs) {
+	uint32_t first = ~0u, last = 0;
+
+	for (auto ref : dirtyRefs) {
+		uint32_t slot = refSlot(ref);
+		if (slot >= m_leafOf.size()) continue;
+
+		uint32_t index = m_leafOf[slot];
+		while (true) {
+			auto& node = m_nodes[index];
+			AABB bounds;
+			if (node.isLeaf()) {
+				for (uint32_t i = 0; i < node.count; ++i) bounds.grow(primitiveBounds(m_primRefs[node.leftFirst + i], spheres, boxes, spotLights));
+			} else {
+				const auto& left = m_nodes[node.leftFirst];
+				const auto& right = m_nodes[node.leftFirst + 1];
+				bounds.grow(AABB{left.min, left.max});
+				bounds.grow(AABB{right.min, right.max});
+			}
+
+			// ancestors only change if this node did
+			if (bounds.min == node.min && bounds.max == node.max) break;
+
+			if (m_rootArea > 0.0f) {
+				m_sahCost += nodeCostWeight(node) * (bounds.area() - AABB{node.min, node.max}.area()) / m_rootArea;
+			}
+			node.min = bounds.min;
+			node.max = bounds.max;
+			first = std::min(first, index);
+			last = std::max(last, index + 1);
+
+			if (index == 0) break;
+			index = m_parents[index];
+		}
+	}
+
+	return first < last ? std::make_pair(first, last) : std::make_pair(0u, 0u);
+}
+
+void BVH::sortByMortonCode(BuildContext& ctx) {
+	// spatially sorted references make every later partition pass touch coherent memory
+	constexpr uint32_t RADIX_BITS = 10;
+	constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+
+	auto count = uint32_t(m_buildRefs.size());
+	uint32_t chunkCount = ctx.pool ? ctx.pool->threadCount() * 4 : 1;
+
+	AABB centroidBounds;
+	std::mutex boundsMutex;
+	forChunks(ctx, count, chunkCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+		AABB local;
+		for (uint32_t i = begin; i < end; ++i) local.grow(m_buildRefs[i].centroid);
+		std::lock_guard lock(boundsMutex);
+		centroidBounds.grow(local);
+	});
+
+	glm::vec3 extent = glm::max(centroidBounds.max - centroidBounds.min, glm::vec3(1e-6f));
+	std::vector<uint32_t> keys(count), values(count), keysTmp(count), valuesTmp(count);
+	forChunks(ctx, count, chunkCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			keys[i] = mortonCode((m_buildRefs[i].centroid - centroidBounds.min) / extent);
+			values[i] = i;
+		}
+	});
+
+	// LSD radix sort, every chunk histograms and scatters its own slice so the order stays stable
+	std::vector<uint32_t> histograms(chunkCount * RADIX_SIZE);
+	for (uint32_t shift = 0; shift < 30; shift += RADIX_BITS) {
+		std::fill(histograms.begin(), histograms.end(), 0);
+		forChunks(ctx, count, chunkCount, [&](uint32_t chunk, uint32_t begin, uint32_t end) {
+			uint32_t* hist = &histograms[chunk * RADIX_SIZE];
+			for (uint32_t i = begin; i < end; ++i) hist[(keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+		});
+
+		uint32_t sum = 0;
+		for (uint32_t digit = 0; digit < RADIX_SIZE; ++digit) {
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+				uint32_t c = histograms[chunk * RADIX_SIZE + digit];
+				histograms[chunk * RADIX_SIZE + digit] = sum;
+				sum += c;
+			}
+		}
+
+		forChunks(ctx, count, chunkCount, [&](uint32_t chunk, uint32_t begin, uint32_t end) {
+			uint32_t* offsets = &histograms[chunk * RADIX_SIZE];
+			for (uint32_t i = begin; i < end; ++i) {
+				uint32_t dst = offsets[(keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+				keysTmp[dst] = keys[i];
+				valuesTmp[dst] = values[i];
+			}
+		});
+		keys.swap(keysTmp);
+		values.swap(valuesTmp);
+	}
+
+	m_scratchRefs.resize(count);
+	forChunks(ctx, count, chunkCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) m_scratchRefs[i] = m_buildRefs[values[i]];
+	});
+	m_buildRefs.swap(m_scratchRefs);
+}
+
+void BVH::updateBounds(BuildContext& ctx, uint32_t nodeIndex) {
+	auto& node = m_nodes[nodeIndex];
+	AABB bounds;
+	if (ctx.pool && node.count >= PARALLEL_SPLIT_THRESHOLD) {
+		std::mutex boundsMutex;
+		forChunks(ctx, node.count, ctx.pool->threadCount() * 4, [&](uint32_t, uint32_t begin, uint32_t end) {
+			AABB local;
+			for (uint32_t i = begin; i < end; ++i) local.grow(m_buildRefs[node.leftFirst + i].bounds);
+			std::lock_guard lock(boundsMutex);
+			bounds.grow(local);
+		});
+	} else {
+		for (uint32_t i = 0; i < node.count; ++i) {
+			bounds.grow(m_buildRefs[node.leftFirst + i].bounds);
+		}
+	}
+	node.min = bounds.min;
+	node.max = bounds.max;
+}
+
+float BVH::findBestSplit(BuildContext& ctx, const BVHNode& node, int& axis, float& splitPos) {
+	bool parallel = ctx.pool && node.count >= PARALLEL_SPLIT_THRESHOLD;
+	uint32_t chunkCount = parallel ? ctx.pool->threadCount() * 4 : 1;
+	std::mutex mergeMutex;
+
+	AABB centroidBounds;
+	forChunks(ctx, node.count, chunkCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+		AABB local;
+		for (uint32_t i = begin; i < end; ++i) local.grow(m_buildRefs[node.leftFirst + i].centroid);
+		std::lock_guard lock(mergeMutex);
+		centroidBounds.grow(local);
+	});
+
+	glm::vec3 lo = centroidBounds.min;
+	glm::vec3 hi = centroidBounds.max;
+	glm::vec3 scale;
+	for (int a = 0; a < 3; ++a) {
+		scale[a] = lo[a] == hi[a] ? 0.0f : float(BIN_COUNT) / (hi[a] - lo[a]);
+	}
+
+	SplitBins bins;
+	forChunks(ctx, node.count, chunkCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+		SplitBins local;
+		for (uint32_t i = begin; i < end; ++i) {
+			const auto& ref = m_buildRefs[node.leftFirst + i];
+			for (int a = 0; a < 3; ++a) {
+				auto bin = std::min(BIN_COUNT - 1, uint32_t((ref.centroid[a] - lo[a]) * scale[a]));
+				local.counts[a][bin]++;
+				local.bounds[a][bin].grow(ref.bounds);
+			}
+		}
+		std::lock_guard lock(mergeMutex);
+		bins.merge(local);
+	});
+
+	float bestCost = NO_HIT;
+	for (int a = 0; a < 3; ++a) {
+		if (lo[a] == hi[a]) continue;
+
+		// sweep from both sides to get the cost of every bin boundary
+		float leftArea[BIN_COUNT - 1], rightArea[BIN_COUNT - 1];
+		uint32_t leftCount[BIN_COUNT - 1], rightCount[BIN_COUNT - 1];
+		AABB leftBox, rightBox;
+		uint32_t leftSum = 0, rightSum = 0;
+		for (uint32_t i = 0; i < BIN_COUNT - 1; ++i) {
+			leftSum += bins.counts[a][i];
+			leftCount[i] = leftSum;
+			leftBox.grow(bins.bounds[a][i]);
+			leftArea[i] = leftBox.area();
+
+			rightSum += bins.counts[a][BIN_COUNT - 1 - i];
+			rightCount[BIN_COUNT - 2 - i] = rightSum;
+			rightBox.grow(bins.bounds[a][BIN_COUNT - 1 - i]);
+			rightArea[BIN_COUNT - 2 - i] = rightBox.area();
+		}
+
+		float binWidth = (hi[a] - lo[a]) / float(BIN_COUNT);
+		for (uint32_t i = 0; i < BIN_COUNT - 1; ++i) {
+			if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+
+			float cost = float(leftCount[i]) * leftArea[i] + float(rightCount[i]) * rightArea[i];
+			if (cost < bestCost) {
+				bestCost = cost;
+				axis = a;
+				splitPos = lo[a] + binWidth * float(i + 1);
+			}
+		}
+	}
+	return bestCost;
+}
+
+uint32_t BVH::partition(BuildContext& ctx, uint32_t first, uint32_t count, int axis, float splitPos) {
+	auto isLeft = [&](const BuildRef& ref) { return ref.centroid[axis] < splitPos; };
+
+	if (!ctx.pool || count < PARALLEL_SPLIT_THRESHOLD) {
+		auto it = std::partition(m_buildRefs.begin() + first, m_buildRefs.begin() + first + count, isLeft);
+		return uint32_t(it - m_buildRefs.begin());
+	}
+
+	// count per chunk, prefix sum, then scatter both sides into the scratch buffer and copy back
+	uint32_t chunkCount = ctx.pool->threadCount() * 4;
+	std::vector<uint32_t> leftCounts(chunkCount, 0);
+	forChunks(ctx, count, chunkCount, [&](uint32_t chunk, uint32_t begin, uint32_t end) {
+		uint32_t n = 0;
+		for (uint32_t i = begin; i < end; ++i) n += isLeft(m_buildRefs[first + i]) ? 1 : 0;
+		leftCounts[chunk] = n;
+	});
+
+	std::vector<uint32_t> leftOffsets(chunkCount), rightOffsets(chunkCount);
+	uint32_t totalLeft = 0;
+	for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+		leftOffsets[chunk] = totalLeft;
+		totalLeft += leftCounts[chunk];
+	}
+	uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+		uint32_t begin = std::min(count, chunk * chunkSize);
+		rightOffsets[chunk] = totalLeft + (begin - leftOffsets[chunk]);
+	}
+
+	forChunks(ctx, count, chunkCount, [&](uint32_t chunk, uint32_t begin, uint32_t end) {
+		uint32_t left = first + leftOffsets[chunk];
+		uint32_t right = first + rightOffsets[chunk];
+		for (uint32_t i = begin; i < end; ++i) {
+			const auto& ref = m_buildRefs[first + i];
+			m_scratchRefs[isLeft(ref) ? left++ : right++] = ref;
+		}
+	});
+	forChunks(ctx, count, chunkCount, [&](uint32_t, uint32_t begin, uint32_t end) {
+		std::copy(m_scratchRefs.begin() + first + begin, m_scratchRefs.begin() + first + end, m_buildRefs.begin() + first + begin);
+	});
+	return first + totalLeft;
+}
+
+void BVH::subdivide(BuildContext& ctx, uint32_t nodeIndex, uint32_t depth) {
+	auto node = m_nodes[nodeIndex];
+	if (node.count <= 1 || depth >= MAX_DEPTH) return;
+
+	int axis = -1;
+	float splitPos = 0;
+	float splitCost = findBestSplit(ctx, node, axis, splitPos);
+
+	AABB bounds{node.min, node.max};
+	float leafCost = INTERSECTION_COST * float(node.count);
+	splitCost = TRAVERSAL_COST + INTERSECTION_COST * splitCost / bounds.area();
+
+	uint32_t first = node.leftFirst;
+	uint32_t mid;
+	if (axis < 0) {
+		// every centroid is in the same spot, SAH can't separate them
+		if (node.count <= MAX_LEAF_SIZE) return;
+		mid = first + node.count / 2;
+	} else {
+		if (node.count <= MAX_LEAF_SIZE && splitCost >= leafCost) return;
+
+		mid = partition(ctx, first, node.count, axis, splitPos);
+		if (mid == first || mid == first + node.count) {
+			mid = first + node.count / 2;
+		}
+	}
+
+	uint32_t leftIndex = ctx.nodesUsed.fetch_add(2, std::memory_order_relaxed);
+	m_nodes[leftIndex] = {{}, first, {}, mid - first};
+	m_nodes[leftIndex + 1] = {{}, mid, {}, first + node.count - mid};
+	m_nodes[nodeIndex].leftFirst = leftIndex;
+	m_nodes[nodeIndex].count = 0;
+
+	for (uint32_t child = leftIndex; child < leftIndex + 2; ++child) {
+		if (ctx.pool && m_nodes[child].count >= SUBTREE_TASK_THRESHOLD) {
+			ctx.pool->run(ctx.group, [this, &ctx, child, depth] {
+				updateBounds(ctx, child);
+				subdivide(ctx, child, depth + 1);
+			});
+		} else {
+			updateBounds(ctx, child);
+			subdivide(ctx, child, depth + 1);
+		}
+	}
+}
+
+float BVH::sahCost() const {
+	if (m_nodes.empty()) return 0.0f;
+
+	float rootArea = AABB{m_nodes[0].min, m_nodes[0].max}.area();
+	if (rootArea <= 0.0f) return 0.0f;
+
+	float cost = 0.0f;
+	for (const auto& node : m_nodes) {
+		float area = AABB{node.min, node.max}.area() / rootArea;
+		cost += node.isLeaf() ? INTERSECTION_COST * float(node.count) * area : TRAVERSAL_COST * area;
+	}
+	return cost;
+}
+
+bool BVH::intersect(const Ray& ray, RayHit& hit, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, TraversalStats* stats) const {
+	if (stats) stats->boxTests++;
+	if (m_primRefs.empty() || intersectAABB(ray, m_nodes[0].min, m_nodes[0].max, hit.distance) == NO_HIT) return false;
+
+	uint32_t stack[MAX_DEPTH];
+	uint32_t stackSize = 0;
+	uint32_t current = 0;
+	bool hitSomething = false;
+
+	while (true) {
+		const auto& node = m_nodes[current];
+		if (stats) stats->nodes++;
+		if (node.isLeaf()) {
+			if (stats) stats->primTests += node.count;
+			for (uint32_t i = 0; i < node.count; ++i) {
+				auto ref = m_primRefs[node.leftFirst + i];
+				float t = intersectPrimRef(ray, ref, spheres, boxes);
+				if (t < hit.distance) {
+					hit.distance = t;
+					hit.primRef = ref;
+					hitSomething = true;
+				}
+			}
+		} else {
+			if (stats) stats->boxTests += 2;
+			uint32_t near = node.leftFirst;
+			uint32_t far = node.leftFirst + 1;
+			float tNear = intersectAABB(ray, m_nodes[near].min, m_nodes[near].max, hit.distance);
+			float tFar = intersectAABB(ray, m_nodes[far].min, m_nodes[far].max, hit.distance);
+			if (tFar < tNear) {
+				std::swap(near, far);
+				std::swap(tNear, tFar);
+			}
+
+			if (tNear != NO_HIT) {
+				if (tFar != NO_HIT) stack[stackSize++] = far;
+				current = near;
+				continue;
+			}
+		}
+
+		if (stackSize == 0) break;
+		current = stack[--stackSize];
+	}
+	return hitSomething;
+}
+
+bool BVH::occluded(const Ray& ray, float tMax, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, TraversalStats* stats) const {
+	if (stats) stats->boxTests++;
+	if (m_primRefs.empty() || intersectAABB(ray, m_nodes[0].min, m_nodes[0].max, tMax) == NO_HIT) return false;
+
+	uint32_t stack[MAX_DEPTH];
+	uint32_t stackSize = 0;
+	uint32_t current = 0;
+
+	while (true) {
+		const auto& node = m_nodes[current];
+		if (stats) stats->nodes++;
+		if (node.isLeaf()) {
+			for (uint32_t i = 0; i < node.count; ++i) {
+				if (stats) stats->primTests++;
+				auto ref = m_primRefs[node.leftFirst + i];
+				float t = intersectPrimRef(ray, ref, spheres, boxes);
+				if (t < tMax) return true;
+			}
+		} else {
+			if (stats) stats->boxTests += 2;
+			uint32_t left = node.leftFirst;
+			uint32_t right = node.leftFirst + 1;
+			bool hitLeft = intersectAABB(ray, m_nodes[left].min, m_nodes[left].max, tMax) != NO_HIT;
+			bool hitRight = intersectAABB(ray, m_nodes[right].min, m_nodes[right].max, tMax) != NO_HIT;
+
+			if (hitLeft || hitRight) {
+				if (hitLeft && hitRight) stack[stackSize++] = right;
+				current = hitLeft ? left : right;
+				continue;
+			}
+		}
+
+		if (stackSize == 0) break;
+		current = stack[--stackSize];
+	}
+	return false;
+}
+
+AABB primitiveBounds(uint32_t ref, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, const std::vector<SpotLight>& spotLights) {
+	AABB bounds;
+	auto index = primRefIndex(ref);
+	switch (primRefType(ref)) {
+		case PrimitiveType::Sphere:
+			bounds.grow(spheres[index].position - glm::vec3(spheres[index].radius));
+			bounds.grow(spheres[index].position + glm::vec3(spheres[index].radius));
+			break;
+		case PrimitiveType::SpotLight:
+			bounds.grow(spotLights[index].position - glm::vec3(spotLights[index].radius));
+			bounds.grow(spotLights[index].position + glm::vec3(spotLights[index].radius));
+			break;
+		default:
+			bounds.grow(boxes[index].min);
+			bounds.grow(boxes[index].max);
+			break;
+	}
+	return bounds;
+}
+
+float intersectSphere(const Ray& ray, const Sphere& sphere) {
+	glm::vec3 d = sphere.position - ray.origin;
+	float p1 = glm::dot(d, ray.direction);
+	float p2sqr = p1 * p1 - glm::dot(d, d) + sphere.radius * sphere.radius;
+	if (p2sqr < 0) return NO_HIT;
+
+	float p2 = std::sqrt(p2sqr);
+	float t = p1 - p2 > 0 ? p1 - p2 : p1 + p2;
+	return t > 0 ? t : NO_HIT;
+}
+
+float intersectBox(const Ray& ray, const Box& box) {
+	glm::vec3 t1 = ray.invDir * (box.min - ray.origin);
+	glm::vec3 t2 = ray.invDir * (box.max - ray.origin);
+	glm::vec3 tminv = glm::min(t1, t2);
+	glm::vec3 tmaxv = glm::max(t1, t2);
+
+	float tmin = std::max(std::max(tminv.x, 0.0f), std::max(tminv.y, tminv.z));
+	float tmax = std::min(tmaxv.x, std::min(tmaxv.y, tmaxv.z));
+	if (tmin <= 0) tmin = tmax;
+
+	return tmax >= std::max(tmin, 0.0f) && tmin > 0 ? tmin : NO_HIT;
+}
+
+float intersectPrimRef(const Ray& ray, uint32_t ref, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes) {
+	switch (primRefType(ref)) {
+		case PrimitiveType::Sphere: return intersectSphere(ray, spheres[primRefIndex(ref)]);
+		case PrimitiveType::Box: return intersectBox(ray, boxes[primRefIndex(ref)]);
+		default: return NO_HIT;
+	}
+}
+
+float intersectAABB(const Ray& ray, const glm::vec3& min, const glm::vec3& max, float tMax) {
+	glm::vec3 t1 = (min - ray.origin) * ray.invDir;
+	glm::vec3 t2 = (max - ray.origin) * ray.invDir;
+	glm::vec3 tminv = glm::min(t1, t2);
+	glm::vec3 tmaxv = glm::max(t1, t2);
+
+	float tnear = std::max(std::max(tminv.x, tminv.y), tminv.z);
+	float tfar = std::min(std::min(tmaxv.x, tmaxv.y), tmaxv.z);
+	return tfar >= tnear && tfar > 0 && tnear < tMax ? tnear : NO_HIT;
+}
+
+} // ph
@@ -0,0 +1,156 @@
+//
+// Created by Fatih on 8/26/2022.
+//
+
+#include "graphics/accel/Instancing.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace ph {
+
+static AABB transformBounds(const AABB& bounds, const glm::mat4& m) {
+	AABB result;
+	if (!bounds.valid()) return result;
+	for (int i = 0; i < 8; ++i) {
+		glm::vec3 corner{i & 1 ? bounds.max.x : bounds.min.x, i & 2 ? bounds.max.y : bounds.min.y, i & 4 ? bounds.max.z : bounds.min.z};
+		result.grow(glm::vec3(m * glm::vec4(corner, 1.0f)));
+	}
+	return result;
+}
+
+// collapses the tree to the wide layout, rebases it onto the shared node and prim ref arrays
+// and registers it as a group
+uint32_t InstancedScene::appendBLAS(const BVH& blas, const std::function<uint32_t(uint32_t)>& rebaseRef) {
+	auto nodeBase = uint32_t(m_blasNodes.size());
+	auto refBase = uint32_t(m_blasPrimRefs.size());
+
+	WideBVH wide;
+	wide.build(blas);
+
+	m_blasNodes.reserve(m_blasNodes.size() + wide.m_nodes.size());
+	for (auto node : wide.m_nodes) {
+		for (uint32_t i = 0; i < WideBVH::childCount(node); ++i) {
+			node.children[i] += (node.children[i] & WideBVH::LEAF_BIT) ? refBase : nodeBase;
+		}
+		m_blasNodes.push_back(node);
+	}
+	m_blasPrimRefs.reserve(m_blasPrimRefs.size() + blas.m_primRefs.size());
+	for (auto ref : blas.m_primRefs) {
+		m_blasPrimRefs.push_back(rebaseRef(ref));
+	}
+
+	m_groups.push_back({nodeBase, AABB{blas.m_nodes[0].min, blas.m_nodes[0].max}});
+	m_groupsDirty = true;
+	return uint32_t(m_groups.size() - 1);
+}
+
+uint32_t InstancedScene::addGroup(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, ThreadPool* pool) {
+	BVH blas;
+	blas.build(spheres, boxes, pool);
+
+	auto sphereBase = uint32_t(m_spheres.size());
+	auto boxBase = uint32_t(m_boxes.size());
+	m_spheres.insert(m_spheres.end(), spheres.begin(), spheres.end());
+	m_boxes.insert(m_boxes.end(), boxes.begin(), boxes.end());
+
+	return appendBLAS(blas, [&](uint32_t ref) {
+		auto type = primRefType(ref);
+		return makePrimRef(type, primRefIndex(ref) + (type == PrimitiveType::Sphere ? sphereBase : boxBase));
+	});
+}
+
+uint32_t InstancedScene::addMesh(const TriangleMesh& mesh, uint32_t material, ThreadPool* pool) {
+	auto triangleCount = uint32_t(mesh.triangleCount());
+	auto vertexBase = uint32_t(m_meshVertices.size());
+	auto triangleBase = uint32_t(m_triangles.size());
+
+	m_meshVertices.insert(m_meshVertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+	m_triangles.resize(triangleBase + triangleCount);
+
+	std::vector<AABB> bounds(triangleCount);
+	auto prepare = [&](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; ++i) {
+			const uint32_t* index = &mesh.indices[i * 3];
+			for (int v = 0; v < 3; ++v) bounds[i].grow(glm::vec3(mesh.vertices[index[v]]));
+			m_triangles[triangleBase + i] = {vertexBase + index[0], vertexBase + index[1], vertexBase + index[2], material};
+		}
+	};
+	if (pool) {
+		pool->parallelFor(0, triangleCount, 1 << 14, prepare);
+	} else {
+		prepare(0, triangleCount);
+	}
+
+	BVH blas;
+	blas.build(bounds, pool);
+	return appendBLAS(blas, [&](uint32_t ref) {
+		return makePrimRef(PrimitiveType::Triangle, triangleBase + ref);
+	});
+}
+
+uint32_t InstancedScene::addInstance(uint32_t group, const glm::mat4& objectToWorld) {
+	if (group >= m_groups.size()) {
+		throw std::runtime_error("Unknown instance group " + std::to_string(group));
+	}
+	m_instances.push_back({{}, m_groups[group].root, 0, 0, 0});
+	m_instanceBounds.emplace_back();
+	m_instanceGroups.push_back(group);
+	setTransform(uint32_t(m_instances.size() - 1), objectToWorld);
+	return uint32_t(m_instances.size() - 1);
+}
+
+void InstancedScene::setTransform(uint32_t instance, const glm::mat4& objectToWorld) {
+	auto& inst = m_instances[instance];
+	auto worldToObject = glm::transpose(glm::inverse(objectToWorld));
+	for (int i = 0; i < 3; ++i) inst.worldToObject[i] = worldToObject[i];
+
+	m_instanceBounds[instance] = transformBounds(m_groups[m_instanceGroups[instance]].bounds, objectToWorld);
+	m_instancesDirty = true;
+}
+
+void InstancedScene::init(Renderer* renderer, ThreadPool* pool) {
+	m_renderer = renderer;
+	buildTLAS(pool);
+	upload(true);
+}
+
+void InstancedScene::update(ThreadPool* pool) {
+	if (!m_groupsDirty && !m_instancesDirty) return;
+	buildTLAS(pool);
+	upload(false);
+}
+
+void InstancedScene::buildTLAS(ThreadPool* pool) {
+	m_tlas.build(m_instanceBounds, pool);
+}
+
+// empty arrays still get a one element buffer, nothing references it
+template<typename T>
+static void uploadArray(Renderer* renderer, bool add, uint32_t index, std::vector<T>& data) {
+	size_t size = std::max(sizeof(T) * data.size(), sizeof(T));
+	void* ptr = data.empty() ? nullptr : data.data();
+	if (add) {
+		renderer->addBuffer(index, size, ptr);
+	} else {
+		renderer->updateBuffer(index, size, ptr);
+	}
+}
+
+void InstancedScene::upload(bool addBuffers) {
+	if (addBuffers || m_groupsDirty) {
+		uploadArray(m_renderer, addBuffers, BLAS_SPHERE_BINDING, m_spheres);
+		uploadArray(m_renderer, addBuffers, BLAS_BOX_BINDING, m_boxes);
+		uploadArray(m_renderer, addBuffers, BLAS_NODE_BINDING, m_blasNodes);
+		uploadArray(m_renderer, addBuffers, BLAS_PRIM_REF_BINDING, m_blasPrimRefs);
+		uploadArray(m_renderer, addBuffers, MESH_VERTEX_BINDING, m_meshVertices);
+		uploadArray(m_renderer, addBuffers, TRIANGLE_BINDING, m_triangles);
+	}
+	uploadArray(m_renderer, addBuffers, INSTANCE_BINDING, m_instances);
+	uploadArray(m_renderer, addBuffers, TLAS_NODE_BINDING, m_tlas.m_nodes);
+	uploadArray(m_renderer, addBuffers, TLAS_REF_BINDING, m_tlas.m_primRefs);
+	m_groupsDirty = m_instancesDirty = false;
+}
+
+} // ph
@@ -0,0 +1,66 @@
+//
+// Created by Fatih on 8/24/2022.
+//
+
+#include "graphics/accel/LBVH.hpp"
+#include "graphics/accel/BVH.hpp"
+
+#include <algorithm>
+
+namespace ph {
+
+// mirrors LbvhNode in shaders/lbvh/Common.glsl
+constexpr size_t BUILD_NODE_SIZE = 48;
+constexpr size_t GLOBALS_SIZE = 6 * sizeof(uint32_t);
+
+void LBVH::init(Renderer* renderer, uint32_t primitiveCount) {
+	m_renderer = renderer;
+	m_primitiveCount = std::max(primitiveCount, 1u);
+
+	renderer->addBuffer(KEY_BINDING, sizeof(uint32_t) * 2 * m_primitiveCount, nullptr);
+	renderer->addBuffer(VALUE_BINDING, sizeof(uint32_t) * 2 * m_primitiveCount, nullptr);
+	renderer->addBuffer(HISTOGRAM_BINDING, sizeof(uint32_t) * RADIX_SIZE * blockCount(), nullptr);
+	renderer->addBuffer(BUILD_NODE_BINDING, BUILD_NODE_SIZE * (2 * m_primitiveCount - 1), nullptr);
+	renderer->addBuffer(GLOBALS_BINDING, GLOBALS_SIZE, nullptr);
+
+	auto enabled = [this] { return m_enabled; };
+	auto primitives = [this] { return primitiveGroups(); };
+
+	renderer->addComputePass({"shaders/lbvh/Reset.comp", PassStage::PreTrace, [] { return std::array<uint32_t, 3>{1, 1, 1}; }, enabled});
+	renderer->addComputePass({"shaders/lbvh/Bounds.comp", PassStage::PreTrace, primitives, enabled});
+	renderer->addComputePass({"shaders/lbvh/Morton.comp", PassStage::PreTrace, primitives, enabled});
+
+	// 30-bit keys, 8 bits per pass
+	for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+		std::vector<uint32_t> shift{pass * 8};
+		renderer->addComputePass({"shaders/lbvh/RadixHistogram.comp", PassStage::PreTrace, primitives, enabled, shift});
+		renderer->addComputePass({"shaders/lbvh/RadixScan.comp", PassStage::PreTrace, [] { return std::array<uint32_t, 3>{1, 1, 1}; }, enabled});
+		renderer->addComputePass({"shaders/lbvh/RadixScatter.comp", PassStage::PreTrace, primitives, enabled, shift});
+	}
+
+	renderer->addComputePass({"shaders/lbvh/Hierarchy.comp", PassStage::PreTrace, [this] {
+		return std::array<uint32_t, 3>{(m_primitiveCount - 1 + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1};
+	}, enabled});
+	renderer->addComputePass({"shaders/lbvh/Propagate.comp", PassStage::PreTrace, primitives, enabled});
+}
+
+void LBVH::resize(uint32_t primitiveCount) {
+	m_primitiveCount = std::max(primitiveCount, 1u);
+
+	m_renderer->updateBuffer(KEY_BINDING, sizeof(uint32_t) * 2 * m_primitiveCount, nullptr);
+	m_renderer->updateBuffer(VALUE_BINDING, sizeof(uint32_t) * 2 * m_primitiveCount, nullptr);
+	m_renderer->updateBuffer(HISTOGRAM_BINDING, sizeof(uint32_t) * RADIX_SIZE * blockCount(), nullptr);
+	m_renderer->updateBuffer(BUILD_NODE_BINDING, BUILD_NODE_SIZE * (2 * m_primitiveCount - 1), nullptr);
+
+	if (m_enabled) {
+		m_renderer->updateBuffer(NODE_BINDING, sizeof(BVHNode) * (2 * m_primitiveCount - 1), nullptr);
+		m_renderer->updateBuffer(PRIM_REF_BINDING, sizeof(uint32_t) * m_primitiveCount, nullptr);
+	}
+}
+
+void LBVH::setEnabled(bool enabled) {
+	m_enabled = enabled;
+	if (enabled) resize(m_primitiveCount);
+}
+
+} // ph
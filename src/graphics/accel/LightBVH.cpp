@@ -0,0 +1,313 @@
+//
+// Created by Fatih on 9/20/2022.
+//
+
+#include "graphics/accel/LightBVH.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+namespace ph {
+
+constexpr float PI = 3.14159265358979f;
+constexpr float ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+
+// mirrors Luminance in shaders/RTNew.comp
+static float luminance(const glm::vec3& color) {
+	return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+static float safeSqrt(float x) {
+	return std::sqrt(std::max(x, 0.0f));
+}
+
+static float safeAcos(float x) {
+	return std::acos(std::clamp(x, -1.0f, 1.0f));
+}
+
+// cos(max(0, a - b)) from the sines and cosines of both angles
+static float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+	if (cosA > cosB) return 1.0f;
+	return cosA * cosB + sinA * sinB;
+}
+
+static float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+	if (cosA > cosB) return 0.0f;
+	return sinA * cosB - cosA * sinB;
+}
+
+void LightCone::grow(const LightCone& cone) {
+	if (cone.empty) return;
+	if (empty) {
+		*this = cone;
+		return;
+	}
+	// a cone over every direction stays one, the common case for sphere lights
+	if (cosTheta <= -1.0f) return;
+	if (cone.cosTheta <= -1.0f) {
+		cosTheta = -1.0f;
+		return;
+	}
+
+	float thetaA = safeAcos(cosTheta);
+	float thetaB = safeAcos(cone.cosTheta);
+	float thetaD = safeAcos(glm::dot(axis, cone.axis));
+	if (std::min(thetaD + thetaB, PI) <= thetaA) return;
+	if (std::min(thetaD + thetaA, PI) <= thetaB) {
+		*this = cone;
+		return;
+	}
+
+	// the cone through both, its axis turned from ours toward theirs
+	float theta = (thetaA + thetaD + thetaB) * 0.5f;
+	glm::vec3 rotationAxis = glm::cross(axis, cone.axis);
+	if (theta >= PI || glm::dot(rotationAxis, rotationAxis) == 0.0f) {
+		cosTheta = -1.0f;
+		return;
+	}
+	glm::vec3 k = glm::normalize(rotationAxis);
+	float angle = theta - thetaA;
+	axis = glm::normalize(axis * std::cos(angle) + glm::cross(k, axis) * std::sin(angle));
+	cosTheta = std::cos(theta);
+}
+
+void LightBVH::NodeBounds::grow(const BuildLight& light) {
+	bounds.grow(light.bounds);
+	cone.grow(light.cone);
+	power += light.power;
+}
+
+// orientation-weighted surface area of the bounds, the cost of the split heuristic
+static float splitCost(const AABB& bounds, const LightCone& cone, float power, int axis) {
+	if (!bounds.valid()) return 0.0f;
+	float thetaO = safeAcos(cone.cosTheta);
+	float thetaW = std::min(thetaO + PI * 0.5f, PI);
+	float sinThetaO = std::sin(thetaO);
+	float mOmega = 2.0f * PI * (1.0f - cone.cosTheta)
+		+ PI * 0.5f * (2.0f * thetaW * sinThetaO - std::cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + cone.cosTheta);
+
+	// long thin nodes are split across their long side
+	glm::vec3 extent = bounds.max - bounds.min;
+	float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+	float regularization = extent[axis] > 0.0f ? maxExtent / extent[axis] : 1.0f;
+	return power * mOmega * regularization * bounds.area();
+}
+
+LightBVH::BuildLight LightBVH::buildLight(const SpotLight& light, uint32_t index) {
+	AABB bounds{light.position - glm::vec3(light.radius), light.position + glm::vec3(light.radius)};
+	// a diffuse sphere of radiance L emits pi * L * area
+	float power = luminance(light.color) * std::max(light.intensity, 0.0f) * PI * 4.0f * PI * light.radius * light.radius;
+	return {bounds, {glm::vec3(0.0f, 0.0f, 1.0f), -1.0f, false}, power, index};
+}
+
+void LightBVH::build(const std::vector<SpotLight>& lights) {
+	if (lights.size() >= LEAF_BIT) throw std::runtime_error("Too many lights for the light BVH");
+
+	m_nodes.clear();
+	m_trails.assign(std::max<size_t>(lights.size(), 1), 0);
+	if (lights.empty()) {
+		m_nodes.push_back({glm::vec3(0.0f), LEAF_BIT, glm::vec3(0.0f), 0.0f, glm::vec3(0.0f, 0.0f, 1.0f), 1.0f});
+		return;
+	}
+
+	m_buildLights.resize(lights.size());
+	for (uint32_t i = 0; i < lights.size(); ++i) m_buildLights[i] = buildLight(lights[i], i);
+
+	m_nodes.reserve(lights.size() * 2 - 1);
+	subdivide(0, uint32_t(lights.size()), 0, 0);
+	m_buildLights.clear();
+}
+
+void LightBVH::refit(const std::vector<SpotLight>& lights) {
+	// children come after their parent, a backwards sweep sees them first
+	for (size_t i = m_nodes.size(); i-- > 0;) {
+		LightBVHNode& node = m_nodes[i];
+		if (node.ref & LEAF_BIT) {
+			if (lights.empty()) continue;
+			BuildLight light = buildLight(lights[node.ref & ~LEAF_BIT], 0);
+			node.min = light.bounds.min;
+			node.max = light.bounds.max;
+			node.power = light.power;
+			node.axis = light.cone.axis;
+			node.cosTheta = light.cone.cosTheta;
+			continue;
+		}
+
+		const LightBVHNode& first = m_nodes[i + 1];
+		const LightBVHNode& second = m_nodes[node.ref];
+		LightCone cone{first.axis, first.cosTheta, false};
+		cone.grow({second.axis, second.cosTheta, false});
+		node.min = glm::min(first.min, second.min);
+		node.max = glm::max(first.max, second.max);
+		node.power = first.power + second.power;
+		node.axis = cone.axis;
+		node.cosTheta = cone.cosTheta;
+	}
+}
+
+uint32_t LightBVH::subdivide(uint32_t first, uint32_t last, uint32_t depth, uint32_t trail) {
+	NodeBounds node;
+	for (uint32_t i = first; i < last; ++i) node.grow(m_buildLights[i]);
+
+	auto index = uint32_t(m_nodes.size());
+	m_nodes.push_back({node.bounds.min, 0, node.bounds.max, node.power, node.cone.axis, node.cone.cosTheta});
+	if (last - first == 1) {
+		uint32_t light = m_buildLights[first].index;
+		m_nodes[index].ref = LEAF_BIT | light;
+		m_trails[light] = trail;
+		return index;
+	}
+
+	uint32_t middle = split(first, last, depth);
+	subdivide(first, middle, depth + 1, trail);
+	m_nodes[index].ref = subdivide(middle, last, depth + 1, trail | (1u << depth));
+	return index;
+}
+
+uint32_t LightBVH::split(uint32_t first, uint32_t last, uint32_t depth) {
+	uint32_t count = last - first;
+	AABB centroids;
+	for (uint32_t i = first; i < last; ++i) centroids.grow(m_buildLights[i].bounds.center());
+	glm::vec3 extent = centroids.max - centroids.min;
+	int longest = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+	auto medianSplit = [&]() {
+		uint32_t middle = first + count / 2;
+		std::nth_element(m_buildLights.begin() + first, m_buildLights.begin() + middle, m_buildLights.begin() + last,
+						 [longest](const BuildLight& a, const BuildLight& b) { return a.bounds.center()[longest] < b.bounds.center()[longest]; });
+		return middle;
+	};
+
+	// median splits from here on keep every leaf within MAX_DEPTH
+	if (depth + uint32_t(std::bit_width(count - 1)) >= MAX_DEPTH) return medianSplit();
+
+	float bestCost = std::numeric_limits<float>::max();
+	int bestAxis = -1;
+	uint32_t bestBin = 0;
+	for (int axis = 0; axis < 3; ++axis) {
+		if (extent[axis] <= 0.0f) continue;
+
+		NodeBounds bins[BIN_COUNT];
+		float scale = float(BIN_COUNT) / extent[axis];
+		auto binOf = [&](const BuildLight& light) {
+			return std::min(uint32_t((light.bounds.center()[axis] - centroids.min[axis]) * scale), BIN_COUNT - 1);
+		};
+		for (uint32_t i = first; i < last; ++i) bins[binOf(m_buildLights[i])].grow(m_buildLights[i]);
+
+		// cost of splitting after bin i, from sweeps in both directions
+		float costs[BIN_COUNT - 1]{};
+		NodeBounds below;
+		for (uint32_t i = 0; i < BIN_COUNT - 1; ++i) {
+			below.bounds.grow(bins[i].bounds);
+			below.cone.grow(bins[i].cone);
+			below.power += bins[i].power;
+			costs[i] = splitCost(below.bounds, below.cone, below.power, axis);
+		}
+		NodeBounds above;
+		for (uint32_t i = BIN_COUNT - 1; i > 0; --i) {
+			above.bounds.grow(bins[i].bounds);
+			above.cone.grow(bins[i].cone);
+			above.power += bins[i].power;
+			costs[i - 1] += splitCost(above.bounds, above.cone, above.power, axis);
+		}
+
+		for (uint32_t i = 0; i < BIN_COUNT - 1; ++i) {
+			if (costs[i] < bestCost) {
+				bestCost = costs[i];
+				bestAxis = axis;
+				bestBin = i;
+			}
+		}
+	}
+	if (bestAxis < 0) return medianSplit();
+
+	float splitPos = centroids.min[bestAxis] + float(bestBin + 1) * extent[bestAxis] / float(BIN_COUNT);
+	auto middle = std::partition(m_buildLights.begin() + first, m_buildLights.begin() + last,
+								 [&](const BuildLight& light) { return light.bounds.center()[bestAxis] < splitPos; });
+	auto result = uint32_t(middle - m_buildLights.begin());
+	// empty bins next to each other can leave a side without lights
+	if (result == first || result == last) return medianSplit();
+	return result;
+}
+
+// mirrors LightImportance in shaders/common/LightBVH.glsl
+float LightBVH::importance(const LightBVHNode& node, const glm::vec3& p, const glm::vec3& n) {
+	if (node.power <= 0.0f) return 0.0f;
+
+	glm::vec3 center = (node.min + node.max) * 0.5f;
+	glm::vec3 toPoint = p - center;
+	float radius = glm::length(node.max - node.min) * 0.5f;
+	float distanceSq = std::max(glm::dot(toPoint, toPoint), radius);
+	glm::vec3 wi = glm::dot(toPoint, toPoint) > 0.0f ? glm::normalize(toPoint) : glm::vec3(0.0f, 0.0f, 1.0f);
+
+	// half angle the bounds subtend from p, everything when p is inside them
+	float sinBoundsSq = radius * radius / std::max(glm::dot(toPoint, toPoint), 1e-12f);
+	float cosBounds = sinBoundsSq < 1.0f ? safeSqrt(1.0f - sinBoundsSq) : -1.0f;
+	float sinBounds = safeSqrt(1.0f - cosBounds * cosBounds);
+
+	// smallest angle between p and an emitter normal of the cone, seen from anywhere in the bounds
+	float cosW = glm::dot(node.axis, wi);
+	float sinW = safeSqrt(1.0f - cosW * cosW);
+	float sinO = safeSqrt(1.0f - node.cosTheta * node.cosTheta);
+	float cosX = cosSubClamped(sinW, cosW, sinO, node.cosTheta);
+	float sinX = sinSubClamped(sinW, cosW, sinO, node.cosTheta);
+	float cosEmit = cosSubClamped(sinX, cosX, sinBounds, cosBounds);
+	if (cosEmit <= 0.0f) return 0.0f;
+
+	float result = node.power * cosEmit / distanceSq;
+	if (n != glm::vec3(0.0f)) {
+		// light sampling only covers the side the normal faces
+		float cosI = glm::dot(-wi, n);
+		float sinI = safeSqrt(1.0f - cosI * cosI);
+		result *= std::max(cosSubClamped(sinI, cosI, sinBounds, cosBounds), 0.0f);
+	}
+	return result;
+}
+
+bool LightBVH::sample(const glm::vec3& p, const glm::vec3& n, float u, uint32_t& light, float& pmf) const {
+	pmf = 1.0f;
+	if (importance(m_nodes[0], p, n) <= 0.0f) return false;
+
+	uint32_t index = 0;
+	while (!(m_nodes[index].ref & LEAF_BIT)) {
+		uint32_t second = m_nodes[index].ref;
+		float first = importance(m_nodes[index + 1], p, n);
+		float total = first + importance(m_nodes[second], p, n);
+		if (total <= 0.0f) return false;
+
+		float p0 = first / total;
+		if (u < p0) {
+			index = index + 1;
+			u = std::min(u / p0, ONE_MINUS_EPSILON);
+			pmf *= p0;
+		} else {
+			index = second;
+			u = std::min((u - p0) / (1.0f - p0), ONE_MINUS_EPSILON);
+			pmf *= 1.0f - p0;
+		}
+	}
+	light = m_nodes[index].ref & ~LEAF_BIT;
+	return true;
+}
+
+float LightBVH::pmf(const glm::vec3& p, const glm::vec3& n, uint32_t light) const {
+	uint32_t trail = m_trails[light];
+	uint32_t index = 0;
+	float result = 1.0f;
+	while (!(m_nodes[index].ref & LEAF_BIT)) {
+		uint32_t second = m_nodes[index].ref;
+		float first = importance(m_nodes[index + 1], p, n);
+		float total = first + importance(m_nodes[second], p, n);
+		if (total <= 0.0f) return 0.0f;
+
+		bool takeSecond = trail & 1u;
+		result *= (takeSecond ? total - first : first) / total;
+		index = takeSecond ? second : index + 1;
+		trail >>= 1;
+	}
+	return result;
+}
+
+} // ph
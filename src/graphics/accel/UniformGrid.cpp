@@ -0,0 +1,121 @@
+//
+// Created by Fatih on 9/1/2022.
+//
+
+#include "graphics/accel/UniformGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ph {
+
+constexpr float NO_HIT = std::numeric_limits<float>::max();
+
+glm::uvec3 UniformGrid::cellOf(const glm::vec3& p) const {
+	glm::vec3 cell = glm::floor((p - m_bounds.min) / m_cellSize);
+	return glm::uvec3(glm::clamp(cell, glm::vec3(0.0f), glm::vec3(m_resolution - 1u)));
+}
+
+void UniformGrid::build(const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, const std::vector<SpotLight>& spotLights) {
+	auto sphereCount = uint32_t(spheres.size());
+	auto boxCount = uint32_t(boxes.size());
+	auto count = uint32_t(spheres.size() + boxes.size() + spotLights.size());
+	auto refOf = [&](uint32_t i) {
+		if (i < sphereCount) return makePrimRef(PrimitiveType::Sphere, i);
+		if (i < sphereCount + boxCount) return makePrimRef(PrimitiveType::Box, i - sphereCount);
+		return makePrimRef(PrimitiveType::SpotLight, i - sphereCount - boxCount);
+	};
+
+	std::vector<AABB> bounds(count);
+	m_bounds = {};
+	for (uint32_t i = 0; i < count; ++i) {
+		bounds[i] = primitiveBounds(refOf(i), spheres, boxes, spotLights);
+		m_bounds.grow(bounds[i]);
+	}
+	if (count == 0) m_bounds = {glm::vec3(0.0f), glm::vec3(1.0f)};
+
+	// cells per axis proportional to the extent, about DENSITY cells per primitive in total.
+	// Flat scenes get a minimum thickness so the volume doesn't vanish.
+	glm::vec3 extent = glm::max(m_bounds.max - m_bounds.min, glm::vec3(1e-3f * glm::max(m_bounds.max.x - m_bounds.min.x, glm::max(m_bounds.max.y - m_bounds.min.y, m_bounds.max.z - m_bounds.min.z)) + 1e-6f));
+	m_bounds.max = m_bounds.min + extent;
+	float cellsPerUnit = std::cbrt(DENSITY * float(std::max(count, 1u)) / (extent.x * extent.y * extent.z));
+	for (int a = 0; a < 3; ++a) {
+		m_resolution[a] = uint32_t(std::clamp(std::round(extent[a] * cellsPerUnit), 1.0f, float(MAX_RESOLUTION)));
+	}
+	m_cellSize = extent / glm::vec3(m_resolution);
+
+	// count, prefix sum, then fill
+	m_cellOffsets.assign(cellCount() + 1, 0);
+	for (const auto& b : bounds) {
+		auto lo = cellOf(b.min), hi = cellOf(b.max);
+		for (uint32_t z = lo.z; z <= hi.z; ++z)
+			for (uint32_t y = lo.y; y <= hi.y; ++y)
+				for (uint32_t x = lo.x; x <= hi.x; ++x)
+					m_cellOffsets[(z * m_resolution.y + y) * m_resolution.x + x + 1]++;
+	}
+	for (size_t i = 1; i < m_cellOffsets.size(); ++i) m_cellOffsets[i] += m_cellOffsets[i - 1];
+
+	std::vector<uint32_t> cursor(m_cellOffsets.begin(), m_cellOffsets.end() - 1);
+	m_primRefs.resize(m_cellOffsets.back());
+	for (uint32_t i = 0; i < count; ++i) {
+		auto ref = refOf(i);
+		auto lo = cellOf(bounds[i].min), hi = cellOf(bounds[i].max);
+		for (uint32_t z = lo.z; z <= hi.z; ++z)
+			for (uint32_t y = lo.y; y <= hi.y; ++y)
+				for (uint32_t x = lo.x; x <= hi.x; ++x)
+					m_primRefs[cursor[(z * m_resolution.y + y) * m_resolution.x + x]++] = ref;
+	}
+}
+
+bool UniformGrid::intersect(const Ray& ray, RayHit& hit, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, TraversalStats* stats) const {
+	glm::vec3 t1 = (m_bounds.min - ray.origin) * ray.invDir;
+	glm::vec3 t2 = (m_bounds.max - ray.origin) * ray.invDir;
+	glm::vec3 tminv = glm::min(t1, t2), tmaxv = glm::max(t1, t2);
+	float tEnter = std::max(std::max(std::max(tminv.x, tminv.y), tminv.z), 0.0f);
+	float tExit = std::min(std::min(tmaxv.x, tmaxv.y), tmaxv.z);
+	if (tEnter > tExit || tEnter >= hit.distance) return false;
+
+	glm::ivec3 res(m_resolution);
+	glm::ivec3 cell(cellOf(ray.origin + ray.direction * tEnter));
+	glm::ivec3 step(glm::sign(ray.direction));
+	glm::vec3 tMax, tDelta;
+	for (int a = 0; a < 3; ++a) {
+		if (step[a] == 0) {
+			tMax[a] = tDelta[a] = NO_HIT;
+			continue;
+		}
+		float boundary = m_bounds.min[a] + float(cell[a] + (step[a] > 0 ? 1 : 0)) * m_cellSize[a];
+		tMax[a] = (boundary - ray.origin[a]) * ray.invDir[a];
+		tDelta[a] = std::abs(m_cellSize[a] * ray.invDir[a]);
+	}
+
+	bool hitSomething = false;
+	while (true) {
+		uint32_t index = (cell.z * res.y + cell.y) * res.x + cell.x;
+		if (stats) {
+			stats->nodes++;
+			stats->primTests += m_cellOffsets[index + 1] - m_cellOffsets[index];
+		}
+		for (uint32_t i = m_cellOffsets[index]; i < m_cellOffsets[index + 1]; ++i) {
+			auto ref = m_primRefs[i];
+			float t = intersectPrimRef(ray, ref, spheres, boxes);
+			if (t < hit.distance) {
+				hit.distance = t;
+				hit.primRef = ref;
+				hitSomething = true;
+			}
+		}
+
+		// a hit inside this cell can't be beaten by anything further along the ray
+		float cellExit = std::min(std::min(tMax.x, tMax.y), tMax.z);
+		if (hit.distance <= cellExit || cellExit > tExit) break;
+
+		int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+		cell[axis] += step[axis];
+		if (cell[axis] < 0 || cell[axis] >= res[axis]) break;
+		tMax[axis] += tDelta[axis];
+	}
+	return hitSomething;
+}
+
+} // ph
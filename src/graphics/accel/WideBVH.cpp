@@ -0,0 +1,222 @@
+//
+// Created by Fatih on 8/30/2022.
+//
+
+#include "graphics/accel/WideBVH.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ph {
+
+constexpr float NO_HIT = std::numeric_limits<float>::max();
+
+// biased exponent of the smallest power of two step that covers the extent in 255 steps
+static uint32_t quantizationExponent(float extent) {
+	if (extent <= 0.0f) return 1;
+	int e = int(std::ceil(std::log2(extent / 255.0f)));
+	if (std::ldexp(255.0f, e) < extent) e++;
+	return uint32_t(std::clamp(e + 127, 1, 254));
+}
+
+static float exponentScale(uint32_t biased) {
+	return std::ldexp(1.0f, int(biased) - 127);
+}
+
+// sets up the quantization of a node spanning [min, max], the child count is left to the caller
+static WideBVHNode quantizedNode(const glm::vec3& min, const glm::vec3& max, glm::vec3& scale) {
+	WideBVHNode node{};
+	node.origin = min;
+	for (int a = 0; a < 3; ++a) {
+		uint32_t exponent = quantizationExponent(max[a] - min[a]);
+		node.meta |= exponent << (a * 8);
+		scale[a] = exponentScale(exponent);
+	}
+	return node;
+}
+
+static void quantizeChild(WideBVHNode& node, const glm::vec3& scale, uint32_t child, const glm::vec3& min, const glm::vec3& max) {
+	for (int a = 0; a < 3; ++a) {
+		auto lo = uint32_t(std::clamp(std::floor((min[a] - node.origin[a]) / scale[a]), 0.0f, 255.0f));
+		auto hi = uint32_t(std::clamp(std::ceil((max[a] - node.origin[a]) / scale[a]), 0.0f, 255.0f));
+		node.lo[a] |= lo << (child * 8);
+		node.hi[a] |= hi << (child * 8);
+	}
+}
+
+void WideBVH::build(const BVH& bvh) {
+	m_primRefs = bvh.m_primRefs;
+	m_nodes.assign(1, WideBVHNode{});
+	if (m_primRefs.empty()) return;
+
+	collapse(bvh, 0, 0);
+}
+
+void WideBVH::collapse(const BVH& bvh, uint32_t binaryIndex, uint32_t wideIndex) {
+	const auto& root = bvh.m_nodes[binaryIndex];
+
+	uint32_t children[WIDTH];
+	uint32_t count = 0;
+	if (root.isLeaf()) {
+		children[count++] = binaryIndex;
+	} else {
+		children[count++] = root.leftFirst;
+		children[count++] = root.leftFirst + 1;
+	}
+
+	// open the largest inner child until the node is full
+	while (count < WIDTH) {
+		int best = -1;
+		float bestArea = -1.0f;
+		for (uint32_t i = 0; i < count; ++i) {
+			const auto& child = bvh.m_nodes[children[i]];
+			float area = AABB{child.min, child.max}.area();
+			if (!child.isLeaf() && area > bestArea) {
+				best = int(i);
+				bestArea = area;
+			}
+		}
+		if (best < 0) break;
+
+		uint32_t opened = bvh.m_nodes[children[best]].leftFirst;
+		children[best] = opened;
+		children[count++] = opened + 1;
+	}
+
+	glm::vec3 scale;
+	WideBVHNode node = quantizedNode(root.min, root.max, scale);
+	node.meta |= count << 24;
+
+	uint32_t inner[WIDTH];
+	uint32_t innerCount = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		const auto& child = bvh.m_nodes[children[i]];
+		quantizeChild(node, scale, i, child.min, child.max);
+
+		if (child.isLeaf() && child.count <= MAX_LEAF_COUNT) {
+			node.children[i] = LEAF_BIT | (child.count << LEAF_COUNT_SHIFT) | child.leftFirst;
+		} else {
+			node.children[i] = uint32_t(m_nodes.size());
+			inner[innerCount++] = children[i];
+			m_nodes.emplace_back();
+		}
+	}
+	m_nodes[wideIndex] = node;
+
+	for (uint32_t i = 0, slot = 0; i < count; ++i) {
+		if (node.children[i] & LEAF_BIT) continue;
+		uint32_t binaryChild = inner[slot++];
+		if (bvh.m_nodes[binaryChild].isLeaf()) {
+			splitLeaf(bvh.m_nodes[binaryChild], node.children[i]);
+		} else {
+			collapse(bvh, binaryChild, node.children[i]);
+		}
+	}
+}
+
+void WideBVH::splitLeaf(const BVHNode& leaf, uint32_t wideIndex) {
+	// Up to WIDTH - 1 full leaves and the rest in the last child, which is another such node while it
+	// doesn't fit a leaf. Every node has one inner child at most, so the traversal never pushes here and
+	// the stack bound of the binary tree's depth still holds. All children share the leaf's bounds.
+	uint32_t first = leaf.leftFirst;
+	uint32_t remaining = leaf.count;
+	while (true) {
+		glm::vec3 scale;
+		WideBVHNode node = quantizedNode(leaf.min, leaf.max, scale);
+
+		uint32_t count = 0;
+		for (; count < WIDTH - 1 && remaining > MAX_LEAF_COUNT; ++count) {
+			quantizeChild(node, scale, count, leaf.min, leaf.max);
+			node.children[count] = LEAF_BIT | (MAX_LEAF_COUNT << LEAF_COUNT_SHIFT) | first;
+			first += MAX_LEAF_COUNT;
+			remaining -= MAX_LEAF_COUNT;
+		}
+
+		quantizeChild(node, scale, count, leaf.min, leaf.max);
+		bool last = remaining <= MAX_LEAF_COUNT;
+		node.children[count] = last ? LEAF_BIT | (remaining << LEAF_COUNT_SHIFT) | first : uint32_t(m_nodes.size());
+		node.meta |= (count + 1) << 24;
+		m_nodes[wideIndex] = node;
+		if (last) return;
+
+		wideIndex = uint32_t(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+}
+
+AABB WideBVH::childBounds(const WideBVHNode& node, uint32_t child) {
+	AABB bounds;
+	for (int a = 0; a < 3; ++a) {
+		float scale = exponentScale((node.meta >> (a * 8)) & 0xFF);
+		bounds.min[a] = node.origin[a] + float((node.lo[a] >> (child * 8)) & 0xFF) * scale;
+		bounds.max[a] = node.origin[a] + float((node.hi[a] >> (child * 8)) & 0xFF) * scale;
+	}
+	return bounds;
+}
+
+bool WideBVH::intersect(const Ray& ray, RayHit& hit, const std::vector<Sphere>& spheres, const std::vector<Box>& boxes, TraversalStats* stats) const {
+	if (m_primRefs.empty()) return false;
+
+	// every level pushes at most WIDTH - 1 siblings
+	uint32_t stack[BVH::MAX_DEPTH * (WIDTH - 1)];
+	uint32_t stackSize = 0;
+	uint32_t current = 0;
+	bool hitSomething = false;
+
+	while (true) {
+		const auto& node = m_nodes[current];
+		if (stats) {
+			stats->nodes++;
+			stats->boxTests += childCount(node);
+		}
+
+		float distances[WIDTH];
+		uint32_t next[WIDTH];
+		uint32_t nextCount = 0;
+		for (uint32_t i = 0; i < childCount(node); ++i) {
+			auto bounds = childBounds(node, i);
+			float t = intersectAABB(ray, bounds.min, bounds.max, hit.distance);
+			if (t == NO_HIT) continue;
+
+			uint32_t child = node.children[i];
+			if ((child & LEAF_BIT) == 0) {
+				// insertion sort, nearest child ends up first
+				uint32_t j = nextCount++;
+				for (; j > 0 && distances[j - 1] > t; --j) {
+					distances[j] = distances[j - 1];
+					next[j] = next[j - 1];
+				}
+				distances[j] = t;
+				next[j] = child;
+				continue;
+			}
+
+			uint32_t first = child & LEAF_FIRST_MASK;
+			uint32_t count = (child & ~LEAF_BIT) >> LEAF_COUNT_SHIFT;
+			if (stats) stats->primTests += count;
+			for (uint32_t k = 0; k < count; ++k) {
+				auto ref = m_primRefs[first + k];
+				auto index = primRefIndex(ref);
+				float d = primRefType(ref) == PrimitiveType::Sphere ? intersectSphere(ray, spheres[index]) : intersectBox(ray, boxes[index]);
+				if (d < hit.distance) {
+					hit.distance = d;
+					hit.primRef = ref;
+					hitSomething = true;
+				}
+			}
+		}
+
+		// farther children first so the nearest is popped next
+		for (uint32_t i = nextCount; i > 1; --i) stack[stackSize++] = next[i - 1];
+		if (nextCount > 0) {
+			current = next[0];
+			continue;
+		}
+
+		if (stackSize == 0) break;
+		current = stack[--stackSize];
+	}
+	return hitSomething;
+}
+
+} // ph
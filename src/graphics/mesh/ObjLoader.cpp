@@ -0,0 +1,189 @@
+//
+// Created by Fatih on 8/28/2022.
+//
+
+#include "graphics/mesh/ObjLoader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace ph {
+
+constexpr size_t OBJ_BLOCK_SIZE = 32 << 20;
+
+struct ObjChunk {
+	const char* begin;
+	const char* end;
+	uint32_t vertexCount;
+	uint32_t vertexBase;
+	std::vector<uint32_t> indices;
+};
+
+static void forEachChunk(ThreadPool* pool, uint32_t count, const std::function<void(uint32_t)>& func) {
+	if (pool == nullptr) {
+		for (uint32_t i = 0; i < count; ++i) func(i);
+		return;
+	}
+	pool->parallelFor(0, count, 1, [&](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; ++i) func(i);
+	});
+}
+
+static const char* skipSpaces(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t')) ++p;
+	return p;
+}
+
+static const char* nextLine(const char* p, const char* end) {
+	auto newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+	return newline ? newline + 1 : end;
+}
+
+static bool isVertexLine(const char* p, const char* end) {
+	return end - p > 1 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t');
+}
+
+static uint32_t countVertices(const char* p, const char* end) {
+	uint32_t count = 0;
+	for (; p < end; p = nextLine(p, end)) {
+		if (isVertexLine(p, end)) count++;
+	}
+	return count;
+}
+
+static void parseChunk(ObjChunk& chunk, glm::vec4* vertices) {
+	uint32_t vertexCount = chunk.vertexBase;
+	std::vector<uint32_t> face;
+
+	for (const char* p = chunk.begin; p < chunk.end;) {
+		const char* lineEnd = nextLine(p, chunk.end);
+
+		if (isVertexLine(p, lineEnd)) {
+			glm::vec4 v{0, 0, 0, 1};
+			p += 1;
+			for (int i = 0; i < 3; ++i) {
+				p = skipSpaces(p, lineEnd);
+				p = std::from_chars(p, lineEnd, v[i]).ptr;
+			}
+			vertices[vertexCount++] = v;
+		} else if (lineEnd - p > 1 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			face.clear();
+			p = skipSpaces(p + 1, lineEnd);
+			while (p < lineEnd && *p != '\r' && *p != '\n') {
+				int64_t index = 0;
+				auto result = std::from_chars(p, lineEnd, index);
+				if (result.ec != std::errc()) break;
+
+				// 1-based, negative indices count back from the last vertex read
+				face.push_back(index > 0 ? uint32_t(index - 1) : uint32_t(int64_t(vertexCount) + index));
+
+				// skip texture coordinate and normal indices
+				p = result.ptr;
+				while (p < lineEnd && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') ++p;
+				p = skipSpaces(p, lineEnd);
+			}
+			for (size_t i = 2; i < face.size(); ++i) {
+				chunk.indices.insert(chunk.indices.end(), {face[0], face[i - 1], face[i]});
+			}
+		}
+		p = lineEnd;
+	}
+}
+
+// parses complete lines only, vertices land in place since every chunk knows its vertex base up front
+static void parseBlock(const char* begin, const char* end, TriangleMesh& mesh, std::vector<ObjChunk>& chunks, ThreadPool* pool) {
+	auto chunkCount = uint32_t(chunks.size());
+	size_t size = end - begin;
+	for (uint32_t i = 0; i < chunkCount; ++i) {
+		const char* p = begin + size * i / chunkCount;
+		while (p > begin && p < end && p[-1] != '\n') ++p;
+		chunks[i].begin = p;
+		chunks[i].indices.clear();
+	}
+	for (uint32_t i = 0; i < chunkCount; ++i) {
+		chunks[i].end = i + 1 < chunkCount ? chunks[i + 1].begin : end;
+	}
+
+	forEachChunk(pool, chunkCount, [&](uint32_t i) {
+		chunks[i].vertexCount = countVertices(chunks[i].begin, chunks[i].end);
+	});
+
+	auto vertexBase = uint32_t(mesh.vertices.size());
+	for (auto& chunk : chunks) {
+		chunk.vertexBase = vertexBase;
+		vertexBase += chunk.vertexCount;
+	}
+	mesh.vertices.resize(vertexBase);
+
+	forEachChunk(pool, chunkCount, [&](uint32_t i) {
+		parseChunk(chunks[i], mesh.vertices.data());
+	});
+
+	std::vector<size_t> indexBase(chunkCount);
+	size_t indexCount = mesh.indices.size();
+	for (uint32_t i = 0; i < chunkCount; ++i) {
+		indexBase[i] = indexCount;
+		indexCount += chunks[i].indices.size();
+	}
+	mesh.indices.resize(indexCount);
+
+	forEachChunk(pool, chunkCount, [&](uint32_t i) {
+		std::copy(chunks[i].indices.begin(), chunks[i].indices.end(), mesh.indices.begin() + ptrdiff_t(indexBase[i]));
+	});
+}
+
+TriangleMesh loadObj(const std::string& path, ThreadPool* pool) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open OBJ file " + path);
+	}
+
+	TriangleMesh mesh;
+	std::vector<ObjChunk> chunks(pool ? pool->threadCount() * 4 : 1);
+	std::vector<char> block;
+	size_t carry = 0;
+
+	while (true) {
+		block.resize(carry + OBJ_BLOCK_SIZE);
+		file.read(block.data() + carry, OBJ_BLOCK_SIZE);
+		size_t size = carry + size_t(file.gcount());
+		bool last = !file;
+
+		// the partial line at the end of a block moves to the front of the next one
+		size_t end = size;
+		if (!last) {
+			while (end > 0 && block[end - 1] != '\n') --end;
+		}
+		if (end > 0) {
+			parseBlock(block.data(), block.data() + end, mesh, chunks, pool);
+		}
+
+		carry = size - end;
+		std::memmove(block.data(), block.data() + end, carry);
+		if (last) break;
+	}
+
+	auto vertexCount = uint32_t(mesh.vertices.size());
+	std::atomic<bool> invalid{false};
+	auto indexCount = uint32_t(mesh.indices.size());
+	auto check = [&](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; ++i) {
+			if (mesh.indices[i] >= vertexCount) invalid = true;
+		}
+	};
+	if (pool) {
+		pool->parallelFor(0, indexCount, 1 << 16, check);
+	} else {
+		check(0, indexCount);
+	}
+	if (invalid) {
+		throw std::runtime_error("OBJ file " + path + " references a vertex that doesn't exist");
+	}
+	return mesh;
+}
+
+} // ph
@@ -0,0 +1,292 @@
+//
+// Created by Fatih on 9/11/2022.
+//
+
+#include "graphics/vulkan/RayQueryAccel.hpp"
+#include "graphics/accel/BVH.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace ph {
+
+const std::vector<const char*> RayQueryAccel::EXTENSIONS = {
+		VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
+		VK_KHR_RAY_QUERY_EXTENSION_NAME,
+		VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME
+};
+
+// BLAS geometry i holds the primitives of this type, the shader turns the geometry index back into the tag
+static constexpr PrimitiveType GEOMETRY_TYPES[RayQueryAccel::GEOMETRY_COUNT] = {PrimitiveType::Sphere, PrimitiveType::Box, PrimitiveType::SpotLight};
+
+template<typename T>
+static T deviceFunction(VkDevice device, const char* name) {
+	auto func = reinterpret_cast<T>(vkGetDeviceProcAddr(device, name));
+	if (func == nullptr)
+		throw std::runtime_error(std::string("Failed to load device function ") + name);
+	return func;
+}
+
+void RayQueryAccel::init(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator allocator) {
+	m_device = device;
+	m_allocator = allocator;
+
+	m_createAccelerationStructure = deviceFunction<PFN_vkCreateAccelerationStructureKHR>(device, "vkCreateAccelerationStructureKHR");
+	m_destroyAccelerationStructure = deviceFunction<PFN_vkDestroyAccelerationStructureKHR>(device, "vkDestroyAccelerationStructureKHR");
+	m_getBuildSizes = deviceFunction<PFN_vkGetAccelerationStructureBuildSizesKHR>(device, "vkGetAccelerationStructureBuildSizesKHR");
+	m_cmdBuildAccelerationStructures = deviceFunction<PFN_vkCmdBuildAccelerationStructuresKHR>(device, "vkCmdBuildAccelerationStructuresKHR");
+	m_getAccelerationStructureAddress = deviceFunction<PFN_vkGetAccelerationStructureDeviceAddressKHR>(device, "vkGetAccelerationStructureDeviceAddressKHR");
+
+	VkPhysicalDeviceAccelerationStructurePropertiesKHR accelProperties{};
+	accelProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &accelProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+	m_scratchAlignment = accelProperties.minAccelerationStructureScratchOffsetAlignment;
+
+	// one instance, the TLAS never has to grow
+	createBuffer(m_instance, sizeof(VkAccelerationStructureInstanceKHR), VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR, true);
+
+	auto geometry = instanceGeometry();
+	VkAccelerationStructureBuildGeometryInfoKHR info{};
+	buildInfo(info, m_tlas, &geometry, 1, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, Build::Full);
+
+	uint32_t instanceCount = 1;
+	VkAccelerationStructureBuildSizesInfoKHR sizes{};
+	sizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+	m_getBuildSizes(m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &info, &instanceCount, &sizes);
+	reserve(m_tlas, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, sizes.accelerationStructureSize);
+	m_tlasScratchSize = sizes.buildScratchSize;
+}
+
+void RayQueryAccel::markDirty(bool rebuild) {
+	m_dirty = true;
+	m_rebuild = m_rebuild || rebuild;
+}
+
+void RayQueryAccel::prepare(const PrimitiveStream& stream) {
+	if (!m_dirty) return;
+	m_dirty = false;
+
+	uint32_t counts[GEOMETRY_COUNT];
+	m_hostAabbs.clear();
+	for (uint32_t i = 0; i < GEOMETRY_COUNT; ++i) {
+		const auto& range = stream.m_info.types[uint32_t(GEOMETRY_TYPES[i])];
+		counts[i] = range.count;
+
+		for (uint32_t j = 0; j < range.count; ++j) {
+			const glm::vec4* words = stream.m_payload.data() + range.payloadOffset + j * range.stride;
+			// spheres are center and radius, boxes min and max, spot lights position first and radius last
+			glm::vec3 min, max;
+			switch (GEOMETRY_TYPES[i]) {
+				case PrimitiveType::Sphere:
+					min = glm::vec3(words[0]) - words[0].w;
+					max = glm::vec3(words[0]) + words[0].w;
+					break;
+				case PrimitiveType::SpotLight:
+					min = glm::vec3(words[0]) - words[1].w;
+					max = glm::vec3(words[0]) + words[1].w;
+					break;
+				default:
+					min = glm::vec3(words[0]);
+					max = glm::vec3(words[1]);
+					break;
+			}
+			m_hostAabbs.push_back({min.x, min.y, min.z, max.x, max.y, max.z});
+		}
+	}
+
+	// refits need the exact primitive counts of the last build
+	bool rebuild = m_rebuild || m_refits >= MAX_REFITS || m_blas.handle == VK_NULL_HANDLE || !std::equal(counts, counts + GEOMETRY_COUNT, m_counts);
+	m_rebuild = false;
+	std::copy(counts, counts + GEOMETRY_COUNT, m_counts);
+
+	size_t aabbSize = std::max<size_t>(m_hostAabbs.size(), 1) * sizeof(VkAabbPositionsKHR);
+	if (m_aabbs.size < aabbSize) {
+		destroyBuffer(m_aabbs);
+		createBuffer(m_aabbs, aabbSize, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR, true);
+	}
+	if (!m_hostAabbs.empty()) copyMemory(m_aabbs, m_hostAabbs.data(), m_hostAabbs.size() * sizeof(VkAabbPositionsKHR));
+
+	// a build that didn't get recorded yet can't be downgraded to a refit
+	m_pending = std::max(m_pending, rebuild ? Build::Full : Build::Refit);
+	if (!rebuild) return;
+
+	VkAccelerationStructureGeometryKHR geometries[GEOMETRY_COUNT];
+	VkAccelerationStructureBuildRangeInfoKHR ranges[GEOMETRY_COUNT];
+	blasGeometries(geometries, ranges);
+	VkAccelerationStructureBuildGeometryInfoKHR info{};
+	buildInfo(info, m_blas, geometries, GEOMETRY_COUNT, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, Build::Full);
+
+	VkAccelerationStructureBuildSizesInfoKHR sizes{};
+	sizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+	m_getBuildSizes(m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &info, m_counts, &sizes);
+
+	if (reserve(m_blas, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizes.accelerationStructureSize)) {
+		VkAccelerationStructureDeviceAddressInfoKHR addressInfo{};
+		addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+		addressInfo.accelerationStructure = m_blas.handle;
+
+		VkAccelerationStructureInstanceKHR instance{};
+		instance.transform.matrix[0][0] = instance.transform.matrix[1][1] = instance.transform.matrix[2][2] = 1.0f;
+		instance.mask = 0xFF;
+		instance.accelerationStructureReference = m_getAccelerationStructureAddress(m_device, &addressInfo);
+		copyMemory(m_instance, &instance, sizeof(instance));
+	}
+
+	// the BLAS and TLAS builds run one after the other and share the scratch buffer
+	VkDeviceSize scratchSize = std::max({sizes.buildScratchSize, sizes.updateScratchSize, m_tlasScratchSize});
+	if (m_scratch.size < scratchSize) {
+		destroyBuffer(m_scratch);
+		createBuffer(m_scratch, scratchSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false, m_scratchAlignment);
+	}
+}
+
+void RayQueryAccel::record(VkCommandBuffer buffer) {
+	if (m_pending == Build::None) return;
+
+	VkAccelerationStructureGeometryKHR geometries[GEOMETRY_COUNT];
+	VkAccelerationStructureBuildRangeInfoKHR ranges[GEOMETRY_COUNT];
+	blasGeometries(geometries, ranges);
+	VkAccelerationStructureBuildGeometryInfoKHR blasInfo{};
+	buildInfo(blasInfo, m_blas, geometries, GEOMETRY_COUNT, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, m_pending);
+	const VkAccelerationStructureBuildRangeInfoKHR* blasRanges = ranges;
+	m_cmdBuildAccelerationStructures(buffer, 1, &blasInfo, &blasRanges);
+
+	// the TLAS build reads the BLAS and reuses the scratch memory
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+						 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// rebuilt every time, it is a single instance and its bounds follow the BLAS
+	auto instances = instanceGeometry();
+	VkAccelerationStructureBuildGeometryInfoKHR tlasInfo{};
+	buildInfo(tlasInfo, m_tlas, &instances, 1, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, Build::Full);
+	VkAccelerationStructureBuildRangeInfoKHR tlasRange{1, 0, 0, 0};
+	const VkAccelerationStructureBuildRangeInfoKHR* tlasRanges = &tlasRange;
+	m_cmdBuildAccelerationStructures(buffer, 1, &tlasInfo, &tlasRanges);
+
+	barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+	vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	m_refits = m_pending == Build::Refit ? m_refits + 1 : 0;
+	m_pending = Build::None;
+}
+
+void RayQueryAccel::cleanup() {
+	for (auto* structure : {&m_blas, &m_tlas}) {
+		if (structure->handle != VK_NULL_HANDLE) m_destroyAccelerationStructure(m_device, structure->handle, nullptr);
+		structure->handle = VK_NULL_HANDLE;
+		destroyBuffer(structure->storage);
+	}
+	destroyBuffer(m_aabbs);
+	destroyBuffer(m_instance);
+	destroyBuffer(m_scratch);
+}
+
+void RayQueryAccel::createBuffer(AccelBuffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, bool hostVisible, VkDeviceSize alignment) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	bufferInfo.usage = usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	allocInfo.minAlignment = alignment;
+	if (hostVisible) {
+		allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+		allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	} else {
+		allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	}
+
+	auto result = vmaCreateBuffer(m_allocator, &bufferInfo, &allocInfo, &buffer.handle, &buffer.alloc, nullptr);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create acceleration structure buffer ! (error code " + std::to_string(result) + ")");
+
+	VkBufferDeviceAddressInfo addressInfo{};
+	addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+	addressInfo.buffer = buffer.handle;
+	buffer.address = vkGetBufferDeviceAddress(m_device, &addressInfo);
+	buffer.size = size;
+}
+
+void RayQueryAccel::destroyBuffer(AccelBuffer& buffer) {
+	if (buffer.handle != VK_NULL_HANDLE) vmaDestroyBuffer(m_allocator, buffer.handle, buffer.alloc);
+	buffer = {};
+}
+
+bool RayQueryAccel::reserve(Structure& structure, VkAccelerationStructureTypeKHR type, VkDeviceSize size) {
+	if (structure.handle != VK_NULL_HANDLE && structure.storage.size >= size) return false;
+
+	if (structure.handle != VK_NULL_HANDLE) m_destroyAccelerationStructure(m_device, structure.handle, nullptr);
+	destroyBuffer(structure.storage);
+	createBuffer(structure.storage, size, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR, false);
+
+	VkAccelerationStructureCreateInfoKHR info{};
+	info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+	info.buffer = structure.storage.handle;
+	info.size = size;
+	info.type = type;
+	auto result = m_createAccelerationStructure(m_device, &info, nullptr, &structure.handle);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create acceleration structure ! (error code " + std::to_string(result) + ")");
+	return true;
+}
+
+void RayQueryAccel::blasGeometries(VkAccelerationStructureGeometryKHR* geometries, VkAccelerationStructureBuildRangeInfoKHR* ranges) const {
+	uint32_t first = 0;
+	for (uint32_t i = 0; i < GEOMETRY_COUNT; ++i) {
+		geometries[i] = {};
+		geometries[i].sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+		geometries[i].geometryType = VK_GEOMETRY_TYPE_AABBS_KHR;
+		geometries[i].geometry.aabbs.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_AABBS_DATA_KHR;
+		geometries[i].geometry.aabbs.data.deviceAddress = m_aabbs.address;
+		geometries[i].geometry.aabbs.stride = sizeof(VkAabbPositionsKHR);
+
+		ranges[i] = {m_counts[i], uint32_t(first * sizeof(VkAabbPositionsKHR)), 0, 0};
+		first += m_counts[i];
+	}
+}
+
+VkAccelerationStructureGeometryKHR RayQueryAccel::instanceGeometry() const {
+	VkAccelerationStructureGeometryKHR geometry{};
+	geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+	geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+	geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+	geometry.geometry.instances.data.deviceAddress = m_instance.address;
+	return geometry;
+}
+
+void RayQueryAccel::buildInfo(VkAccelerationStructureBuildGeometryInfoKHR& info, const Structure& structure, const VkAccelerationStructureGeometryKHR* geometries,
+							  uint32_t geometryCount, VkAccelerationStructureTypeKHR type, Build build) const {
+	info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+	info.type = type;
+	info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+	if (type == VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR) info.flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+	info.mode = build == Build::Refit ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+	info.srcAccelerationStructure = build == Build::Refit ? structure.handle : VK_NULL_HANDLE;
+	info.dstAccelerationStructure = structure.handle;
+	info.geometryCount = geometryCount;
+	info.pGeometries = geometries;
+	info.scratchData.deviceAddress = m_scratch.address;
+}
+
+void RayQueryAccel::copyMemory(const AccelBuffer& buffer, const void* data, size_t size) const {
+	void* mapped = nullptr;
+	if (vmaMapMemory(m_allocator, buffer.alloc, &mapped) != VK_SUCCESS)
+		throw std::runtime_error("Failed to map memory for acceleration structure buffer !");
+
+	std::memcpy(mapped, data, size);
+	vmaUnmapMemory(m_allocator, buffer.alloc);
+}
+
+} // ph
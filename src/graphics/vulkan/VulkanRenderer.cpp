@@ -4,6 +4,9 @@
 
 #include "graphics/vulkan/VulkanRenderer.hpp"
 #include "graphics/vulkan/VulkanTypes.hpp"
+#include "graphics/accel/BVH.hpp"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <vulkan/vulkan_core.h>
 #include <vulkan/vulkan_enums.hpp>
@@ -12,6 +15,46 @@
 
 namespace ph {
 
+// resolves #include "..." relative to the including shader
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
+	struct Include {
+		std::string name;
+		std::string content;
+		shaderc_include_result result;
+	};
+
+public:
+	shaderc_include_result* GetInclude(const char* requested, shaderc_include_type, const char* requesting, size_t) override {
+		std::string path = requested;
+		std::string parent = requesting;
+		auto slash = parent.find_last_of("/\\");
+		if (slash != std::string::npos) path = parent.substr(0, slash + 1) + path;
+
+		auto include = new Include{path, {}, {}};
+		std::ifstream file(path);
+		if (file.is_open()) {
+			std::stringstream buffer;
+			buffer << file.rdbuf();
+			include->content = buffer.str();
+		} else {
+			include->name.clear(); // an empty name reports the failure
+			include->content = "Failed to open include file: " + path;
+		}
+
+		include->result = {include->name.data(), include->name.size(), include->content.data(), include->content.size(), include};
+		return &include->result;
+	}
+
+	void ReleaseInclude(shaderc_include_result* data) override {
+		delete static_cast<Include*>(data->user_data);
+	}
+};
+
+// buffers without host data are only ever written on the device
+static VkMemoryPropertyFlags storageMemoryFlags(const vkt::StorageData& data) {
+	return data.data != nullptr ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+}
+
 VulkanRenderer::VulkanRenderer(SDL_Window* window, const vk::Extent2D extent, const std::string& appName) : m_window(window), m_windowExtent(extent) {
 	vkb::InstanceBuilder builder;
 	builder.set_app_name(appName.data())
@@ -42,8 +85,40 @@ VulkanRenderer::VulkanRenderer(SDL_Window* window, const vk::Extent2D extent, co
 	}
 	m_surface = vk::UniqueSurfaceKHR(surface, {m_instance.get()});
 
-	vkb::PhysicalDeviceSelector selector(build.value(), m_surface.get());
-	vkb::PhysicalDevice physicalDevice = selector.set_minimum_version(1, 3).select().value();
+	// sphere buffers are read with the scalar block layout
+	VkPhysicalDeviceVulkan12Features features12{};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features12.scalarBlockLayout = VK_TRUE;
+	auto selectDevice = [&](const VkPhysicalDeviceVulkan12Features& features) {
+		vkb::PhysicalDeviceSelector selector(build.value(), m_surface.get());
+		return selector.set_minimum_version(1, 3).set_required_features_12(features);
+	};
+
+	// prefer a device that can trace with ray queries, the acceleration structures are built from device addresses
+	VkPhysicalDeviceVulkan12Features rayQueryFeatures12 = features12;
+	rayQueryFeatures12.bufferDeviceAddress = VK_TRUE;
+	VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures{};
+	accelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+	accelerationStructureFeatures.accelerationStructure = VK_TRUE;
+	VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures{};
+	rayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+	rayQueryFeatures.rayQuery = VK_TRUE;
+	auto selection = selectDevice(rayQueryFeatures12)
+			.add_required_extensions(RayQueryAccel::EXTENSIONS)
+			.add_required_extension_features(accelerationStructureFeatures)
+			.add_required_extension_features(rayQueryFeatures)
+			.select();
+
+	m_rayQuery = selection.has_value();
+	if (!m_rayQuery) {
+		selection = selectDevice(features12).select();
+		if (!selection.has_value()) {
+			throw std::runtime_error("Failed to find a suitable vulkan device (" + selection.error().message() + ")");
+		}
+	}
+	std::cout << "Ray query backend: " << (m_rayQuery ? "enabled" : "unavailable, using the compute traversal") << std::endl;
+
+	vkb::PhysicalDevice physicalDevice = selection.value();
 	vkb::DeviceBuilder deviceBuilder(physicalDevice);
 	vkb::Device vkbDevice = deviceBuilder.build().value();
 
@@ -51,6 +126,7 @@ VulkanRenderer::VulkanRenderer(SDL_Window* window, const vk::Extent2D extent, co
 	m_physicalDevice = physicalDevice.physical_device;
 
 	VmaAllocatorCreateInfo allocatorInfo = {};
+	if (m_rayQuery) allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
 	allocatorInfo.instance = m_instance.get();
 	allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
 	allocatorInfo.device = m_device.get();
@@ -65,6 +141,22 @@ VulkanRenderer::VulkanRenderer(SDL_Window* window, const vk::Extent2D extent, co
 
 	createQueue(&m_presentQueue, m_device->getQueue(m_presentQueue.family, 0));
 	createQueue(&m_computeQueue, m_device->getQueue(m_computeQueue.family, 0));
+
+	if (m_rayQuery) m_rayQueryAccel.init(m_device.get(), m_physicalDevice, m_allocator);
+
+	// two timestamps around the compute commands of a frame, see readTimestamps
+	auto limits = m_physicalDevice.getProperties().limits;
+	if (limits.timestampComputeAndGraphics) {
+		m_timestampPool = m_device->createQueryPoolUnique(vk::QueryPoolCreateInfo({}, vk::QueryType::eTimestamp, 2));
+		m_timestampPeriod = limits.timestampPeriod;
+	}
+
+	// the trace shader always reads the stream, even before any type is registered
+	addBuffer(PrimitiveStream::PAYLOAD_BINDING, 0, nullptr);
+	addBuffer(PrimitiveStream::MATERIAL_BINDING, 0, nullptr);
+	addBuffer(PrimitiveStream::INFO_BINDING, 0, nullptr);
+	addBuffer(PrimitiveStream::UNBOUNDED_BINDING, 0, nullptr);
+	uploadPrimitives();
 }
 
 void VulkanRenderer::postInitialize() {
@@ -82,11 +174,6 @@ void VulkanRenderer::resize(const VkExtent2D extent) {
 }
 
 void VulkanRenderer::render() {
-	m_pushConstants.update(m_allocator);
-	for (const auto& data : m_storageDataSet) {
-		data.update(m_allocator);
-	}
-
 	m_frameCounter++;
 	auto currentTicks = SDL_GetTicks64();
 	if (currentTicks - m_lastTicks >= 1000) {
@@ -100,6 +187,12 @@ void VulkanRenderer::render() {
 		vk::detail::throwResultException(result, "Failed to wait for fences");
 	}
 
+	// buffers are only touched once the previous frame is done with them
+	readCounters();
+	readTimestamps();
+	if (uploadStorageBuffers()) resetAccumulation();
+	if (m_rayQuery) m_rayQueryAccel.prepare(m_primitives);
+
 	auto r2 = m_device->acquireNextImageKHR(m_swapchain.handle.get(), UINT64_MAX, m_imageAcquiredSemaphore.get());
 	result = r2.result;
 	m_swapchain.currentFrame = r2.value;
@@ -111,6 +204,8 @@ void VulkanRenderer::render() {
 	}
 
 	recordComputeCommands();
+	m_frameConstants.accumulatedFrames++;
+	m_frameConstants.frameIndex++;
 	m_device->resetFences(m_computeFence.get());
 
 	vk::PipelineStageFlags waitStages = vk::PipelineStageFlagBits::eTopOfPipe;
@@ -132,7 +227,9 @@ void VulkanRenderer::render() {
 void VulkanRenderer::cleanup() {
 	m_device->waitIdle();
 
-	vmaDestroyImage(m_allocator, m_computeImage.handle, m_computeImage.alloc);
+	destroyStorageImage(m_computeImage);
+	destroyStorageImage(m_accumulationImage);
+	if (m_rayQuery) m_rayQueryAccel.cleanup();
 	for (auto& data : m_storageDataSet) {
 		vmaDestroyBuffer(m_allocator, data.buffer.handle, data.buffer.alloc);
 	}
@@ -142,6 +239,32 @@ void VulkanRenderer::cleanup() {
 	vmaDestroyAllocator(m_allocator);
 }
 
+void VulkanRenderer::resetAccumulation() {
+	m_frameConstants.accumulatedFrames = 0;
+}
+
+void VulkanRenderer::setRenderScale(float scale) {
+	scale = std::clamp(scale, MIN_RENDER_SCALE, 1.0f);
+	if (scale == m_renderScale) return;
+
+	m_renderScale = scale;
+	updateRenderExtent();
+	// the accumulation holds pixels of the old size
+	resetAccumulation();
+}
+
+VkExtent2D VulkanRenderer::renderExtent() const {
+	return {m_renderExtent.width, m_renderExtent.height};
+}
+
+void VulkanRenderer::updateRenderExtent() {
+	m_renderExtent.width = std::clamp(uint32_t(std::lround(m_swapchain.extent.width * m_renderScale)), 1u, m_swapchain.extent.width);
+	m_renderExtent.height = std::clamp(uint32_t(std::lround(m_swapchain.extent.height * m_renderScale)), 1u, m_swapchain.extent.height);
+	m_swapchain.dispatchSize = {(m_renderExtent.width + 7) / 8, (m_renderExtent.height + 7) / 8, 1};
+	m_frameConstants.renderWidth = m_renderExtent.width;
+	m_frameConstants.renderHeight = m_renderExtent.height;
+}
+
 void VulkanRenderer::addBuffer(uint32_t index, size_t size, void* data) {
 	m_storageDataSet.push_back(vkt::StorageData{
 			{},
@@ -162,12 +285,70 @@ void VulkanRenderer::addUniform(uint32_t index, size_t size, void* data) {
 	});
 }
 
+void VulkanRenderer::addCounters(uint32_t index, size_t size, void* data) {
+	addBuffer(index, size, data);
+	m_storageDataSet.back().counters = true;
+}
+
+vkt::StorageData& VulkanRenderer::findStorage(uint32_t index) {
+	for (auto& storage : m_storageDataSet) {
+		if (storage.binding.index == index) return storage;
+	}
+	throw std::runtime_error("No buffer bound at index " + std::to_string(index));
+}
+
+void VulkanRenderer::updateBuffer(uint32_t index, size_t size, void* data) {
+	auto& storage = findStorage(index);
+	storage.size = size;
+	storage.data = data;
+	storage.markDirty(0, size);
+}
+
+void VulkanRenderer::markDirty(uint32_t index, size_t offset, size_t size) {
+	findStorage(index).markDirty(offset, size);
+}
+
 void VulkanRenderer::setPushConstants(uint32_t offset, size_t size, void* data) {
 	m_pushConstants.offset = offset;
 	m_pushConstants.size = size;
 	m_pushConstants.data = data;
 }
 
+void VulkanRenderer::addComputePass(const ComputePassInfo& info) {
+	m_computePasses.push_back(vkt::ComputePass{info, {}});
+}
+
+void VulkanRenderer::addPrimitiveType(uint32_t tag, uint32_t stride, bool unbounded) {
+	m_primitives.addType(tag, stride, unbounded);
+	uploadPrimitives();
+}
+
+void VulkanRenderer::setPrimitives(uint32_t tag, size_t count, const void* payload, const uint32_t* materials) {
+	m_primitives.set(tag, count, static_cast<const glm::vec4*>(payload), materials);
+	uploadPrimitives();
+	if (tag == uint32_t(PrimitiveType::Sphere) || tag == uint32_t(PrimitiveType::Box) || tag == uint32_t(PrimitiveType::SpotLight)) m_rayQueryAccel.markDirty(true);
+}
+
+void VulkanRenderer::updatePrimitives(uint32_t tag, uint32_t first, uint32_t last, const void* payload) {
+	if (first >= last) return;
+	auto [offset, size] = m_primitives.update(tag, first, last, static_cast<const glm::vec4*>(payload));
+	markDirty(PrimitiveStream::PAYLOAD_BINDING, offset, size);
+	if (tag == uint32_t(PrimitiveType::Sphere) || tag == uint32_t(PrimitiveType::Box) || tag == uint32_t(PrimitiveType::SpotLight)) m_rayQueryAccel.markDirty(false);
+}
+
+// empty arrays still get a one element buffer, the info block bounds every read
+template<typename T>
+static void updateArray(Renderer* renderer, uint32_t index, std::vector<T>& data) {
+	renderer->updateBuffer(index, std::max(sizeof(T) * data.size(), sizeof(T)), data.empty() ? nullptr : data.data());
+}
+
+void VulkanRenderer::uploadPrimitives() {
+	updateArray(this, PrimitiveStream::PAYLOAD_BINDING, m_primitives.m_payload);
+	updateArray(this, PrimitiveStream::MATERIAL_BINDING, m_primitives.m_materials);
+	updateArray(this, PrimitiveStream::UNBOUNDED_BINDING, m_primitives.m_unboundedRefs);
+	updateBuffer(PrimitiveStream::INFO_BINDING, sizeof(PrimitiveStreamInfo), &m_primitives.m_info);
+}
+
 std::vector<uint32_t> VulkanRenderer::compileShader(const std::string& filename) {
 	std::ifstream file(filename);
 
@@ -179,7 +360,12 @@ std::vector<uint32_t> VulkanRenderer::compileShader(const std::string& filename)
 	file.close();
 
 	shaderc::Compiler compiler;
-	auto result = compiler.CompileGlslToSpv(buffer.str(), shaderc_shader_kind::shaderc_compute_shader, filename.data());
+	shaderc::CompileOptions options;
+	options.SetIncluder(std::make_unique<ShaderIncluder>());
+	// ray queries need SPIR-V 1.4, the device is 1.3 anyway
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+	if (m_rayQuery) options.AddMacroDefinition("RAY_QUERY");
+	auto result = compiler.CompileGlslToSpv(buffer.str(), shaderc_shader_kind::shaderc_compute_shader, filename.data(), options);
 	// success
 	if (result.GetCompilationStatus() == 0) {
 		return { result.begin(), result.end() };
@@ -189,12 +375,53 @@ std::vector<uint32_t> VulkanRenderer::compileShader(const std::string& filename)
 }
 
 void VulkanRenderer::prepareStorageBuffers() {
+	// indirect dispatches read their workgroup counts straight from a storage buffer
+	for (auto& pass : m_computePasses) {
+		if (pass.info.indirectBinding >= 0) findStorage(uint32_t(pass.info.indirectBinding)).usageFlags |= vk::BufferUsageFlagBits::eIndirectBuffer;
+	}
+
 	if (m_pushConstants.data != nullptr) {
 		createStorageBuffer(m_pushConstants.data, m_pushConstants.size, m_pushConstants.buffer, vk::BufferUsageFlagBits::eStorageBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 	}
 
 	for (auto& data: m_storageDataSet) {
-		createStorageBuffer(data.data, data.size, data.buffer, data.usageFlags, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		createStorageBuffer(data.data, data.size, data.buffer, data.usageFlags, storageMemoryFlags(data), data.counters);
+	}
+}
+
+bool VulkanRenderer::uploadStorageBuffers() {
+	m_pushConstants.update(m_allocator);
+
+	bool changed = false;
+	for (auto& data : m_storageDataSet) {
+		if (data.buffer.info.range != data.size || data.buffer.memoryFlags != storageMemoryFlags(data)) {
+			changed = true;
+			vmaDestroyBuffer(m_allocator, data.buffer.handle, data.buffer.alloc);
+			createStorageBuffer(data.data, data.size, data.buffer, data.usageFlags, storageMemoryFlags(data), data.counters);
+
+			vk::WriteDescriptorSet write(m_computePipeline.descriptorSets[0], data.binding.index, 0, data.binding.descriptorType, {}, data.buffer.info);
+			m_device->updateDescriptorSets(write, {});
+			data.dirtyBegin = data.dirtyEnd = 0;
+		} else {
+			changed = changed || data.dirtyBegin < data.dirtyEnd;
+			data.update(m_allocator);
+		}
+	}
+	return changed;
+}
+
+void VulkanRenderer::readCounters() {
+	for (auto& data : m_storageDataSet) {
+		if (data.counters && data.data != nullptr) data.buffer.readAndClear(m_allocator, data.data, data.size);
+	}
+}
+
+void VulkanRenderer::readTimestamps() {
+	if (!m_timestampPool || !m_timestampsWritten) return;
+
+	auto timestamps = m_device->getQueryPoolResults<uint64_t>(m_timestampPool.get(), 0, 2, 2 * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+	if (timestamps.result == vk::Result::eSuccess) {
+		m_gpuTime = float(double(timestamps.value[1] - timestamps.value[0]) * m_timestampPeriod * 1e-6);
 	}
 }
 
@@ -227,7 +454,9 @@ void VulkanRenderer::createSwapchain() {
 	std::cout << vk::to_string(m_swapchain.imageFormat) << std::endl;
 
 	m_swapchain.extent = value.extent;
-	m_swapchain.dispatchSize = { ceil(m_swapchain.extent.width / 8), ceil(m_swapchain.extent.height / 8), 1 };
+	updateRenderExtent();
+	// the compute image is recreated along with the swapchain, nothing of the old size is left to present
+	m_presentedExtent = m_renderExtent;
 
 	const auto imgs = value.get_images().value();
 	const auto views = value.get_image_views().value();
@@ -248,10 +477,13 @@ void VulkanRenderer::recreateSwapchain() {
 
 	m_computePipeline.descriptorSets.clear();
 	m_computePipeline.descriptorPool.reset();
+	for (auto& pass : m_computePasses) {
+		pass.handle.reset();
+	}
 	m_computePipeline.layout.reset();
 	m_computePipeline.handle.reset();
-	m_computeImage.views.clear();
-	vmaDestroyImage(m_allocator, m_computeImage.handle, m_computeImage.alloc);
+	destroyStorageImage(m_computeImage);
+	destroyStorageImage(m_accumulationImage);
 	m_swapchain.handle.reset();
 
 	createSwapchain();
@@ -270,41 +502,54 @@ void VulkanRenderer::createQueue(vkt::Queue* const q, const vk::Queue& queue) co
 }
 
 void VulkanRenderer::createComputeImage() {
+	createStorageImage(m_computeImage, m_swapchain.imageFormat, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc);
+	createStorageImage(m_accumulationImage, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eStorage);
+	// a new image holds no history
+	resetAccumulation();
+}
+
+void VulkanRenderer::createStorageImage(vkt::Image& image, vk::Format format, vk::ImageUsageFlags usage) {
 	VkImageCreateInfo info{};
 	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	info.imageType = VK_IMAGE_TYPE_2D;
-	info.format = (VkFormat)m_swapchain.imageFormat;
+	info.format = (VkFormat)format;
 	info.extent = {m_swapchain.extent.width, m_swapchain.extent.height, 1};
 	info.mipLevels = 1;
 	info.arrayLayers = 1;
 	info.samples = VK_SAMPLE_COUNT_1_BIT;
 	info.tiling = VK_IMAGE_TILING_OPTIMAL;
 	info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	info.usage = (VkImageUsageFlags)usage;
 
 	VmaAllocationCreateInfo allocInfo = {};
 	allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
 	allocInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
 	allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-	VkImage image;
-	auto result = vmaCreateImage(m_allocator, &info, &allocInfo, &image, &m_computeImage.alloc, nullptr);
+	VkImage handle;
+	auto result = vmaCreateImage(m_allocator, &info, &allocInfo, &handle, &image.alloc, nullptr);
 	if (result != VK_SUCCESS)
 		throw std::runtime_error("Failed to create compute image ! (error code " + std::to_string(result) + ")");
 
-	m_computeImage.handle = image;
+	image.handle = handle;
 
 	vk::ImageViewCreateInfo viewInfo(
 			{},
-			m_computeImage.handle,
+			image.handle,
 			vk::ImageViewType::e2D,
-			m_swapchain.imageFormat,
+			format,
 			vk::ComponentMapping(vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG, vk::ComponentSwizzle::eB, vk::ComponentSwizzle::eA),
 			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)
 			);
 
-	m_computeImage.views.push_back(m_device->createImageViewUnique(viewInfo));
-	m_computeImage.barrier.init(m_computeImage.handle, vk::ImageLayout::eUndefined, vk::AccessFlagBits::eNone, m_computeQueue.family);
+	image.views.push_back(m_device->createImageViewUnique(viewInfo));
+	image.barrier.init(image.handle, vk::ImageLayout::eUndefined, vk::AccessFlagBits::eNone, m_computeQueue.family);
+	image.barrier.range(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+}
+
+void VulkanRenderer::destroyStorageImage(vkt::Image& image) {
+	image.views.clear();
+	vmaDestroyImage(m_allocator, image.handle, image.alloc);
 }
 
 void VulkanRenderer::createRenderPipeline(const std::string& /*shader*/) {
@@ -313,17 +558,22 @@ void VulkanRenderer::createRenderPipeline(const std::string& /*shader*/) {
 
 void VulkanRenderer::createComputePipeline(const std::string& shaderFileName) {
 	auto imageInfo = vk::DescriptorImageInfo({}, m_computeImage.views[0].get(), vk::ImageLayout::eGeneral);
+	auto accumulationInfo = vk::DescriptorImageInfo({}, m_accumulationImage.views[0].get(), vk::ImageLayout::eGeneral);
 	vkt::DescriptorPoolBuilder builder;
-	auto& set = builder.set().bindImage({0, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, imageInfo);
+	auto& set = builder.set().bindImage({0, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, imageInfo)
+			.bindImage({ACCUMULATION_BINDING, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute}, accumulationInfo);
 	for (auto& data: m_storageDataSet) {
 		set.bindBuffer({data.binding.index, data.binding.descriptorType, 1, data.binding.stageFlags}, data.buffer.info);
 	}
+	if (m_rayQuery) {
+		set.bindAccelerationStructure({RayQueryAccel::TLAS_BINDING, vk::DescriptorType::eAccelerationStructureKHR, 1, vk::ShaderStageFlagBits::eCompute}, m_rayQueryAccel.tlas());
+	}
 	set.build(m_device.get(), {});
 	std::vector<vk::DescriptorSetLayout> layouts;
 	std::vector<vk::PushConstantRange> constantRanges;
 	layouts.push_back(set.layout);
 	if (m_pushConstants.data != nullptr) {
-		constantRanges.emplace_back(m_pushConstants.stageFlags, m_pushConstants.offset, m_pushConstants.size);
+		constantRanges.emplace_back(m_pushConstants.stageFlags, m_pushConstants.offset, uint32_t(m_pushConstants.size + sizeof(FrameConstants)));
 	}
 
 	builder.build(m_device.get(), m_computePipeline, 5);
@@ -337,11 +587,79 @@ void VulkanRenderer::createComputePipeline(const std::string& shaderFileName) {
 	vk::ComputePipelineCreateInfo pipelineInfo({}, stageInfo, m_computePipeline.layout.get());
 
 	m_computePipeline.handle = m_device->createComputePipelineUnique(m_computePipeline.cache.get(), pipelineInfo).value;
+
+	createComputePasses();
+}
+
+void VulkanRenderer::createComputePasses() {
+	for (auto& pass : m_computePasses) {
+		auto shaderData = compileShader(pass.info.shader);
+		auto module = m_device->createShaderModuleUnique(vk::ShaderModuleCreateInfo({}, shaderData));
+
+		std::vector<vk::SpecializationMapEntry> entries;
+		for (uint32_t i = 0; i < pass.info.constants.size(); ++i) {
+			entries.emplace_back(i, uint32_t(i * sizeof(uint32_t)), sizeof(uint32_t));
+		}
+		vk::SpecializationInfo specialization(uint32_t(entries.size()), entries.data(), pass.info.constants.size() * sizeof(uint32_t), pass.info.constants.data());
+
+		vk::PipelineShaderStageCreateInfo stageInfo({}, vk::ShaderStageFlagBits::eCompute, module.get(), "main", entries.empty() ? nullptr : &specialization);
+		vk::ComputePipelineCreateInfo pipelineInfo({}, stageInfo, m_computePipeline.layout.get());
+
+		pass.handle = m_device->createComputePipelineUnique(m_computePipeline.cache.get(), pipelineInfo).value;
+	}
+}
+
+void VulkanRenderer::recordComputePasses(const vk::CommandBuffer& buffer, PassStage stage) {
+	for (size_t i = 0; i < m_computePasses.size();) {
+		auto& first = m_computePasses[i].info;
+		size_t end = std::min(i + std::max(first.loopLength, 1u), m_computePasses.size());
+
+		if (first.stage == stage && first.enabled()) {
+			uint32_t iterations = first.iterations();
+			for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+				m_frameConstants.loopIteration = iteration;
+				for (size_t j = i; j < end; ++j) {
+					recordComputePass(buffer, m_computePasses[j]);
+				}
+			}
+			m_frameConstants.loopIteration = 0;
+		}
+		i = end;
+	}
+}
+
+void VulkanRenderer::recordComputePass(const vk::CommandBuffer& buffer, vkt::ComputePass& pass) {
+	if (!pass.info.enabled()) return;
+
+	std::array<uint32_t, 3> groups{};
+	if (pass.info.indirectBinding < 0) {
+		groups = pass.info.groups();
+		if (groups[0] == 0 || groups[1] == 0 || groups[2] == 0) return;
+	}
+
+	buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pass.handle.get());
+	buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_computePipeline.layout.get(), 0, m_computePipeline.descriptorSets, {});
+	pushConstants(buffer);
+	if (pass.info.indirectBinding >= 0) {
+		auto& args = findStorage(uint32_t(pass.info.indirectBinding));
+		buffer.dispatchIndirect(args.buffer.handle, pass.info.indirectOffset(m_frameConstants.loopIteration));
+	} else {
+		buffer.dispatch(groups[0], groups[1], groups[2]);
+	}
+
+	// the next pass may read what this one wrote, including its own indirect arguments
+	vkt::MemoryBarrier(vk::AccessFlagBits::eShaderWrite)
+			.access(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eIndirectCommandRead)
+			.apply(buffer, vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect);
 }
 
 void VulkanRenderer::recordComputeCommands() {
 	auto& buffer = m_computeQueue.buffers[0];
 	buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eSimultaneousUse));
+	if (m_timestampPool) {
+		buffer.resetQueryPool(m_timestampPool.get(), 0, 2);
+		buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_timestampPool.get(), 0);
+	}
 
 	for (auto& func : m_computeCommands) {
 		func(buffer);
@@ -352,16 +670,53 @@ void VulkanRenderer::recordComputeCommands() {
 	copyImageMemory(buffer);
 	applySecondImageBarriers(buffer);
 
-	// Bind current descriptor set for each image in the swap chain.
-	buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_computePipeline.handle.get());
-	buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_computePipeline.layout.get(), 0, m_computePipeline.descriptorSets, {});
-	if (m_pushConstants.data != nullptr) {
-		buffer.pushConstants(m_computePipeline.layout.get(), m_pushConstants.stageFlags, m_pushConstants.offset, m_pushConstants.size, m_pushConstants.data);
+	recordComputePasses(buffer, PassStage::PreTrace);
+	if (m_rayQuery) m_rayQueryAccel.record(buffer);
+
+	// once in the general layout the history stays there, the trace only reads it back after a first write
+	if (m_accumulationImage.barrier.handle.newLayout != vk::ImageLayout::eGeneral) {
+		m_accumulationImage.barrier.access(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite).layout(vk::ImageLayout::eGeneral)
+				.apply(buffer, vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader);
+	}
+
+	bool traceReplaced = std::any_of(m_computePasses.begin(), m_computePasses.end(), [](const auto& pass) {
+		return pass.info.stage == PassStage::Trace && pass.info.enabled();
+	});
+	if (traceReplaced) {
+		recordComputePasses(buffer, PassStage::Trace);
+	} else {
+		// Bind current descriptor set for each image in the swap chain.
+		buffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_computePipeline.handle.get());
+		buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_computePipeline.layout.get(), 0, m_computePipeline.descriptorSets, {});
+		pushConstants(buffer);
+		buffer.dispatch(m_swapchain.dispatchSize.x, m_swapchain.dispatchSize.y, m_swapchain.dispatchSize.z);
+	}
+
+	if (std::any_of(m_computePasses.begin(), m_computePasses.end(), [](const auto& pass) { return pass.info.stage == PassStage::PostTrace; })) {
+		vkt::MemoryBarrier(vk::AccessFlagBits::eShaderWrite).access(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+				.apply(buffer, vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader);
+		recordComputePasses(buffer, PassStage::PostTrace);
+	}
+
+	// counters are read on the host once the fence signals
+	vkt::MemoryBarrier(vk::AccessFlagBits::eShaderWrite).access(vk::AccessFlagBits::eHostRead)
+			.apply(buffer, vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost);
+	if (m_timestampPool) {
+		buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_timestampPool.get(), 1);
+		m_timestampsWritten = true;
 	}
-	buffer.dispatch(m_swapchain.dispatchSize.x, m_swapchain.dispatchSize.y, m_swapchain.dispatchSize.z);
+	// the next frame presents what this one traced
+	m_presentedExtent = m_renderExtent;
 	buffer.end();
 }
 
+void VulkanRenderer::pushConstants(const vk::CommandBuffer& buffer) {
+	if (m_pushConstants.data == nullptr) return;
+
+	buffer.pushConstants(m_computePipeline.layout.get(), m_pushConstants.stageFlags, m_pushConstants.offset, m_pushConstants.size, m_pushConstants.data);
+	buffer.pushConstants(m_computePipeline.layout.get(), m_pushConstants.stageFlags, uint32_t(m_pushConstants.offset + m_pushConstants.size), sizeof(FrameConstants), &m_frameConstants);
+}
+
 void VulkanRenderer::applyFirstImageBarriers(const vk::CommandBuffer& buffer) {
 	const vk::ImageSubresourceRange subresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
 	vkt::ImageMemoryBarrier swapTransfer(m_swapchain.images[m_swapchain.currentFrame], vk::ImageLayout::eUndefined, vk::AccessFlagBits::eMemoryRead, m_presentQueue.family);
@@ -374,9 +729,17 @@ void VulkanRenderer::applyFirstImageBarriers(const vk::CommandBuffer& buffer) {
 
 void VulkanRenderer::copyImageMemory(const vk::CommandBuffer& buffer) const {
 	const vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
-	vk::ImageCopy copy(layers, {0, 0, 0}, layers, {0, 0, 0}, {m_swapchain.extent.width, m_swapchain.extent.height, 1});
+	if (m_presentedExtent == m_swapchain.extent) {
+		vk::ImageCopy copy(layers, {0, 0, 0}, layers, {0, 0, 0}, {m_swapchain.extent.width, m_swapchain.extent.height, 1});
+		buffer.copyImage(m_computeImage.handle, vk::ImageLayout::eTransferSrcOptimal, m_swapchain.images[m_swapchain.currentFrame], vk::ImageLayout::eTransferDstOptimal, copy);
+		return;
+	}
 
-	buffer.copyImage(m_computeImage.handle, vk::ImageLayout::eTransferSrcOptimal, m_swapchain.images[m_swapchain.currentFrame], vk::ImageLayout::eTransferDstOptimal, copy);
+	// a reduced render scale only traced the corner of the compute image, stretched over the window
+	std::array<vk::Offset3D, 2> source{vk::Offset3D{0, 0, 0}, vk::Offset3D{int32_t(m_presentedExtent.width), int32_t(m_presentedExtent.height), 1}};
+	std::array<vk::Offset3D, 2> target{vk::Offset3D{0, 0, 0}, vk::Offset3D{int32_t(m_swapchain.extent.width), int32_t(m_swapchain.extent.height), 1}};
+	vk::ImageBlit blit(layers, source, layers, target);
+	buffer.blitImage(m_computeImage.handle, vk::ImageLayout::eTransferSrcOptimal, m_swapchain.images[m_swapchain.currentFrame], vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
 }
 
 void VulkanRenderer::applySecondImageBarriers(const vk::CommandBuffer& buffer) {
@@ -389,7 +752,7 @@ void VulkanRenderer::applySecondImageBarriers(const vk::CommandBuffer& buffer) {
 	});
 }
 
-void VulkanRenderer::createStorageBuffer(const void* data, size_t size, vkt::Buffer& buffer, vk::BufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryProperties) const {
+void VulkanRenderer::createStorageBuffer(const void* data, size_t size, vkt::Buffer& buffer, vk::BufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryProperties, bool hostRead) const {
 	VkBufferCreateInfo bufferInfo = {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
@@ -397,7 +760,9 @@ void VulkanRenderer::createStorageBuffer(const void* data, size_t size, vkt::Buf
 	bufferInfo.usage = (VkBufferUsageFlags) usageFlags | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 
 	VmaAllocationCreateInfo allocInfo{};
-	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+	if (memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | (hostRead ? VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT : VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+	}
 	allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
 	allocInfo.requiredFlags = memoryProperties;
 
@@ -407,8 +772,9 @@ void VulkanRenderer::createStorageBuffer(const void* data, size_t size, vkt::Buf
 		throw std::runtime_error("Failed to create storage buffer !");
 
 	buffer.handle = buf;
+	buffer.memoryFlags = memoryProperties;
 	buffer.info = vk::DescriptorBufferInfo(buffer.handle, 0, size);
-	buffer.copyMemory(m_allocator, data, size);
+	if (data != nullptr) buffer.copyMemory(m_allocator, data, size);
 }
 
 } // ph
@@ -10,7 +10,7 @@ int main(int argc, char *argv[]) {
 
 	ph::GameInstance game;
 	try {
-		game.init();
+		game.init(argc > 1 ? argv[1] : "");
 		game.run();
 	} catch (const std::exception& e) {
 		std::cout << "ERROR: " << e.what() << std::endl;
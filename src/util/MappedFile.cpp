@@ -0,0 +1,85 @@
+//
+// Created by Fatih on 9/3/2022.
+//
+
+#include "util/MappedFile.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ph {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		m_file = nullptr;
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(m_file, &size);
+	m_size = size_t(size.QuadPart);
+	if (m_size == 0) return;
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping != nullptr) m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr) {
+		if (m_mapping != nullptr) CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		throw std::runtime_error("Failed to map " + path);
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (m_data != nullptr) UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr) CloseHandle(m_mapping);
+	if (m_file != nullptr) CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	struct stat info{};
+	fstat(fd, &info);
+	m_size = size_t(info.st_size);
+	if (m_size == 0) {
+		close(fd);
+		return;
+	}
+
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	close(fd);
+	if (data == MAP_FAILED) {
+		throw std::runtime_error("Failed to map " + path);
+	}
+	// the scene is copied front to back right after mapping
+	madvise(data, m_size, MADV_SEQUENTIAL);
+	madvise(data, m_size, MADV_WILLNEED);
+	m_data = static_cast<const uint8_t*>(data);
+}
+
+MappedFile::~MappedFile() {
+	if (m_data != nullptr) munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+
+#endif
+
+} // ph
@@ -0,0 +1,134 @@
+//
+// Created by Fatih on 8/22/2022.
+//
+
+#include "util/ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace ph {
+
+// index of the queue owned by the current thread, external threads get the shared queue 0
+static thread_local uint32_t t_queueIndex = 0;
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+	threadCount = std::max(1u, threadCount);
+
+	// queue 0 takes work submitted from outside the pool
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		m_queues.push_back(std::make_unique<WorkerQueue>());
+	}
+	for (uint32_t i = 1; i < threadCount; ++i) {
+		m_workers.emplace_back([this, i] { workerLoop(i); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(m_sleepMutex);
+		m_stop = true;
+	}
+	m_wakeUp.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::run(TaskGroup& group, Task task) {
+	group.m_pending.fetch_add(1, std::memory_order_relaxed);
+
+	if (m_workers.empty()) {
+		task();
+		group.m_pending.fetch_sub(1, std::memory_order_release);
+		return;
+	}
+
+	// workers keep their own tasks local, outside threads spread them round-robin
+	uint32_t index = t_queueIndex != 0 ? t_queueIndex : m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+	{
+		std::lock_guard lock(m_queues[index]->mutex);
+		m_queues[index]->tasks.emplace_back(std::move(task), &group);
+	}
+	m_queued.fetch_add(1, std::memory_order_release);
+
+	// taking the lock orders this against a worker that is just about to sleep
+	{ std::lock_guard lock(m_sleepMutex); }
+	m_wakeUp.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+	while (!group.done()) {
+		if (!tryRunOne(t_queueIndex)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void ThreadPool::parallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& func) {
+	if (begin >= end) return;
+
+	uint32_t count = end - begin;
+	uint32_t chunks = std::min(threadCount() * 4, std::max(1u, count / std::max(1u, grainSize)));
+	if (chunks <= 1) {
+		func(begin, end);
+		return;
+	}
+
+	TaskGroup group;
+	uint32_t chunkSize = (count + chunks - 1) / chunks;
+	for (uint32_t first = begin; first < end; first += chunkSize) {
+		uint32_t last = std::min(end, first + chunkSize);
+		run(group, [&func, first, last] { func(first, last); });
+	}
+	wait(group);
+}
+
+bool ThreadPool::tryRunOne(uint32_t preferred) {
+	if (m_queued.load(std::memory_order_acquire) == 0) return false;
+
+	std::pair<Task, TaskGroup*> item;
+	bool found = false;
+
+	// own queue from the back, keeps the most recently split subtree hot in cache
+	{
+		auto& own = *m_queues[preferred];
+		std::lock_guard lock(own.mutex);
+		if (!own.tasks.empty()) {
+			item = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			found = true;
+		}
+	}
+
+	// steal the oldest, usually biggest, task from somebody else
+	for (uint32_t i = 1; !found && i < m_queues.size(); ++i) {
+		auto& victim = *m_queues[(preferred + i) % m_queues.size()];
+		std::lock_guard lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			item = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found) return false;
+
+	m_queued.fetch_sub(1, std::memory_order_relaxed);
+	item.first();
+	item.second->m_pending.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+void ThreadPool::workerLoop(uint32_t index) {
+	t_queueIndex = index;
+
+	while (true) {
+		if (tryRunOne(index)) continue;
+
+		std::unique_lock lock(m_sleepMutex);
+		m_wakeUp.wait(lock, [this] { return m_stop || m_queued.load(std::memory_order_acquire) > 0; });
+		if (m_stop) return;
+	}
+}
+
+} // ph